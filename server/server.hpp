@@ -6,6 +6,7 @@
 #include <stdio.h>
 #include <chrono>
 #include <thread>
+#include <mutex>
 
 #include <event2/event.h>
 #include <event2/buffer.h>
@@ -0,0 +1,244 @@
+#ifndef CORECOMMON_SRC_ARENA_HPP_
+#define CORECOMMON_SRC_ARENA_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+//bump allocator for short-lived, allocation-heavy work like a request's headers.
+//memory comes in chunks and is only handed back all at once by reset(), which rewinds to the first chunk in O(1) and
+//keeps every chunk for reuse. release() frees all but the first. deallocating the newest block gives it back,
+//so a growing vector or Map can reuse the space its old buffer took
+class Arena {
+ private:
+	struct alignas(std::max_align_t) Chunk {
+		Chunk* next;
+		size_t size;
+
+		char* data() {
+			return reinterpret_cast<char*>(this+1);
+		}
+	};
+
+	Chunk* first;
+	Chunk* current;
+	char* cur;
+	char* end;
+	size_t chunk_size;
+
+	static Chunk* new_chunk(size_t size) {
+		Chunk* c = static_cast<Chunk*>(::operator new(sizeof(Chunk)+size));
+		c->next=nullptr;
+		c->size=size;
+		return c;
+	}
+
+	void use(Chunk* c) {
+		current=c;
+		cur=c->data();
+		end=cur+c->size;
+	}
+
+	//moves to the next kept chunk that fits n bytes, or adds one at the end
+	void next_chunk(size_t n) {
+		while (current->next) {
+			use(current->next);
+			if (current->size>=n) return;
+		}
+
+		current->next = new_chunk(n>chunk_size ? n : chunk_size);
+		use(current->next);
+	}
+
+	static char* align_up(char* p, size_t align) {
+		return reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(p)+align-1) & ~static_cast<uintptr_t>(align-1));
+	}
+
+ public:
+	explicit Arena(size_t chunk_size=16*1024): first(new_chunk(chunk_size)), chunk_size(chunk_size) {
+		use(first);
+	}
+
+	Arena(Arena const&) = delete;
+	Arena& operator=(Arena const&) = delete;
+
+	//align has to be a power of two
+	void* allocate(size_t n, size_t align) {
+		char* p = align_up(cur, align);
+		if (p>end || static_cast<size_t>(end-p)<n) {
+			next_chunk(n+align);
+			p = align_up(cur, align);
+		}
+
+		cur=p+n;
+		return p;
+	}
+
+	void deallocate(void* p, size_t n) {
+		if (static_cast<char*>(p)+n==cur) cur=static_cast<char*>(p);
+	}
+
+	void reset() {
+		use(first);
+	}
+
+	void release() {
+		for (Chunk* c=first->next; c;) {
+			Chunk* next=c->next;
+			::operator delete(c);
+			c=next;
+		}
+
+		first->next=nullptr;
+		use(first);
+	}
+
+	//bytes held in chunks, used or not
+	size_t reserved() const {
+		size_t n=0;
+		for (Chunk* c=first; c; c=c->next) n+=c->size;
+		return n;
+	}
+
+	~Arena() {
+		release();
+		::operator delete(first);
+	}
+};
+
+//free lists by power of two size class (16 bytes to 4K) on top of an Arena, for work that also frees a lot, eg. maps
+//that grow and shrink. freed blocks are reused by the next allocation of their class, and larger or overaligned
+//blocks come straight from the arena. reset() empties the lists and rewinds the arena, freeing everything in O(1)
+class Pool {
+ private:
+	static constexpr unsigned MIN_SHIFT=4;
+	static constexpr unsigned NUM_CLASSES=9;
+	static constexpr size_t MAX_BLOCK=size_t(1)<<(MIN_SHIFT+NUM_CLASSES-1);
+
+	struct FreeBlock {
+		FreeBlock* next;
+	};
+
+	Arena arena;
+	std::array<FreeBlock*, NUM_CLASSES> free_lists;
+
+	static unsigned size_class(size_t n) {
+		if (n<=(size_t(1)<<MIN_SHIFT)) return 0;
+		return 64-__builtin_clzll(n-1)-MIN_SHIFT;
+	}
+
+	static bool pooled(size_t n, size_t align) {
+		return n<=MAX_BLOCK && align<=alignof(std::max_align_t);
+	}
+
+ public:
+	explicit Pool(size_t chunk_size=64*1024): arena(chunk_size) {
+		free_lists.fill(nullptr);
+	}
+
+	void* allocate(size_t n, size_t align) {
+		if (!pooled(n, align)) return arena.allocate(n, align);
+
+		unsigned c = size_class(n);
+		if (FreeBlock* b = free_lists[c]) {
+			free_lists[c] = b->next;
+			return b;
+		}
+
+		return arena.allocate(size_t(1)<<(c+MIN_SHIFT), alignof(std::max_align_t));
+	}
+
+	void deallocate(void* p, size_t n, size_t align) {
+		if (!pooled(n, align)) {
+			arena.deallocate(p, n);
+			return;
+		}
+
+		unsigned c = size_class(n);
+		free_lists[c] = ::new (p) FreeBlock {.next=free_lists[c]};
+	}
+
+	void reset() {
+		free_lists.fill(nullptr);
+		arena.reset();
+	}
+
+	size_t reserved() const {
+		return arena.reserved();
+	}
+};
+
+//std allocators over an Arena or Pool, for Map's Allocator parameter, SmallVector and std containers.
+//they don't own their arena, which has to outlive every container using it. containers carry the allocator along
+//on copy, move and swap, so two maps on different arenas can be swapped
+template<class T>
+class ArenaAllocator {
+ public:
+	using value_type = T;
+	using propagate_on_container_copy_assignment = std::true_type;
+	using propagate_on_container_move_assignment = std::true_type;
+	using propagate_on_container_swap = std::true_type;
+
+	Arena* arena;
+
+	ArenaAllocator(Arena& arena): arena(&arena) {}
+
+	template<class U>
+	ArenaAllocator(ArenaAllocator<U> const& other): arena(other.arena) {}
+
+	T* allocate(size_t n) {
+		return static_cast<T*>(arena->allocate(n*sizeof(T), alignof(T)));
+	}
+
+	void deallocate(T* p, size_t n) {
+		arena->deallocate(p, n*sizeof(T));
+	}
+
+	template<class U>
+	bool operator==(ArenaAllocator<U> const& other) const {
+		return arena==other.arena;
+	}
+
+	template<class U>
+	bool operator!=(ArenaAllocator<U> const& other) const {
+		return arena!=other.arena;
+	}
+};
+
+template<class T>
+class PoolAllocator {
+ public:
+	using value_type = T;
+	using propagate_on_container_copy_assignment = std::true_type;
+	using propagate_on_container_move_assignment = std::true_type;
+	using propagate_on_container_swap = std::true_type;
+
+	Pool* pool;
+
+	PoolAllocator(Pool& pool): pool(&pool) {}
+
+	template<class U>
+	PoolAllocator(PoolAllocator<U> const& other): pool(other.pool) {}
+
+	T* allocate(size_t n) {
+		return static_cast<T*>(pool->allocate(n*sizeof(T), alignof(T)));
+	}
+
+	void deallocate(T* p, size_t n) {
+		pool->deallocate(p, n*sizeof(T), alignof(T));
+	}
+
+	template<class U>
+	bool operator==(PoolAllocator<U> const& other) const {
+		return pool==other.pool;
+	}
+
+	template<class U>
+	bool operator!=(PoolAllocator<U> const& other) const {
+		return pool!=other.pool;
+	}
+};
+
+#endif //CORECOMMON_SRC_ARENA_HPP_
@@ -1,75 +1,199 @@
 #ifndef CORECOMMON_SRC_ARRAYSET_HPP_
 #define CORECOMMON_SRC_ARRAYSET_HPP_
 
+#include <algorithm>
 #include <array>
+#include <cassert>
+#include <type_traits>
+#include <vector>
 
+#include "smallvector.hpp"
 #include "util.hpp"
 
-template<class T>
-struct ArraySet {
-	std::vector<T> vec;
-	size_t elements;
-	ArraySet(size_t elements, size_t len): elements(elements), vec(binomial(len, elements)) {}
-	ArraySet(size_t elements, size_t len, T const& value): elements(elements), vec(binomial(len, elements), value) {}
-
-	typename std::vector<T>::reference operator[](size_t* idx) {
-		std::vector<size_t> elem_vec(idx, idx+elements);
-		std::sort(elem_vec.begin(), elem_vec.end());
-		std::reverse(elem_vec.begin(), elem_vec.end());
-		size_t out_i=0;
-
-		for (size_t i=0; i<elements; i++) {
-			out_i += binomial(elem_vec[i], elements-i);
+//ranks k-subsets of {0..n-1} in the combinatorial number system: with elements c_1>c_2>..>c_k the rank is
+//(c_1 choose k)+(c_2 choose k-1)+..+(c_k choose 1), which numbers the subsets densely from 0 in colex order.
+//binomials come from a pascal table, so rank is k lookups and unrank k binary searches.
+//K fixes k at compile time, so elements live in std::arrays and loops unroll. K=0 takes k at runtime
+template<size_t K=0>
+struct Combinations {
+	//a subset's elements, largest first
+	using Elements = std::conditional_t<(K>0), std::array<size_t, K>, std::vector<size_t>>;
+
+	size_t k, n;
+	//column j holds (i choose j) for i in 0..n, so unrank can binary search it
+	std::vector<size_t> table;
+
+	Combinations(size_t k, size_t n): k(K>0 ? K : k), n(n), table((this->k+1)*(n+1)) {
+		assert(K==0 || k==K);
+
+		for (size_t i=0; i<=n; i++) {
+			at(i, 0) = 1;
+			for (size_t j=1; j<=this->k; j++) at(i, j) = i==0 ? 0 : at(i-1, j-1)+at(i-1, j);
 		}
+	}
 
-		return vec[out_i];
+	explicit Combinations(size_t n): Combinations(K, n) {
+		static_assert(K>0, "pass k");
 	}
 
-	struct Iterator {
-		std::vector<size_t> elem_vec;
-		typename std::vector<T>::iterator t;
-		ArraySet<T>& ref;
+	size_t& at(size_t i, size_t j) {
+		return table[j*(n+1)+i];
+	}
+
+	size_t at(size_t i, size_t j) const {
+		return table[j*(n+1)+i];
+	}
+
+	size_t elements() const {
+		if constexpr (K>0) return K;
+		else return k;
+	}
+
+	//number of subsets
+	size_t count() const {
+		return at(n, elements());
+	}
+
+	Elements make_elements() const {
+		if constexpr (K>0) return Elements();
+		else return Elements(k);
+	}
 
-		std::pair<std::vector<size_t>&, typename std::vector<T>::reference> operator*() {
-			return std::pair<std::vector<size_t>&, typename std::vector<T>::reference>(elem_vec, *t);
+	//elements largest first
+	size_t rank_sorted(size_t const* idx) const {
+		size_t r=0;
+		size_t k = elements();
+		for (size_t i=0; i<k; i++) r += at(idx[i], k-i);
+		return r;
+	}
+
+	//elements in any order. sorts a copy on the stack, up to 16 elements for runtime k
+	size_t rank(size_t const* idx) const {
+		std::conditional_t<(K>0), std::array<size_t, K>, SmallVector<size_t, 16>> e;
+		if constexpr (K==0) e.resize(k);
+		std::copy(idx, idx+elements(), e.begin());
+
+		//insertion sort, k is small
+		for (size_t i=1; i<e.size(); i++) {
+			size_t x = e[i], j=i;
+			for (; j>0 && e[j-1]<x; j--) e[j] = e[j-1];
+			e[j] = x;
 		}
 
-		void operator++() {
-			for (size_t i=elem_vec.size()-1; i!=-1; i--) {
-				if (i==0 || elem_vec[i]<elem_vec[i-1]-1) {
-					elem_vec[i]++;
+		return rank_sorted(e.data());
+	}
 
-					for (size_t j = i+1; j < elem_vec.size(); j++) {
-						elem_vec[j] = j-i-1;
-					}
+	//count subsets of elements() indices each, one after the other in idx, into out
+	void rank_many(size_t const* idx, size_t count, size_t* out) const {
+		size_t k = elements();
+		for (size_t i=0; i<count; i++) out[i] = rank(idx+i*k);
+	}
+
+	void rank_many_sorted(size_t const* idx, size_t count, size_t* out) const {
+		size_t k = elements();
+		for (size_t i=0; i<count; i++) out[i] = rank_sorted(idx+i*k);
+	}
 
-					break;
-				}
+	//out gets the elements of the subset with rank r, largest first
+	void unrank(size_t r, size_t* out) const {
+		size_t k = elements();
+		size_t hi = n;
+
+		for (size_t i=0; i<k; i++) {
+			size_t j = k-i;
+			//largest c<hi with (c choose j)<=r. (j-1 choose j) is 0 so it starts true. branchless, the comparisons are
+			//unpredictable
+			size_t const* col = table.data()+j*(n+1);
+			size_t const* base = col+j-1;
+			for (size_t len=hi-(j-1); len>1; len-=len/2) base = base[len/2]<=r ? base+len/2 : base;
+
+			out[i] = base-col;
+			r -= *base;
+			hi = out[i];
+		}
+	}
+
+	//the next subset in rank order, in place
+	static void next(size_t* e, size_t k) {
+		for (size_t i=k; i-->0;) {
+			if (i==0 || e[i]+1<e[i-1]) {
+				e[i]++;
+				for (size_t j=i+1; j<k; j++) e[j] = k-1-j;
+				return;
 			}
+		}
+	}
+};
 
+//a value for every k-subset of {0..len-1}, eg. a DP table over subsets, stored densely by Combinations rank
+template<class T, size_t K=0>
+struct ArraySet {
+	using Elements = typename Combinations<K>::Elements;
+
+	Combinations<K> comb;
+	std::vector<T> vec;
+
+	ArraySet(size_t elements, size_t len): comb(elements, len), vec(comb.count()) {}
+	ArraySet(size_t elements, size_t len, T const& value): comb(elements, len), vec(comb.count(), value) {}
+
+	size_t elements() const {
+		return comb.elements();
+	}
+
+	typename std::vector<T>::reference operator[](size_t const* idx) {
+		return vec[comb.rank(idx)];
+	}
+
+	struct Iterator {
+		Elements elem_vec;
+		typename std::vector<T>::iterator t;
+
+		std::pair<Elements&, typename std::vector<T>::reference> operator*() {
+			return std::pair<Elements&, typename std::vector<T>::reference>(elem_vec, *t);
+		}
+
+		void operator++() {
+			Combinations<K>::next(elem_vec.data(), elem_vec.size());
 			t++;
 		}
 
-		bool operator==(Iterator const& other) {
+		bool operator==(Iterator const& other) const {
 			return other.t==t;
 		}
 
-		bool operator!=(Iterator const& other) {
+		bool operator!=(Iterator const& other) const {
 			return other.t!=t;
 		}
 	};
 
-	Iterator begin() {
-		Iterator iter {.t=vec.begin(), .elem_vec=std::vector<size_t>(elements, 0), .ref=*this};
-		for (size_t i = 0; i < elements; i++) {
-			iter.elem_vec[i] = elements-i-1;
-		}
-
+	//iterator at the subset with rank i
+	Iterator at(size_t i) {
+		Iterator iter {.elem_vec=comb.make_elements(), .t=vec.begin()+i};
+		if (i<vec.size()) comb.unrank(i, iter.elem_vec.data());
 		return iter;
 	}
 
+	Iterator begin() {
+		return at(0);
+	}
+
 	Iterator end() {
-		return {.t=vec.end(), .ref=*this};
+		return at(vec.size());
+	}
+
+	struct Range {
+		Iterator from, to;
+
+		Iterator begin() const { return from; }
+		Iterator end() const { return to; }
+	};
+
+	//parts disjoint ranges covering every subset in order, to fill the table from several threads (unless T is bool,
+	//whose vector packs neighbours into one word)
+	std::vector<Range> split(size_t parts) {
+		std::vector<Range> ret;
+		for (size_t i=0; i<parts; i++) ret.push_back({.from=at(vec.size()*i/parts), .to=at(vec.size()*(i+1)/parts)});
+		return ret;
 	}
 };
 
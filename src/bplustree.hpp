@@ -0,0 +1,527 @@
+#ifndef CORECOMMON_SRC_BPLUSTREE_HPP_
+#define CORECOMMON_SRC_BPLUSTREE_HPP_
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+//in-node key search is vectorized per isa at compile time, define BPLUSTREE_NO_SIMD to force the scalar loop
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__AVX2__) || defined(__SSE4_2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+//ordered map for large indexes, as a B+tree: every node keeps up to Fanout keys in one sorted array, so a lookup
+//misses cache about once per level (log_Fanout(n) levels) instead of once per AVL node. values live only in the leaves,
+//which are linked in key order for scans.
+//inner nodes hold the largest key of each child but the last, so a search in any node is "how many keys are < k".
+//for 32 and 64 bit integer keys under std::less that count runs over the whole array with simd compares, with unused
+//slots kept at the max key so they never count; other keys binary search.
+//K and V have to be default constructible. remove() doesn't merge underfull nodes, bulk_load() rebuilds compactly
+template<class K, class V, unsigned Fanout=64, class Compare=std::less<K>>
+class BPlusTree {
+	static_assert(Fanout>=4, "nodes must split into two nodes of at least two keys");
+
+ public:
+	size_t count;
+
+ private:
+	static constexpr bool SIMD_KEYS = std::is_integral_v<K> && (sizeof(K)==4 || sizeof(K)==8)
+	                                  && std::is_same_v<Compare, std::less<K>>;
+	//what unused key slots hold, never less than a key when SIMD_KEYS
+	static K pad() {
+		if constexpr (SIMD_KEYS) return std::numeric_limits<K>::max();
+		else return K();
+	}
+
+	struct Node {
+		unsigned n;
+		alignas(64) std::array<K, Fanout> keys;
+
+		Node(): n(0) {
+			keys.fill(pad());
+		}
+	};
+
+	//n separators between n+1 children, keys[i] being the largest key under children[i]
+	struct Inner: Node {
+		std::array<Node*, Fanout+1> children;
+	};
+
+	struct Leaf: Node {
+		std::array<V, Fanout> vals;
+		Leaf* next;
+
+		Leaf(): next(nullptr) {}
+	};
+
+	Node* root;
+	//inner levels above the leaves
+	unsigned depth;
+	Compare cmp;
+
+#if defined(__ARM_NEON) && !defined(BPLUSTREE_NO_SIMD)
+	static unsigned count_less_simd(K const* keys, K k) {
+		unsigned c=0, i=0;
+		if constexpr (sizeof(K)==4) {
+			uint32x4_t acc = vdupq_n_u32(0);
+			for (; i+4<=Fanout; i+=4) {
+				uint32x4_t lt;
+				if constexpr (std::is_signed_v<K>) lt = vcltq_s32(vld1q_s32(reinterpret_cast<int32_t const*>(keys+i)), vdupq_n_s32(k));
+				else lt = vcltq_u32(vld1q_u32(reinterpret_cast<uint32_t const*>(keys+i)), vdupq_n_u32(k));
+				//lanes are all ones where less, ie. -1
+				acc = vsubq_u32(acc, lt);
+			}
+
+			c = vaddvq_u32(acc);
+		} else {
+			uint64x2_t acc = vdupq_n_u64(0);
+			for (; i+2<=Fanout; i+=2) {
+				uint64x2_t lt;
+				if constexpr (std::is_signed_v<K>) lt = vcltq_s64(vld1q_s64(reinterpret_cast<int64_t const*>(keys+i)), vdupq_n_s64(k));
+				else lt = vcltq_u64(vld1q_u64(reinterpret_cast<uint64_t const*>(keys+i)), vdupq_n_u64(k));
+				acc = vsubq_u64(acc, lt);
+			}
+
+			c = static_cast<unsigned>(vaddvq_u64(acc));
+		}
+
+		for (; i<Fanout; i++) c += keys[i]<k;
+		return c;
+	}
+#elif (defined(__AVX2__) || defined(__SSE2__)) && !defined(BPLUSTREE_NO_SIMD)
+	static unsigned count_less_simd(K const* keys, K k) {
+		unsigned c=0, i=0;
+		//x86 only compares signed, so unsigned keys get their top bit flipped on both sides
+		constexpr K FLIP = std::is_signed_v<K> ? K(0) : K(K(1)<<(sizeof(K)*8-1));
+
+		if constexpr (sizeof(K)==4) {
+#ifdef __AVX2__
+			__m256i kv = _mm256_set1_epi32(static_cast<int32_t>(k^FLIP)), flip = _mm256_set1_epi32(static_cast<int32_t>(FLIP));
+			for (; i+8<=Fanout; i+=8) {
+				__m256i x = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(keys+i)), flip);
+				c += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(kv, x))));
+			}
+#else
+			__m128i kv = _mm_set1_epi32(static_cast<int32_t>(k^FLIP)), flip = _mm_set1_epi32(static_cast<int32_t>(FLIP));
+			for (; i+4<=Fanout; i+=4) {
+				__m128i x = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<__m128i const*>(keys+i)), flip);
+				c += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(kv, x))));
+			}
+#endif
+		} else {
+#if defined(__AVX2__)
+			__m256i kv = _mm256_set1_epi64x(static_cast<int64_t>(k^FLIP)), flip = _mm256_set1_epi64x(static_cast<int64_t>(FLIP));
+			for (; i+4<=Fanout; i+=4) {
+				__m256i x = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(keys+i)), flip);
+				c += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(kv, x))));
+			}
+#elif defined(__SSE4_2__)
+			__m128i kv = _mm_set1_epi64x(static_cast<int64_t>(k^FLIP)), flip = _mm_set1_epi64x(static_cast<int64_t>(FLIP));
+			for (; i+2<=Fanout; i+=2) {
+				__m128i x = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<__m128i const*>(keys+i)), flip);
+				c += __builtin_popcount(_mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(kv, x))));
+			}
+#endif
+			//plain sse2 has no 64 bit compare, the loop below does it all
+		}
+
+		for (; i<Fanout; i++) c += keys[i]<k;
+		return c;
+	}
+#else
+	static unsigned count_less_simd(K const* keys, K k) {
+		unsigned c=0;
+		for (unsigned i=0; i<Fanout; i++) c += keys[i]<k;
+		return c;
+	}
+#endif
+
+	//keys of node less than k, ie. where k goes
+	unsigned search(Node const* node, K const& k) const {
+		if constexpr (SIMD_KEYS) return count_less_simd(node->keys.data(), k);
+		else return std::lower_bound(node->keys.begin(), node->keys.begin()+node->n, k, cmp) - node->keys.begin();
+	}
+
+	static Inner* inner(Node* n) {
+		return static_cast<Inner*>(n);
+	}
+
+	static Leaf* leaf(Node* n) {
+		return static_cast<Leaf*>(n);
+	}
+
+	Leaf* find_leaf(K const& k, unsigned& idx) const {
+		Node* node = root;
+		for (unsigned d=0; d<depth; d++) node = inner(node)->children[search(node, k)];
+
+		idx = search(node, k);
+		return leaf(node);
+	}
+
+	bool matches(Leaf* l, unsigned idx, K const& k) const {
+		return idx<l->n && !cmp(k, l->keys[idx]);
+	}
+
+	//moves a node's keys [from, n) up one slot
+	static void shift_keys_up(Node* node, unsigned from) {
+		std::move_backward(node->keys.begin()+from, node->keys.begin()+node->n, node->keys.begin()+node->n+1);
+	}
+
+	//splits a full leaf in half, returning the new right half
+	Leaf* split(Leaf* l) {
+		Leaf* r = new Leaf();
+		unsigned mid = Fanout/2;
+
+		std::move(l->keys.begin()+mid, l->keys.end(), r->keys.begin());
+		std::move(l->vals.begin()+mid, l->vals.end(), r->vals.begin());
+		std::fill(l->keys.begin()+mid, l->keys.end(), pad());
+		r->n = Fanout-mid;
+		l->n = mid;
+
+		r->next = l->next;
+		l->next = r;
+		return r;
+	}
+
+	//splits a full inner node around its middle separator, which moves up and is returned with the right half
+	std::pair<K, Inner*> split(Inner* in) {
+		Inner* r = new Inner();
+		unsigned mid = Fanout/2;
+		K up = std::move(in->keys[mid]);
+
+		std::move(in->keys.begin()+mid+1, in->keys.end(), r->keys.begin());
+		std::copy(in->children.begin()+mid+1, in->children.end(), r->children.begin());
+		std::fill(in->keys.begin()+mid, in->keys.end(), pad());
+		r->n = Fanout-mid-1;
+		in->n = mid;
+
+		return {std::move(up), r};
+	}
+
+	void free_tree(Node* node, unsigned d) {
+		if (d==depth) {
+			delete leaf(node);
+			return;
+		}
+
+		for (unsigned i=0; i<=node->n; i++) free_tree(inner(node)->children[i], d+1);
+		delete inner(node);
+	}
+
+	Leaf* first_leaf() const {
+		Node* node = root;
+		for (unsigned d=0; d<depth; d++) node = inner(node)->children[0];
+		return leaf(node);
+	}
+
+	template<bool is_const>
+	class IteratorTemplate {
+	 private:
+		Leaf* l;
+		unsigned i;
+
+		IteratorTemplate(Leaf* l, unsigned i): l(l), i(i) {
+			skip_empty();
+		}
+
+		friend BPlusTree;
+		template<bool> friend class IteratorTemplate;
+
+		void skip_empty() {
+			while (l && i>=l->n) {
+				l=l->next;
+				i=0;
+			}
+		}
+
+	 public:
+		using iterator_category = std::forward_iterator_tag;
+		using difference_type = std::ptrdiff_t;
+		using value_type = std::pair<K const&, V&>;
+		using pointer = void;
+		using reference = std::pair<K const&, std::conditional_t<is_const, V const&, V&>>;
+
+		IteratorTemplate(): l(nullptr), i(0) {}
+
+		template<bool other_const, class=std::enable_if_t<is_const || !other_const>>
+		IteratorTemplate(IteratorTemplate<other_const> const& other): l(other.l), i(other.i) {}
+
+		IteratorTemplate& operator++() {
+			i++;
+			skip_empty();
+			return *this;
+		}
+
+		IteratorTemplate operator++(int) {
+			IteratorTemplate cpy = *this;
+			++*this;
+			return cpy;
+		}
+
+		bool operator==(IteratorTemplate const& other) const {
+			return l==other.l && i==other.i;
+		}
+
+		bool operator!=(IteratorTemplate const& other) const {
+			return !(*this==other);
+		}
+
+		reference operator*() const {
+			return reference(l->keys[i], l->vals[i]);
+		}
+
+		K const& key() const {
+			return l->keys[i];
+		}
+
+		std::conditional_t<is_const, V const&, V&> value() const {
+			return l->vals[i];
+		}
+	};
+
+ public:
+	using Iterator = IteratorTemplate<false>;
+	using ConstIterator = IteratorTemplate<true>;
+
+	explicit BPlusTree(Compare cmp={}): count(0), root(new Leaf()), depth(0), cmp(cmp) {}
+
+	BPlusTree(BPlusTree const&) = delete;
+
+	BPlusTree(BPlusTree&& other): BPlusTree(other.cmp) {
+		swap(other);
+	}
+
+	BPlusTree& swap(BPlusTree& other) {
+		std::swap(count, other.count);
+		std::swap(root, other.root);
+		std::swap(depth, other.depth);
+		std::swap(cmp, other.cmp);
+		return *this;
+	}
+
+	BPlusTree& operator=(BPlusTree&& other) {
+		return swap(other);
+	}
+
+	~BPlusTree() {
+		free_tree(root, 0);
+	}
+
+	void clear() {
+		free_tree(root, 0);
+		root = new Leaf();
+		depth=0;
+		count=0;
+	}
+
+	V* operator[](K const& k) {
+		unsigned idx;
+		Leaf* l = find_leaf(k, idx);
+		return matches(l, idx, k) ? &l->vals[idx] : nullptr;
+	}
+
+	V const* operator[](K const& k) const {
+		return const_cast<BPlusTree&>(*this)[k];
+	}
+
+	//returns the previous value if k was already present
+	std::optional<V> insert(K const& k, V v) {
+		//the inner nodes we came through and which child we took
+		std::array<std::pair<Inner*, unsigned>, 64> path;
+
+		Node* node = root;
+		for (unsigned d=0; d<depth; d++) {
+			unsigned i = search(node, k);
+			path[d] = {inner(node), i};
+			node = inner(node)->children[i];
+		}
+
+		Leaf* l = leaf(node);
+		unsigned idx = search(l, k);
+		if (matches(l, idx, k)) {
+			std::optional<V> old(std::move(l->vals[idx]));
+			l->vals[idx] = std::move(v);
+			return old;
+		}
+
+		count++;
+
+		Leaf* left = l;
+		Node* right = nullptr;
+		if (l->n==Fanout) {
+			Leaf* r = split(l);
+			if (idx>l->n) {
+				idx -= l->n;
+				l = r;
+			}
+
+			right = r;
+		}
+
+		shift_keys_up(l, idx);
+		std::move_backward(l->vals.begin()+idx, l->vals.begin()+l->n, l->vals.begin()+l->n+1);
+		l->keys[idx] = k;
+		l->vals[idx] = std::move(v);
+		l->n++;
+
+		if (!right) return std::optional<V>();
+		//the separator is the largest key left behind
+		K up = left->keys[left->n-1];
+
+		//push separators up until a node has room
+		for (unsigned d=depth; d-->0;) {
+			auto [in, i] = path[d];
+
+			Inner* split_right = nullptr;
+			K split_up;
+			if (in->n==Fanout) {
+				auto [sep, r] = split(in);
+				split_right = r;
+				split_up = std::move(sep);
+
+				//the new separator goes after child i, in whichever half has it
+				if (i>in->n) {
+					i -= in->n+1;
+					in = r;
+				}
+			}
+
+			shift_keys_up(in, i);
+			std::copy_backward(in->children.begin()+i+1, in->children.begin()+in->n+1, in->children.begin()+in->n+2);
+			in->keys[i] = std::move(up);
+			in->children[i+1] = right;
+			in->n++;
+
+			if (!split_right) return std::optional<V>();
+			up = std::move(split_up);
+			right = split_right;
+		}
+
+		Inner* new_root = new Inner();
+		new_root->n = 1;
+		new_root->keys[0] = std::move(up);
+		new_root->children[0] = root;
+		new_root->children[1] = right;
+		root = new_root;
+		depth++;
+
+		return std::optional<V>();
+	}
+
+	//leaves separators alone, they stay valid upper bounds for their subtrees
+	std::optional<V> remove(K const& k) {
+		unsigned idx;
+		Leaf* l = find_leaf(k, idx);
+		if (!matches(l, idx, k)) return std::optional<V>();
+
+		std::optional<V> ret(std::move(l->vals[idx]));
+		std::move(l->keys.begin()+idx+1, l->keys.begin()+l->n, l->keys.begin()+idx);
+		std::move(l->vals.begin()+idx+1, l->vals.begin()+l->n, l->vals.begin()+idx);
+		l->n--;
+		l->keys[l->n] = pad();
+		l->vals[l->n] = V();
+
+		count--;
+		return ret;
+	}
+
+	//replaces the contents with [begin, end), which has to be sorted by key without duplicates.
+	//leaves get fill entries each (spread evenly), less than Fanout leaves room for inserts without splitting
+	template<class It>
+	void bulk_load(It begin, It end, unsigned fill=Fanout) {
+		assert(fill>=2 && fill<=Fanout);
+		clear();
+
+		size_t n = std::distance(begin, end);
+		if (n==0) return;
+
+		//each node with the largest key under it
+		std::vector<std::pair<Node*, K>> level;
+		size_t num_leaves = (n+fill-1)/fill;
+		level.reserve(num_leaves);
+
+		Leaf* prev = nullptr;
+		for (size_t i=0; i<num_leaves; i++) {
+			Leaf* l = i==0 ? leaf(root) : new Leaf();
+			for (size_t j=n*i/num_leaves; j<n*(i+1)/num_leaves; j++, ++begin) {
+				assert(l->n==0 || cmp(l->keys[l->n-1], begin->first));
+				l->keys[l->n] = begin->first;
+				l->vals[l->n] = begin->second;
+				l->n++;
+			}
+
+			if (prev) prev->next = l;
+			prev = l;
+			level.emplace_back(l, l->keys[l->n-1]);
+		}
+
+		count = n;
+
+		while (level.size()>1) {
+			std::vector<std::pair<Node*, K>> parents;
+			size_t num_parents = (level.size()+Fanout)/(Fanout+1);
+			parents.reserve(num_parents);
+
+			for (size_t i=0; i<num_parents; i++) {
+				Inner* in = new Inner();
+				size_t from = level.size()*i/num_parents, to = level.size()*(i+1)/num_parents;
+
+				for (size_t j=from; j<to; j++) {
+					in->children[j-from] = level[j].first;
+					if (j+1<to) in->keys[in->n++] = level[j].second;
+				}
+
+				parents.emplace_back(in, level[to-1].second);
+			}
+
+			level = std::move(parents);
+			depth++;
+		}
+
+		root = level[0].first;
+	}
+
+	//first entry with a key not less than k
+	Iterator lower_bound(K const& k) {
+		unsigned idx;
+		Leaf* l = find_leaf(k, idx);
+		return Iterator(l, idx);
+	}
+
+	ConstIterator lower_bound(K const& k) const {
+		return const_cast<BPlusTree&>(*this).lower_bound(k);
+	}
+
+	unsigned height() const {
+		return depth+1;
+	}
+
+	Iterator begin() {
+		return Iterator(first_leaf(), 0);
+	}
+
+	Iterator end() {
+		return Iterator();
+	}
+
+	ConstIterator begin() const {
+		return ConstIterator(first_leaf(), 0);
+	}
+
+	ConstIterator end() const {
+		return ConstIterator();
+	}
+};
+
+#endif //CORECOMMON_SRC_BPLUSTREE_HPP_
@@ -2,13 +2,198 @@
 #define CORECOMMON_SRC_BTREE_HPP_
 
 #include <memory>
+#include <new>
 #include <optional>
 #include <cassert>
+#include <cstdint>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
 
 #include "util.hpp"
 
-template<class K, class V>
-struct Node {
+//nodes can keep a monoid aggregate of their subtree, eg. for sums over key ranges (see Node::range_aggregate).
+//an Aggregate has a type, identity(), of(key, value) for one entry and an associative combine(left, right).
+//NoAggregate (the default) keeps nothing
+struct NoAggregate {
+	using type = NoAggregate;
+};
+
+template<class V>
+struct SumAggregate {
+	using type = V;
+
+	static V identity() {
+		return V();
+	}
+
+	template<class K>
+	static V of(K const&, V const& v) {
+		return v;
+	}
+
+	static V combine(V const& a, V const& b) {
+		return a+b;
+	}
+};
+
+//the optional per node fields, empty when unused so plain trees don't pay for them
+template<bool Sized>
+struct NodeSize {};
+
+template<>
+struct NodeSize<true> {
+	size_t size;
+};
+
+template<class Aggregate>
+struct NodeAggregate {
+	typename Aggregate::type agg;
+};
+
+template<>
+struct NodeAggregate<NoAggregate> {};
+
+//slab allocator for pooled nodes. slabs are SLAB_SIZE aligned, so a node finds its pool by masking its address and
+//deleters stay stateless. the pool is refcounted by its Root and by every live node, since join, split and the set
+//operations move nodes between Roots, and deletes itself once both are gone. not thread safe
+template<class T>
+struct NodePool {
+	static constexpr size_t SLAB_SIZE = 1<<16;
+
+	union Slot {
+		Slot* next;
+		alignas(T) unsigned char data[sizeof(T)];
+	};
+
+	struct Slab {
+		NodePool* pool;
+		Slab* next;
+	};
+
+	static constexpr size_t FIRST = (sizeof(Slab)+alignof(Slot)-1)/alignof(Slot)*alignof(Slot);
+	static constexpr size_t PER_SLAB = (SLAB_SIZE-FIRST)/sizeof(Slot);
+	static_assert(PER_SLAB>0 && alignof(Slot)<=SLAB_SIZE, "node too big for a slab");
+
+	Slab* slabs = nullptr;
+	Slot* free = nullptr;
+	//unused tail of the newest slab
+	Slot* bump = nullptr, *bump_end = nullptr;
+	size_t refs = 1;
+
+	NodePool() = default;
+	NodePool(NodePool const&) = delete;
+	NodePool& operator=(NodePool const&) = delete;
+
+	~NodePool() {
+		while (slabs) {
+			Slab* next = slabs->next;
+			::operator delete(slabs, std::align_val_t(SLAB_SIZE));
+			slabs = next;
+		}
+	}
+
+	static NodePool* of(void const* p) {
+		return reinterpret_cast<Slab*>(reinterpret_cast<uintptr_t>(p) & ~uintptr_t(SLAB_SIZE-1))->pool;
+	}
+
+	void* allocate() {
+		Slot* s;
+		if (free) {
+			s = free;
+			free = s->next;
+		} else {
+			if (bump==bump_end) {
+				char* mem = static_cast<char*>(::operator new(SLAB_SIZE, std::align_val_t(SLAB_SIZE)));
+				slabs = new (mem) Slab {.pool=this, .next=slabs};
+				bump = reinterpret_cast<Slot*>(mem+FIRST);
+				bump_end = bump+PER_SLAB;
+			}
+
+			s = bump++;
+		}
+
+		refs++;
+		return s;
+	}
+
+	void deallocate(void* p) {
+		Slot* s = static_cast<Slot*>(p);
+		s->next = free;
+		free = s;
+		release();
+	}
+
+	void release() {
+		if (--refs==0) delete this;
+	}
+};
+
+//a Root's pool, lazily created. empty for unpooled trees
+template<class T, bool Pooled>
+struct RootPool {
+	NodePool<T>* get() { return nullptr; }
+};
+
+template<class T>
+struct RootPool<T, true> {
+	NodePool<T>* pool = nullptr;
+
+	RootPool() = default;
+	RootPool(RootPool&& other): pool(other.pool) { other.pool=nullptr; }
+	RootPool& operator=(RootPool&& other) {
+		std::swap(pool, other.pool);
+		return *this;
+	}
+
+	~RootPool() {
+		if (pool) pool->release();
+	}
+
+	NodePool<T>* get() {
+		if (!pool) pool = new NodePool<T>;
+		return pool;
+	}
+};
+
+//AVL tree node. Sized keeps subtree sizes for select() and rank(), Aggregate keeps range_aggregate()'s monoid.
+//both are kept up to date through inserts, removes, rotations and swap_positions, at O(log n) per change.
+//if you change a node's v in place, call update_path() on it.
+//Pooled nodes come from their Root's NodePool instead of malloc, and Ptr frees them back to it. they can still be
+//moved between Roots, but nodes of one pool mustn't be allocated or freed from several threads at once
+template<class K, class V, class Aggregate=NoAggregate, bool Sized=false, bool Pooled=false>
+struct Node: NodeSize<Sized>, NodeAggregate<Aggregate> {
+	static constexpr bool AGGREGATED = !std::is_same_v<Aggregate, NoAggregate>;
+	static constexpr bool AUGMENTED = AGGREGATED || Sized;
+
+	using Pool = NodePool<Node>;
+
+	struct PoolDelete {
+		void operator()(Node* n) const {
+			Pool* pool = Pool::of(n);
+			n->~Node();
+			pool->deallocate(n);
+		}
+	};
+
+	using Ptr = std::conditional_t<Pooled, std::unique_ptr<Node, PoolDelete>, std::unique_ptr<Node>>;
+
+	template<class... Args>
+	static Ptr new_node([[maybe_unused]] Pool* pool, Args&&... args) {
+		if constexpr (Pooled) {
+			void* mem = pool->allocate();
+			try {
+				return Ptr(new (mem) Node(std::forward<Args>(args)...));
+			} catch (...) {
+				pool->deallocate(mem);
+				throw;
+			}
+		} else {
+			return std::make_unique<Node>(std::forward<Args>(args)...);
+		}
+	}
+
 	struct Iterator {
 		using iterator_category = std::input_iterator_tag;
 		using difference_type = void;
@@ -30,21 +215,29 @@ struct Node {
 			}
 		}
 
+		//O(log n) with subtree sizes, steps one by one otherwise
 		Iterator operator+(unsigned i) const {
+			if constexpr (Sized) {
+				if (current!=end) {
+					Node* n = begin->select(current->index_below(begin)+i);
+					return {.begin=begin, .end=end, .current=n ? n : end};
+				}
+			}
+
 			Iterator ret = *this;
 			while ((i--)>0) ++ret;
 			return ret;
 		}
 
-		std::unique_ptr<Node> consume() {
-			std::unique_ptr<Node>& ptr = *current->parent_ptr();
+		Ptr consume() {
+			Ptr& ptr = *current->parent_ptr();
 			Node* ptr_p = current->parent;
 			Root* root_p = current->root;
 
 			this->operator++();
 			if (ptr->left) ptr->left.reset();
 
-			std::unique_ptr<Node> ret = std::unique_ptr<Node>(ptr.release());
+			Ptr ret = Ptr(ptr.release());
 			ptr.swap(ret->right);
 
 			if (ptr) {
@@ -54,6 +247,11 @@ struct Node {
 
 			ret->h_diff = 0;
 
+			if constexpr (AUGMENTED) {
+				ret->update();
+				if (ptr_p) ptr_p->update_path();
+			}
+
 			return ret;
 		}
 
@@ -93,8 +291,16 @@ struct Node {
 		}
 	};
 
-	struct Root {
-		std::unique_ptr<Node> ptr;
+	//detached subtrees with their heights, which join and split work on (blelloch et al., "just join for parallel
+	//ordered sets"). joining costs the difference in height, so split and join are O(log n)
+	struct Tree {
+		Ptr ptr;
+		int h = 0;
+	};
+
+	//the pool is a base so it outlives ptr's nodes
+	struct Root: RootPool<Node, Pooled> {
+		Ptr ptr;
 
 		template<class Compare=std::less<K>>
 		Node* find(K const& fx, Compare cmp={}) {
@@ -102,13 +308,14 @@ struct Node {
 		}
 
 		template<class Compare=std::less<K>>
-		void insert_node(std::unique_ptr<Node>&& node, Compare cmp={}) {
+		void insert_node(Ptr&& node, Compare cmp={}) {
 			if (ptr) {
 				node->root = nullptr;
 				ptr->insert_node(std::move(node), cmp);
 			} else {
 				node->root = this;
 				node->parent = nullptr;
+				node->update();
 				ptr.swap(node);
 			}
 		}
@@ -117,23 +324,37 @@ struct Node {
 		Node* insert(K&& ix, V&& iv, Compare ins_cmp={}) {
 			if (ptr) return ptr->insert(std::move(ix), std::move(iv), ins_cmp);
 			else {
-				ptr = std::make_unique<Node>(this, std::move(ix), std::move(iv));
+				ptr = new_node(this->get(), this, std::move(ix), std::move(iv));
 				return ptr.get();
 			}
 		}
 
+		Node* select(size_t k) {
+			return ptr ? ptr->select(k) : nullptr;
+		}
+
+		template<class Compare=std::less<K>>
+		size_t rank(K const& key, Compare cmp={}) {
+			return ptr ? ptr->rank(key, cmp) : 0;
+		}
+
+		template<class Compare=std::less<K>>
+		typename Aggregate::type range_aggregate(K const& lo, K const& hi, Compare cmp={}) {
+			return ptr ? ptr->range_aggregate(lo, hi, cmp) : Aggregate::identity();
+		}
+
 		Iterator begin() {
-			Iterator iter {.current=ptr.get(), .begin=ptr.get(), .end=nullptr};
+			Iterator iter {.begin=ptr.get(), .end=nullptr, .current=ptr.get()};
 			while (iter.current && iter.current->left) iter.current = iter.current->left.get();
 			return iter;
 		}
 
 		Iterator end() {
-			return {.current=nullptr, .begin=ptr.get(), .end=nullptr};
+			return {.begin=ptr.get(), .end=nullptr, .current=nullptr};
 		}
 
 		Iterator iter_ref(Node* ref) {
-			return {.current=ref, .begin=ptr.get(), .end=nullptr};
+			return {.begin=ptr.get(), .end=nullptr, .current=ref};
 		}
 
 		void swap(Root& other) {
@@ -141,6 +362,59 @@ struct Node {
 			if (ptr) ptr->root=this;
 			if (other.ptr) other.ptr->root=&other;
 		}
+
+		Tree take() {
+			int h = height(ptr.get());
+			if (ptr) ptr->root = nullptr;
+			return {.ptr=std::move(ptr), .h=h};
+		}
+
+		void attach(Tree t) {
+			ptr = std::move(t.ptr);
+			if (ptr) {
+				ptr->parent = nullptr;
+				ptr->root = this;
+			}
+		}
+
+		//replaces the tree with [begin, end) of key/value pairs, which has to be sorted. O(n), the pairs are moved from
+		template<class It>
+		void build(It begin, It end) {
+			std::vector<Ptr> nodes;
+			for (; begin!=end; ++begin) nodes.push_back(new_node(this->get(), K(std::move(begin->first)), V(std::move(begin->second))));
+			attach(Node::build(nodes, 0, nodes.size()));
+		}
+
+		//appends mid and then right's entries, which have to come after ours and mid. right is left empty. O(log n)
+		void join(Ptr&& mid, Root& right) {
+			attach(Node::join(take(), std::move(mid), right.take()));
+		}
+
+		void join(Root& right) {
+			attach(join2(take(), right.take()));
+		}
+
+		//moves the entries with keys not less than key into right, which has to be empty. O(log n)
+		template<class Compare=std::less<K>>
+		void split(K const& key, Root& right, Compare cmp={}) {
+			assert(!right.ptr);
+			auto [l, r] = Node::split(take(), key, cmp);
+			attach(std::move(l));
+			right.attach(std::move(r));
+		}
+
+		//set operations for trees without duplicate keys, in O(m log(n/m+1)) for sizes m<=n. other is left empty.
+		//up to threads threads split the work once subtrees are big enough, pooled trees use one. cmp mustn't throw
+		template<class Compare=std::less<K>>
+		void set_union(Root& other, unsigned threads=1, Compare cmp={}) {
+			attach(Node::set_union(take(), other.take(), Pooled ? 1 : threads, cmp));
+		}
+
+		//keeps the entries whose keys are in both
+		template<class Compare=std::less<K>>
+		void set_intersection(Root& other, unsigned threads=1, Compare cmp={}) {
+			attach(Node::set_intersection(take(), other.take(), Pooled ? 1 : threads, cmp));
+		}
 	};
 
 	Node* parent;
@@ -151,27 +425,137 @@ struct Node {
 	K x;
 	V v;
 
-	std::unique_ptr<Node> left;
-	std::unique_ptr<Node> right;
+	Ptr left;
+	Ptr right;
+
+	Node(Root* parent, K&& k, V&& v): root(parent), parent(nullptr), h_diff(0), x(std::move(k)), v(std::move(v)) { update(); }
+	Node(Node* parent, K&& k, V&& v): root(nullptr), parent(parent), h_diff(0), x(std::move(k)), v(std::move(v)) { update(); }
+	Node(K&& k, V&& v): root(nullptr), parent(nullptr), h_diff(0), x(std::move(k)), v(std::move(v)) { update(); }
+
+	static size_t size_of(Node const* n) {
+		return n ? n->size : 0;
+	}
+
+	static typename Aggregate::type agg_of(Node const* n) {
+		return n ? n->agg : Aggregate::identity();
+	}
+
+	//recomputes size and aggregate from the children's
+	void update() {
+		if constexpr (Sized) this->size = 1+size_of(left.get())+size_of(right.get());
+		if constexpr (AGGREGATED) {
+			this->agg = Aggregate::combine(Aggregate::combine(agg_of(left.get()), Aggregate::of(x, v)), agg_of(right.get()));
+		}
+	}
+
+	//updates this node and every ancestor
+	void update_path() {
+		if constexpr (AUGMENTED) {
+			for (Node* n=this; n; n=n->parent) n->update();
+		}
+	}
+
+	//position in order within top's subtree
+	size_t index_below(Node* top) const {
+		size_t i = size_of(left.get());
+		for (Node const* n=this; n!=top; n=n->parent) {
+			if (n->parent->right.get()==n) i += size_of(n->parent->left.get())+1;
+		}
+
+		return i;
+	}
+
+	//k-th smallest (from 0) in this subtree, or null
+	Node* select(size_t k) {
+		static_assert(Sized, "select needs subtree sizes");
+
+		Node* n = this;
+		while (n) {
+			size_t l = size_of(n->left.get());
+			if (k<l) {
+				n = n->left.get();
+			} else if (k==l) {
+				return n;
+			} else {
+				k -= l+1;
+				n = n->right.get();
+			}
+		}
+
+		return nullptr;
+	}
+
+	//entries in this subtree with keys less than key
+	template<class Compare=std::less<K>>
+	size_t rank(K const& key, Compare cmp={}) const {
+		static_assert(Sized, "rank needs subtree sizes");
+
+		size_t r=0;
+		for (Node const* n=this; n;) {
+			if (cmp(n->x, key)) {
+				r += size_of(n->left.get())+1;
+				n = n->right.get();
+			} else {
+				n = n->left.get();
+			}
+		}
+
+		return r;
+	}
+
+	//aggregate of the entries with lo <= key < hi in this subtree, in order. only combines, so it doesn't need an inverse:
+	//finds the top node in range, then adds whole subtrees along the paths to lo and hi
+	template<class Compare=std::less<K>>
+	typename Aggregate::type range_aggregate(K const& lo, K const& hi, Compare cmp={}) const {
+		static_assert(AGGREGATED, "range_aggregate needs an Aggregate");
+		using A = Aggregate;
+
+		Node const* top = this;
+		while (top) {
+			if (cmp(top->x, lo)) top = top->right.get();
+			else if (!cmp(top->x, hi)) top = top->left.get();
+			else break;
+		}
 
-	Node(Root* parent, K&& k, V&& v): root(parent), parent(nullptr), h_diff(0), x(std::move(k)), v(std::move(v)) {}
-	Node(Node* parent, K&& k, V&& v): root(nullptr), parent(parent), h_diff(0), x(std::move(k)), v(std::move(v)) {}
-	Node(K&& k, V&& v): root(nullptr), parent(nullptr), h_diff(0), x(std::move(k)), v(std::move(v)) {}
+		if (!top) return A::identity();
 
-	std::unique_ptr<Node>* parent_ptr() {
+		typename A::type left = A::identity();
+		for (Node const* n=top->left.get(); n;) {
+			if (cmp(n->x, lo)) {
+				n = n->right.get();
+			} else {
+				left = A::combine(A::combine(A::of(n->x, n->v), agg_of(n->right.get())), left);
+				n = n->left.get();
+			}
+		}
+
+		typename A::type right = A::identity();
+		for (Node const* n=top->right.get(); n;) {
+			if (!cmp(n->x, hi)) {
+				n = n->left.get();
+			} else {
+				right = A::combine(right, A::combine(agg_of(n->left.get()), A::of(n->x, n->v)));
+				n = n->right.get();
+			}
+		}
+
+		return A::combine(A::combine(left, A::of(top->x, top->v)), right);
+	}
+
+	Ptr* parent_ptr() {
 		if (parent) return parent->left.get()==this ? &parent->left : &parent->right;
 		else if (root) return &root->ptr;
 		else return nullptr;
 	}
 
 	Node* rot_right() {
-		std::unique_ptr<Node>& ptr = *parent_ptr();
+		Ptr& ptr = *parent_ptr();
 
 		ptr.release();
 		ptr.swap(right);
 		right.swap(ptr->left);
 		if (right) right->parent = this;
-		ptr->left=std::unique_ptr<Node>(this);
+		ptr->left=Ptr(this);
 		
 		ptr->parent = parent;
 		parent = ptr.get();
@@ -184,17 +568,20 @@ struct Node {
 		if (h_diff>=0) ptr->h_diff--;
 		else ptr->h_diff += h_diff-1;
 
+		update();
+		ptr->update();
+
 		return ptr.get();
 	}
 
 	Node* rot_left() {
-		std::unique_ptr<Node>& ptr = *parent_ptr();
+		Ptr& ptr = *parent_ptr();
 
 		ptr.release();
 		ptr.swap(left);
 		left.swap(ptr->right);
 		if (left) left->parent = this;
-		ptr->right=std::unique_ptr<Node>(this);
+		ptr->right=Ptr(this);
 
 		ptr->parent = parent;
 		parent = ptr.get();
@@ -207,6 +594,9 @@ struct Node {
 		if (h_diff<=0) ptr->h_diff++;
 		else ptr->h_diff += h_diff+1;
 
+		update();
+		ptr->update();
+
 		return ptr.get();
 	}
 
@@ -304,20 +694,24 @@ struct Node {
 	}
 
 	template<class Compare=std::less<K>>
-	void insert_node(std::unique_ptr<Node>&& node, Compare cmp={}) {
+	void insert_node(Ptr&& node, Compare cmp={}) {
 		Node* res = find(node->x, cmp);
 
+		Node* added = node.get();
+
 		bool lt = cmp(node->x,res->x);
 		if (lt) {
 			res->left = std::move(node);
 			res->left->parent = res;
 
 			res->rebalance(false, false);
+			added->update_path();
 		} else if (cmp(res->x,node->x) || !res->right) {
 			res->right = std::move(node);
 			res->right->parent = res;
 
 			res->rebalance(true, false);
+			added->update_path();
 		} else {
 			res->right->insert_node(std::move(node), cmp);
 		}
@@ -325,16 +719,16 @@ struct Node {
 
 	template<class Compare=std::less<K>>
 	Node* insert(K&& ix, V&& iv, Compare ins_cmp={}) {
-		std::unique_ptr<Node> node = std::make_unique<Node>(std::move(ix), std::move(iv));
+		Ptr node = new_node(Pooled ? Pool::of(this) : nullptr, std::move(ix), std::move(iv));
 		Node* ret = node.get();
 		insert_node(std::move(node), ins_cmp);
 		return ret;
 	}
 
-	std::unique_ptr<Node> remove() {
-		std::unique_ptr<Node>& ptr = *parent_ptr();
+	Ptr remove() {
+		Ptr& ptr = *parent_ptr();
 
-		std::unique_ptr<Node> ret;
+		Ptr ret;
 		if (left && !right) {
 			ret.swap(left);
 		} else if (right && !left) {
@@ -347,9 +741,9 @@ struct Node {
 		}
 
 		if (left && right) {
-			std::unique_ptr<Node>* rl_ref = &right;
+			Ptr* rl_ref = &right;
 			while ((*rl_ref)->left) rl_ref = &(*rl_ref)->left;
-			std::unique_ptr<Node>& rl = *rl_ref;
+			Ptr& rl = *rl_ref;
 
 			bool left_child = rl!=right;
 
@@ -357,7 +751,7 @@ struct Node {
 			ret.swap(rl);
 
 			Node* prev_parent = left_child ? ret->parent : ret.get();
-			std::unique_ptr<Node> prev_r;
+			Ptr prev_r;
 
 			if (ret->right) {
 				rl.swap(ret->right);
@@ -382,32 +776,38 @@ struct Node {
 			ptr.swap(ret);
 
 			prev_parent->rebalance(left_child, true);
+			prev_parent->update_path();
 		} else {
 			ptr.swap(ret);
 
-			if (parent) parent->rebalance(&parent->left==&ptr, true);
+			if (parent) {
+				parent->rebalance(&parent->left==&ptr, true);
+				parent->update_path();
+			}
 		}
 
+		//detached with no children
+		ret->update();
 		return ret;
 	}
 
 	Iterator begin() {
-		Iterator iter {.current=this, .begin=this, .end=parent};
+		Iterator iter {.begin=this, .end=parent, .current=this};
 		while (iter.current->left) iter.current = iter.current->left.get();
 		return iter;
 	}
 
 	Iterator end() {
-		return {.current=parent, .begin=this, .end=parent};
+		return {.begin=this, .end=parent, .current=parent};
 	}
 
 	Iterator iter_ref(Node* ref) {
-		return {.current=ref, .begin=this, .end=parent};
+		return {.begin=this, .end=parent, .current=ref};
 	}
 
 	void swap_positions(Node* other) {
-		std::unique_ptr<Node>* pptr = parent_ptr();
-		std::unique_ptr<Node>* opptr = other->parent_ptr();
+		Ptr* pptr = parent_ptr();
+		Ptr* opptr = other->parent_ptr();
 		pptr->release();
 		opptr->release();
 
@@ -430,12 +830,223 @@ struct Node {
 		if (left) left->parent = this;
 		if (other->right) other->right->parent = other;
 		if (other->left) other->left->parent = other;
+
+		//if one is above the other the second pass fixes what the first computed from stale data
+		update_path();
+		other->update_path();
+	}
+
+	static int height(Node const* n) {
+		int h=0;
+		for (; n; h++) n = n->h_diff<0 ? n->left.get() : n->right.get();
+		return h;
+	}
+
+	//takes a tree apart into its left subtree, top node and right subtree
+	static std::tuple<Tree, Ptr, Tree> expose(Tree t) {
+		Node* n = t.ptr.get();
+		int hl = n->h_diff>0 ? t.h-1-n->h_diff : t.h-1;
+		int hr = n->h_diff<0 ? t.h-1+n->h_diff : t.h-1;
+
+		Tree l {.ptr=std::move(n->left), .h=hl};
+		Tree r {.ptr=std::move(n->right), .h=hr};
+		if (l.ptr) l.ptr->parent = nullptr;
+		if (r.ptr) r.ptr->parent = nullptr;
+
+		return {std::move(l), std::move(t.ptr), std::move(r)};
+	}
+
+	//m on top of l and r
+	static Tree make(Tree l, Ptr m, Tree r) {
+		m->parent = nullptr;
+		m->root = nullptr;
+		m->h_diff = r.h-l.h;
+
+		m->left = std::move(l.ptr);
+		m->right = std::move(r.ptr);
+		if (m->left) m->left->parent = m.get();
+		if (m->right) m->right->parent = m.get();
+		m->update();
+
+		return {.ptr=std::move(m), .h=std::max(l.h, r.h)+1};
+	}
+
+	static Tree rotate_left(Tree t) {
+		Tree a, y, b, c;
+		Ptr x, yn;
+		std::tie(a, x, y) = expose(std::move(t));
+		std::tie(b, yn, c) = expose(std::move(y));
+		return make(make(std::move(a), std::move(x), std::move(b)), std::move(yn), std::move(c));
 	}
 
-//	Node merge(Node* other) {
-//		Node new_root;
-//		for (Iterator iter = begin(); )
-//	}
+	static Tree rotate_right(Tree t) {
+		Tree x, a, b, c;
+		Ptr xn, yn;
+		std::tie(x, yn, c) = expose(std::move(t));
+		std::tie(a, xn, b) = expose(std::move(x));
+		return make(std::move(a), std::move(xn), make(std::move(b), std::move(yn), std::move(c)));
+	}
+
+	//l is more than one taller than r: goes down l's right spine to where r fits, rotating on the way back up
+	static Tree join_right(Tree l, Ptr m, Tree r) {
+		Tree ll, c;
+		Ptr top;
+		std::tie(ll, top, c) = expose(std::move(l));
+
+		if (c.h<=r.h+1) {
+			Tree t = make(std::move(c), std::move(m), std::move(r));
+			if (t.h<=ll.h+1) return make(std::move(ll), std::move(top), std::move(t));
+			return rotate_left(make(std::move(ll), std::move(top), rotate_right(std::move(t))));
+		}
+
+		Tree t = join_right(std::move(c), std::move(m), std::move(r));
+		bool balanced = t.h<=ll.h+1;
+		Tree ret = make(std::move(ll), std::move(top), std::move(t));
+		return balanced ? std::move(ret) : rotate_left(std::move(ret));
+	}
+
+	static Tree join_left(Tree l, Ptr m, Tree r) {
+		Tree c, rr;
+		Ptr top;
+		std::tie(c, top, rr) = expose(std::move(r));
+
+		if (c.h<=l.h+1) {
+			Tree t = make(std::move(l), std::move(m), std::move(c));
+			if (t.h<=rr.h+1) return make(std::move(t), std::move(top), std::move(rr));
+			return rotate_right(make(rotate_left(std::move(t)), std::move(top), std::move(rr)));
+		}
+
+		Tree t = join_left(std::move(l), std::move(m), std::move(c));
+		bool balanced = t.h<=rr.h+1;
+		Tree ret = make(std::move(t), std::move(top), std::move(rr));
+		return balanced ? std::move(ret) : rotate_right(std::move(ret));
+	}
+
+	//everything in l, then m, then everything in r
+	static Tree join(Tree l, Ptr m, Tree r) {
+		if (l.h>r.h+1) return join_right(std::move(l), std::move(m), std::move(r));
+		if (r.h>l.h+1) return join_left(std::move(l), std::move(m), std::move(r));
+		return make(std::move(l), std::move(m), std::move(r));
+	}
+
+	static std::pair<Tree, Ptr> split_last(Tree t) {
+		Tree l, r;
+		Ptr m;
+		std::tie(l, m, r) = expose(std::move(t));
+		if (!r.ptr) return {std::move(l), std::move(m)};
+
+		auto [rest, last] = split_last(std::move(r));
+		return {join(std::move(l), std::move(m), std::move(rest)), std::move(last)};
+	}
+
+	static Tree join2(Tree l, Tree r) {
+		if (!l.ptr) return r;
+		auto [rest, last] = split_last(std::move(l));
+		return join(std::move(rest), std::move(last), std::move(r));
+	}
+
+	//keys less than key, and the rest
+	template<class Compare>
+	static std::pair<Tree, Tree> split(Tree t, K const& key, Compare& cmp) {
+		if (!t.ptr) return {};
+
+		Tree l, r;
+		Ptr m;
+		std::tie(l, m, r) = expose(std::move(t));
+
+		if (cmp(m->x, key)) {
+			auto [rl, rr] = split(std::move(r), key, cmp);
+			return {join(std::move(l), std::move(m), std::move(rl)), std::move(rr)};
+		} else {
+			auto [ll, lr] = split(std::move(l), key, cmp);
+			return {std::move(ll), join(std::move(lr), std::move(m), std::move(r))};
+		}
+	}
+
+	//keys less than key, the node with key (or null) and keys greater, for trees without duplicate keys
+	template<class Compare>
+	static std::tuple<Tree, Ptr, Tree> split3(Tree t, K const& key, Compare& cmp) {
+		if (!t.ptr) return {};
+
+		Tree l, r;
+		Ptr m;
+		std::tie(l, m, r) = expose(std::move(t));
+
+		if (cmp(m->x, key)) {
+			Tree rl, rr;
+			Ptr found;
+			std::tie(rl, found, rr) = split3(std::move(r), key, cmp);
+			return {join(std::move(l), std::move(m), std::move(rl)), std::move(found), std::move(rr)};
+		} else if (cmp(key, m->x)) {
+			Tree ll, lr;
+			Ptr found;
+			std::tie(ll, found, lr) = split3(std::move(l), key, cmp);
+			return {std::move(ll), std::move(found), join(std::move(lr), std::move(m), std::move(r))};
+		} else {
+			return {std::move(l), std::move(m), std::move(r)};
+		}
+	}
+
+	//sorted nodes [lo, hi) as a tree. halves differ in size by at most one, so in height too
+	static Tree build(std::vector<Ptr>& nodes, size_t lo, size_t hi) {
+		if (lo==hi) return {};
+
+		size_t mid = lo+(hi-lo)/2;
+		Tree l = build(nodes, lo, mid);
+		return make(std::move(l), std::move(nodes[mid]), build(nodes, mid+1, hi));
+	}
+
+	//subtrees at least this tall (~2^PARALLEL_HEIGHT entries) are worth a thread in set operations
+	static constexpr int PARALLEL_HEIGHT = 14;
+
+	template<class F, class G>
+	static void fork(bool parallel, F f, G g) {
+		if (!parallel) {
+			f();
+			g();
+			return;
+		}
+
+		std::thread t(f);
+		g();
+		t.join();
+	}
+
+	//where both have a key, a's node is kept
+	template<class Compare>
+	static Tree set_union(Tree a, Tree b, unsigned threads, Compare& cmp) {
+		if (!a.ptr) return b;
+		if (!b.ptr) return a;
+
+		bool parallel = threads>1 && b.h>=PARALLEL_HEIGHT;
+		Tree al, ar, bl, br, l, r;
+		Ptr bm, found;
+		std::tie(bl, bm, br) = expose(std::move(b));
+		std::tie(al, found, ar) = split3(std::move(a), bm->x, cmp);
+
+		fork(parallel, [&]() { l = set_union(std::move(al), std::move(bl), threads/2, cmp); },
+		     [&]() { r = set_union(std::move(ar), std::move(br), threads-threads/2, cmp); });
+
+		return join(std::move(l), found ? std::move(found) : std::move(bm), std::move(r));
+	}
+
+	//keeps a's nodes, b's are freed
+	template<class Compare>
+	static Tree set_intersection(Tree a, Tree b, unsigned threads, Compare& cmp) {
+		if (!a.ptr || !b.ptr) return {};
+
+		bool parallel = threads>1 && b.h>=PARALLEL_HEIGHT;
+		Tree al, ar, bl, br, l, r;
+		Ptr bm, found;
+		std::tie(bl, bm, br) = expose(std::move(b));
+		std::tie(al, found, ar) = split3(std::move(a), bm->x, cmp);
+
+		fork(parallel, [&]() { l = set_intersection(std::move(al), std::move(bl), threads/2, cmp); },
+		     [&]() { r = set_intersection(std::move(ar), std::move(br), threads-threads/2, cmp); });
+
+		if (found) return join(std::move(l), std::move(found), std::move(r));
+		return join2(std::move(l), std::move(r));
+	}
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,157 @@
+#ifndef CORECOMMON_SRC_CONCURRENTMAP_HPP_
+#define CORECOMMON_SRC_CONCURRENTMAP_HPP_
+
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <mutex>
+
+#include "map.hpp"
+#include "locktable.hpp"
+
+//Map split into a power of two shards by the top bits of the hash, each behind its own stripe of a LockTable.
+//Map takes its group index from the low bits, so keys in one shard still spread over that shard's groups.
+//keys are hashed once, and the shard's map is handed the same hash.
+//Mutex picks the stripe lock (see LockTable), reads take it shared if it's a shared_mutex
+template<class K, class V, class Hash = MapHash<K>, class Mutex = std::shared_mutex>
+class ConcurrentMap {
+ public:
+	using ShardMap = Map<K, V, false, std::allocator, Hash>;
+	using Lookup = typename ShardMap::Lookup;
+	using Locks = LockTable<K, Mutex, Hash>;
+
+	static constexpr size_t CACHE_LINE=64;
+
+ private:
+	//padded so inserts into one shard don't invalidate its neighbour's map header
+	struct alignas(CACHE_LINE) Shard {
+		ShardMap map;
+	};
+
+	//shard i is guarded by stripe i
+	mutable Locks locks;
+	std::unique_ptr<Shard[]> shards;
+
+	size_t shard(size_t h) const {
+		return locks.stripe_for_hash(h);
+	}
+
+	auto read_lock(size_t i) const {
+		if constexpr (Locks::SHARED) return locks.lock_stripe_shared(i);
+		else return locks.lock_stripe(i);
+	}
+
+ public:
+	//rounded up to a power of two
+	explicit ConcurrentMap(unsigned num_shards=64): locks(num_shards), shards(std::make_unique<Shard[]>(locks.num_stripes())) {}
+
+	size_t num_shards() const {
+		return locks.num_stripes();
+	}
+
+	//acquisitions and contention summed over every shard's lock
+	typename Locks::Stats lock_stats() const {
+		return locks.total_stats();
+	}
+
+	//copies the value out, since a reference wouldn't outlive the lock
+	std::optional<V> get(Lookup k) const {
+		size_t h = ShardMap::hash(k);
+		size_t i = shard(h);
+		auto lock = read_lock(i);
+
+		V const* v = shards[i].map.find_hashed(k, h);
+		return v ? std::make_optional<V>(*v) : std::optional<V>();
+	}
+
+	//calls f with the value (or nullptr) while holding the shard's read lock
+	template<class F>
+	auto read(Lookup k, F f) const {
+		size_t h = ShardMap::hash(k);
+		size_t i = shard(h);
+		auto lock = read_lock(i);
+		return f(shards[i].map.find_hashed(k, h));
+	}
+
+	bool contains(Lookup k) const {
+		return read(k, [](V const* v) { return v!=nullptr; });
+	}
+
+	std::optional<V> insert(K const& k, V v) {
+		size_t h = ShardMap::hash(k);
+		size_t i = shard(h);
+		auto lock = locks.lock_stripe(i);
+		return shards[i].map.insert_hashed(k, std::move(v), h);
+	}
+
+	std::optional<V> insert(K&& k, V v) {
+		size_t h = ShardMap::hash(k);
+		size_t i = shard(h);
+		auto lock = locks.lock_stripe(i);
+		return shards[i].map.insert_hashed(std::move(k), std::move(v), h);
+	}
+
+	std::optional<V> remove(Lookup k) {
+		size_t h = ShardMap::hash(k);
+		size_t i = shard(h);
+		auto lock = locks.lock_stripe(i);
+		return shards[i].map.remove_hashed(k, h);
+	}
+
+	//returns the value for k, computing it with f() if absent. f runs at most once per key, under the shard's write
+	//lock, so it shouldn't touch this map. present keys only take the read lock
+	template<class F>
+	V compute_if_absent(K const& k, F f) {
+		size_t h = ShardMap::hash(k);
+		size_t i = shard(h);
+
+		{
+			auto lock = read_lock(i);
+			if (V const* v = shards[i].map.find_hashed(k, h)) return *v;
+		}
+
+		auto lock = locks.lock_stripe(i);
+		//someone may have inserted it between the locks
+		if (V* v = shards[i].map.find_hashed(k, h)) return *v;
+		return *shards[i].map.emplace_hashed(h, k, f()).first;
+	}
+
+	//calls f on the shard's map with its write lock held, eg. for several updates that have to be atomic
+	template<class F>
+	auto update(Lookup k, F f) {
+		size_t i = shard(ShardMap::hash(k));
+		auto lock = locks.lock_stripe(i);
+		return f(shards[i].map);
+	}
+
+	//visits every entry as f(key, value), one shard at a time under its read lock.
+	//entries added or removed in other shards while this runs may or may not be seen
+	template<class F>
+	void for_each(F f) const {
+		for (size_t i=0; i<num_shards(); i++) {
+			auto lock = read_lock(i);
+			for (auto const& kv: shards[i].map) f(kv.first, kv.second);
+		}
+	}
+
+	//same, with each shard's write lock and its map
+	template<class F>
+	void for_each_shard(F f) {
+		for (size_t i=0; i<num_shards(); i++) {
+			auto lock = locks.lock_stripe(i);
+			f(shards[i].map);
+		}
+	}
+
+	size_t size() const {
+		size_t n=0;
+		for (size_t i=0; i<num_shards(); i++) {
+			auto lock = read_lock(i);
+			n += shards[i].map.count;
+		}
+
+		return n;
+	}
+};
+
+#endif //CORECOMMON_SRC_CONCURRENTMAP_HPP_
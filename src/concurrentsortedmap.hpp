@@ -0,0 +1,496 @@
+#ifndef CORECOMMON_SRC_CONCURRENTSORTEDMAP_HPP_
+#define CORECOMMON_SRC_CONCURRENTSORTEDMAP_HPP_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+//lock-free version of SortedMap for many threads inserting, removing and range-scanning at once
+//(herlihy & shavit's lock-free skip list). towers are linked bottom-up with CAS. a node is deleted by swapping its value
+//to null, which is the linearization point. its links are then marked top-down and searches unlink marked nodes as they
+//pass. values are replaced by swapping the pointer, so readers always see a whole value.
+//nodes and values are freed by epoch based reclamation like SnapshotMap: every operation pins a slot, and retired memory
+//is freed once no slot is pinned at an epoch that could still reach it.
+//scans are weakly consistent: they see every entry present for the whole scan and none removed before it started,
+//in key order, and may or may not see concurrent changes
+template<class K, class V, class Compare=std::less<K>>
+class ConcurrentSortedMap {
+ public:
+	static constexpr size_t CACHE_LINE=64;
+
+	struct PinSlotsExhausted: public std::exception {
+		char const* what() const noexcept override {
+			return "no free pin slot in concurrent sorted map";
+		}
+	};
+
+ private:
+	static constexpr unsigned MAX_HEIGHT=24;
+	//retired blocks a slot collects before it tries to free them
+	static constexpr size_t RECLAIM_AT=64;
+	static constexpr uintptr_t MARK=1;
+
+	struct Node;
+
+	//pointer to the next node, with the low bit set once the owning node is deleted at this level
+	using Link = std::atomic<uintptr_t>;
+
+	//the tower of height links follows the node in the same allocation
+	struct alignas(std::max(alignof(K), alignof(Link))) Node {
+		K key;
+		//null once removed
+		std::atomic<V*> value;
+		unsigned height;
+		//the inserter and the remover each drop one when done with the node's links, the last one retires it
+		std::atomic<unsigned> owners;
+
+		Link* tower() {
+			return reinterpret_cast<Link*>(this+1);
+		}
+	};
+
+	struct Retired {
+		void* p;
+		void (*free)(void*);
+		uint64_t epoch;
+	};
+
+	//retired and reclaim_at are only touched by whoever has the slot claimed
+	struct alignas(CACHE_LINE) Slot {
+		std::atomic<uint64_t> epoch;
+		std::atomic<bool> claimed;
+		std::vector<Retired> retired;
+		size_t reclaim_at;
+	};
+
+	static Node* ptr(uintptr_t l) {
+		return reinterpret_cast<Node*>(l & ~MARK);
+	}
+
+	static uintptr_t ref(Node* n) {
+		return reinterpret_cast<uintptr_t>(n);
+	}
+
+	static bool marked(uintptr_t l) {
+		return l & MARK;
+	}
+
+	alignas(CACHE_LINE) std::array<Link, MAX_HEIGHT> head;
+	alignas(CACHE_LINE) std::atomic<size_t> count;
+	std::atomic<uint64_t> epoch;
+
+	std::unique_ptr<Slot[]> slots;
+	size_t num_slots;
+	Compare cmp;
+
+	static unsigned random_height() {
+		static thread_local uint64_t rng = 0x9E3779B97F4A7C15ull ^ std::hash<std::thread::id>()(std::this_thread::get_id());
+		rng ^= rng<<13;
+		rng ^= rng>>7;
+		rng ^= rng<<17;
+
+		//two random bits per level like SortedMap, capped at MAX_HEIGHT
+		return 1+__builtin_ctzll(rng | (1ull<<(2*(MAX_HEIGHT-1))))/2;
+	}
+
+	static Node* new_node(unsigned h, K const& k, V* v) {
+		void* mem = ::operator new(sizeof(Node)+h*sizeof(Link), std::align_val_t(alignof(Node)));
+
+		Node* n;
+		try {
+			n = ::new (mem) Node {.key=k, .value=v, .height=h, .owners=2};
+		} catch (...) {
+			::operator delete(mem, std::align_val_t(alignof(Node)));
+			throw;
+		}
+
+		for (unsigned l=0; l<h; l++) ::new (&n->tower()[l]) Link(0);
+		return n;
+	}
+
+	//doesn't free the value
+	static void free_node(void* p) {
+		Node* n = static_cast<Node*>(p);
+		n->~Node();
+		::operator delete(n, std::align_val_t(alignof(Node)));
+	}
+
+	static void free_value(void* p) {
+		delete static_cast<V*>(p);
+	}
+
+	//frees everything in the slot's list retired before every pinned epoch
+	void reclaim(Slot& slot) {
+		uint64_t oldest = UINT64_MAX;
+		for (size_t i=0; i<num_slots; i++) {
+			uint64_t e = slots[i].epoch.load();
+			if (e!=0 && e<oldest) oldest=e;
+		}
+
+		auto keep = slot.retired.begin();
+		for (Retired& r: slot.retired) {
+			if (r.epoch>=oldest) *keep++ = r;
+			else r.free(r.p);
+		}
+
+		slot.retired.erase(keep, slot.retired.end());
+		//a reader stalled at an old epoch keeps everything alive, don't rescan the slots on every unpin meanwhile
+		slot.reclaim_at = std::max(RECLAIM_AT, 2*slot.retired.size());
+	}
+
+	//keeps everything reachable when it was made alive until destroyed
+	class Guard {
+	 private:
+		ConcurrentSortedMap* map;
+		Slot* slot;
+
+	 public:
+		explicit Guard(ConcurrentSortedMap& map): map(&map), slot(nullptr) {
+			size_t start = std::hash<std::thread::id>()(std::this_thread::get_id());
+			for (size_t i=0; i<map.num_slots && !slot; i++) {
+				Slot& s = map.slots[(start+i)%map.num_slots];
+				bool expected=false;
+				if (s.claimed.compare_exchange_strong(expected, true)) slot=&s;
+			}
+
+			if (!slot) throw PinSlotsExhausted();
+
+			//announced before anything is loaded from the list (both seq_cst), see SnapshotMap::Reader::pin
+			slot->epoch.store(map.epoch.load());
+		}
+
+		Guard(Guard const&) = delete;
+
+		Guard(Guard&& other): map(other.map), slot(other.slot) {
+			other.slot=nullptr;
+		}
+
+		//p has to be unreachable for anyone pinning from now on
+		void retire(void* p, void (*free)(void*)) {
+			slot->retired.push_back(Retired {.p=p, .free=free, .epoch=map->epoch.fetch_add(1)});
+		}
+
+		~Guard() {
+			if (!slot) return;
+
+			slot->epoch.store(0);
+			if (slot->retired.size()>=slot->reclaim_at) map->reclaim(*slot);
+			slot->claimed.store(false, std::memory_order_release);
+		}
+	};
+
+	//fills the link before and the node after k at every level, unlinking marked nodes on the way.
+	//returns false if a predecessor got deleted under it and the search has to start over.
+	//only ever follows links out of nodes seen unmarked at that level, since a marked node's links may point at nodes
+	//that were retired before we pinned
+	bool try_find(K const& k, Link** preds, Node** succs) {
+		Link* links = head.data();
+
+		for (unsigned l=MAX_HEIGHT; l-->0;) {
+			Node* cur = ptr(links[l].load());
+
+			while (cur) {
+				uintptr_t next = cur->tower()[l].load();
+
+				if (marked(next)) {
+					uintptr_t expected = ref(cur);
+					if (!links[l].compare_exchange_strong(expected, next & ~MARK)) return false;
+
+					cur = ptr(next);
+					continue;
+				}
+
+				if (!cmp(cur->key, k)) break;
+
+				links = cur->tower();
+				cur = ptr(next);
+			}
+
+			preds[l] = &links[l];
+			succs[l] = cur;
+		}
+
+		return true;
+	}
+
+	//the first unmarked node not less than k, possibly already removed (null value)
+	Node* find(K const& k, Link** preds, Node** succs) {
+		while (!try_find(k, preds, succs)) {}
+		return succs[0];
+	}
+
+	Node* lower_node(K const& k) {
+		std::array<Link*, MAX_HEIGHT> preds;
+		std::array<Node*, MAX_HEIGHT> succs;
+		return find(k, preds.data(), succs.data());
+	}
+
+	bool matches(Node* n, K const& k) const {
+		return n && !cmp(k, n->key);
+	}
+
+	//marks every level top-down, level 0 last, so a node unmarked at level l is unmarked below it too
+	static void mark(Node* n) {
+		for (unsigned l=n->height; l-->0;) n->tower()[l].fetch_or(MARK);
+	}
+
+	void release(Node* n, Guard& g) {
+		if (n->owners.fetch_sub(1)==1) g.retire(n, free_node);
+	}
+
+	//links n's upper levels bottom-up. gives up once it finds n marked, and then unlinks whatever it managed to link
+	//after the remover's search went past
+	void link_upper(Node* n, Link** preds, Node** succs) {
+		for (unsigned l=1; l<n->height; l++) {
+			for (;;) {
+				uintptr_t next = n->tower()[l].load();
+				if (marked(next)) {
+					find(n->key, preds, succs);
+					return;
+				}
+
+				//only a remover's mark changes it besides us, so a failure is picked up at the top
+				if (ptr(next)!=succs[l] && !n->tower()[l].compare_exchange_strong(next, ref(succs[l]))) continue;
+
+				uintptr_t expected = ref(succs[l]);
+				if (preds[l]->compare_exchange_strong(expected, ref(n))) break;
+				find(n->key, preds, succs);
+			}
+
+			if (marked(n->tower()[l].load())) {
+				find(n->key, preds, succs);
+				return;
+			}
+		}
+	}
+
+	//level 0 forward from n to the first entry still present, or null at to
+	Node* skip_removed(Node* n, K const* to) const {
+		while (n && !n->value.load()) n = ptr(n->tower()[0].load());
+		return n && to && !cmp(n->key, *to) ? nullptr : n;
+	}
+
+ public:
+	//scan over level 0 in key order. holds a pin, so keep it short lived: retired memory isn't freed while it exists
+	class Range {
+	 private:
+		ConcurrentSortedMap* map;
+		Guard guard;
+		Node* first;
+		std::optional<K> to;
+
+		friend ConcurrentSortedMap;
+		Range(ConcurrentSortedMap& map, Guard guard, Node* first, std::optional<K> to):
+				map(&map), guard(std::move(guard)), first(first), to(std::move(to)) {}
+
+	 public:
+		class Iterator {
+		 private:
+			Range const* range;
+			Node* node;
+			//the value when we got to the node, valid while the range is pinned even if replaced meanwhile
+			V* value;
+
+			friend Range;
+			Iterator(Range const* range, Node* node): range(range), node(node), value(node ? node->value.load() : nullptr) {
+				//removed between skip_removed and here
+				if (node && !value) ++*this;
+			}
+
+		 public:
+			using iterator_category = std::forward_iterator_tag;
+			using difference_type = std::ptrdiff_t;
+			using value_type = std::pair<K const&, V const&>;
+			using pointer = void;
+			using reference = std::pair<K const&, V const&>;
+
+			Iterator(): range(nullptr), node(nullptr), value(nullptr) {}
+
+			Iterator& operator++() {
+				K const* to = range->to ? &*range->to : nullptr;
+
+				do {
+					node = range->map->skip_removed(ptr(node->tower()[0].load()), to);
+					value = node ? node->value.load() : nullptr;
+				} while (node && !value);
+
+				return *this;
+			}
+
+			Iterator operator++(int) {
+				Iterator cpy = *this;
+				++*this;
+				return cpy;
+			}
+
+			bool operator==(Iterator const& other) const {
+				return node==other.node;
+			}
+
+			bool operator!=(Iterator const& other) const {
+				return node!=other.node;
+			}
+
+			reference operator*() const {
+				return reference(node->key, *value);
+			}
+		};
+
+		Range(Range&&) = default;
+
+		Iterator begin() const {
+			return Iterator(this, first);
+		}
+
+		Iterator end() const {
+			return Iterator();
+		}
+	};
+
+	//max_pins is how many operations and ranges can be in flight at once, over all threads
+	explicit ConcurrentSortedMap(size_t max_pins=256, Compare cmp={}):
+			count(0), epoch(1), slots(std::make_unique<Slot[]>(max_pins)), num_slots(max_pins), cmp(cmp) {
+		for (Link& l: head) l=0;
+
+		for (size_t i=0; i<num_slots; i++) {
+			slots[i].epoch=0;
+			slots[i].claimed=false;
+			slots[i].reclaim_at=RECLAIM_AT;
+		}
+	}
+
+	ConcurrentSortedMap(ConcurrentSortedMap const&) = delete;
+
+	//no other thread may be using it by now
+	~ConcurrentSortedMap() {
+		for (Node* n=ptr(head[0].load()); n;) {
+			Node* next = ptr(n->tower()[0].load());
+			delete n->value.load();
+			free_node(n);
+			n=next;
+		}
+
+		for (size_t i=0; i<num_slots; i++) {
+			for (Retired& r: slots[i].retired) r.free(r.p);
+		}
+	}
+
+	//entries present, momentarily
+	size_t size() const {
+		return count.load(std::memory_order_relaxed);
+	}
+
+	std::optional<V> get(K const& k) {
+		Guard g(*this);
+		Node* n = lower_node(k);
+		V* v = matches(n, k) ? n->value.load() : nullptr;
+		return v ? std::make_optional<V>(*v) : std::optional<V>();
+	}
+
+	bool contains(K const& k) {
+		Guard g(*this);
+		Node* n = lower_node(k);
+		return matches(n, k) && n->value.load();
+	}
+
+	//returns the previous value if k was already present
+	std::optional<V> insert(K const& k, V v) {
+		Guard g(*this);
+		std::array<Link*, MAX_HEIGHT> preds;
+		std::array<Node*, MAX_HEIGHT> succs;
+
+		std::unique_ptr<V> nv = std::make_unique<V>(std::move(v));
+		Node* n = nullptr;
+
+		for (;;) {
+			Node* found = find(k, preds.data(), succs.data());
+
+			if (matches(found, k)) {
+				V* old = found->value.load();
+				while (old && !found->value.compare_exchange_weak(old, nv.get())) {}
+
+				if (old) {
+					nv.release();
+					if (n) free_node(n);
+
+					//others may still be reading it, so copy rather than move
+					std::optional<V> ret(*old);
+					g.retire(old, free_value);
+					return ret;
+				}
+
+				//being removed, help mark it so the next search unlinks it
+				mark(found);
+				continue;
+			}
+
+			if (!n) n = new_node(random_height(), k, nv.get());
+			for (unsigned l=0; l<n->height; l++) n->tower()[l].store(ref(succs[l]), std::memory_order_relaxed);
+
+			uintptr_t expected = ref(succs[0]);
+			if (preds[0]->compare_exchange_strong(expected, ref(n))) break;
+		}
+
+		nv.release();
+		count.fetch_add(1, std::memory_order_relaxed);
+
+		link_upper(n, preds.data(), succs.data());
+		release(n, g);
+		return std::optional<V>();
+	}
+
+	std::optional<V> remove(K const& k) {
+		Guard g(*this);
+		std::array<Link*, MAX_HEIGHT> preds;
+		std::array<Node*, MAX_HEIGHT> succs;
+
+		Node* n = find(k, preds.data(), succs.data());
+		if (!matches(n, k)) return std::optional<V>();
+
+		V* v = n->value.load();
+		while (v && !n->value.compare_exchange_weak(v, nullptr)) {}
+		//someone else removed it first
+		if (!v) return std::optional<V>();
+
+		count.fetch_sub(1, std::memory_order_relaxed);
+		std::optional<V> ret(*v);
+		g.retire(v, free_value);
+
+		mark(n);
+		find(k, preds.data(), succs.data());
+		release(n, g);
+		return ret;
+	}
+
+	//entries with from <= key < to
+	Range range(K const& from, K const& to) {
+		Guard g(*this);
+		Node* first = skip_removed(lower_node(from), &to);
+		return Range(*this, std::move(g), first, std::optional<K>(to));
+	}
+
+	//entries with key >= from
+	Range range_from(K const& from) {
+		Guard g(*this);
+		Node* first = skip_removed(lower_node(from), nullptr);
+		return Range(*this, std::move(g), first, std::optional<K>());
+	}
+
+	Range all() {
+		Guard g(*this);
+		Node* first = skip_removed(ptr(head[0].load()), nullptr);
+		return Range(*this, std::move(g), first, std::optional<K>());
+	}
+};
+
+#endif //CORECOMMON_SRC_CONCURRENTSORTEDMAP_HPP_
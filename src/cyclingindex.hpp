@@ -1,41 +1,138 @@
 #ifndef SRC_CYCLINGINDEX_HPP_
 #define SRC_CYCLINGINDEX_HPP_
 
-#include <vector>
-
-struct {
-	std::vector<unsigned> bounds;
-	unsigned i;
-	unsigned new_bound;
-} cycling_index_t;
-
-cycling_index_t cindex_new(unsigned l) {
-	cycling_index_t cin = {.bounds=vector_new(sizeof(unsigned)), .i=0, .new_bound=0};
-	vector_populate(&cin.size, l, &(unsigned){0});
-	return cin;
-}
-
-void cindex_cycle(cycling_index_t* cin) {
-	*(unsigned*)vector_get(&cin->size, cin->i) = cin->new_bound;
-	cin->i = (cin->i+1)%cin->size.length;
-	if (cin->i==0) cin->new_bound=0;
-}
-
-unsigned cindex_next(cycling_index_t* cin, unsigned* i) {
-	unsigned* prevlen = (unsigned*)vector_get(&cin->size, cin->i);
-	if (*i==*prevlen && cin->i<cin->size.length-1) {
-		*i = *(unsigned*)vector_get(&cin->size, cin->size.length-1);
-	}
-
-	return (*i)++;
-}
-
-unsigned cindex_get(cycling_index_t* cin) {
-	return cindex_next(cin, &cin->new_bound);
-}
-
-unsigned cindex_start(cycling_index_t* cin) {
-	return cin->i==0?0:*(unsigned*)vector_get(&cin->size, cin->i-1);
-}
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+//hands out slots of a ring buffer of capacity entries, grouped into the last N generations. cycle() starts a new
+//generation and drops the oldest one in bulk, in O(1), eg. one generation per second for a window of the last N
+//seconds of samples. slots are positions counting up from 0, so a position is never reused; the buffer index is
+//position%capacity. doesn't allocate
+template<size_t N>
+struct CyclingIndex {
+	static_assert(N>0, "needs a generation");
+
+	//positions [begin, end) of one generation
+	struct Window {
+		uint64_t begin=0, end=0;
+
+		uint64_t size() const {
+			return end-begin;
+		}
+	};
+
+	size_t capacity;
+	uint64_t head=0;
+	uint64_t gen=0;
+	//start of generation g at g%N, for the live ones
+	std::array<uint64_t, N> starts {};
+
+	explicit CyclingIndex(size_t capacity): capacity(capacity) {}
+
+	size_t index(uint64_t pos) const {
+		return pos%capacity;
+	}
+
+	//first position of the oldest live generation, which is gen-N+1 (or 0, whose start is 0)
+	uint64_t oldest() const {
+		return starts[(gen+1)%N];
+	}
+
+	uint64_t live() const {
+		return head-oldest();
+	}
+
+	//a slot in the current generation, or nothing if the live generations fill the buffer
+	std::optional<size_t> next() {
+		if (head-oldest()>=capacity) return std::nullopt;
+		return index(head++);
+	}
+
+	void cycle() {
+		gen++;
+		starts[gen%N] = head;
+	}
+
+	//age 0 is the current generation. empty if it isn't live
+	Window window(size_t age) const {
+		if (age>=N || age>gen) return {};
+		return {.begin=starts[(gen-age)%N], .end=age==0 ? head : starts[(gen-age+1)%N]};
+	}
+};
+
+//CyclingIndex with one producer and any number of lock-free readers. the producer takes slots with next(), writes
+//them and makes them visible with publish(). cycle() publishes too.
+//readers get generations' positions with window() and read the slots, but the producer may recycle a slot while it's
+//being read. so slots have to be atomics, stored with release and loaded with acquire, and a read only counts if
+//still_live(pos) after it
+template<size_t N>
+struct ConcurrentCyclingIndex {
+	static_assert(N>0, "needs a generation");
+
+	using Window = typename CyclingIndex<N>::Window;
+
+	size_t capacity;
+
+	//the producer's own copies
+	uint64_t pos=0, gen=0, oldest=0;
+
+	alignas(64) std::atomic<uint64_t> head {0};
+	//twice the generation, odd while cycle() changes starts
+	std::atomic<uint64_t> seq {0};
+	std::atomic<uint64_t> tail {0};
+	std::array<std::atomic<uint64_t>, N> starts {};
+
+	explicit ConcurrentCyclingIndex(size_t capacity): capacity(capacity) {}
+
+	size_t index(uint64_t p) const {
+		return p%capacity;
+	}
+
+	//producer only
+	std::optional<size_t> next() {
+		if (pos-oldest>=capacity) return std::nullopt;
+		return index(pos++);
+	}
+
+	void publish() {
+		head.store(pos, std::memory_order_release);
+	}
+
+	//the new tail is stored before any slot it frees is written, so a reader that sees the new slot sees the tail too
+	void cycle() {
+		publish();
+
+		gen++;
+		seq.store(2*gen-1, std::memory_order_relaxed);
+		starts[gen%N].store(pos, std::memory_order_release);
+		oldest = starts[(gen+1)%N].load(std::memory_order_relaxed);
+		tail.store(oldest, std::memory_order_relaxed);
+		seq.store(2*gen, std::memory_order_release);
+	}
+
+	//readers. age 0 is the current generation, up to what's published. empty if it isn't live
+	Window window(size_t age) const {
+		while (true) {
+			uint64_t s = seq.load(std::memory_order_acquire);
+			if (s%2) continue;
+
+			uint64_t g = s/2;
+			if (age>=N || age>g) return {};
+
+			Window w {.begin=starts[(g-age)%N].load(std::memory_order_acquire)};
+			w.end = age==0 ? head.load(std::memory_order_acquire) : starts[(g-age+1)%N].load(std::memory_order_acquire);
+
+			if (seq.load(std::memory_order_relaxed)==s) return w;
+		}
+	}
+
+	//whether what was just read from pos's slot is from pos and not a later position
+	bool still_live(uint64_t p) const {
+		return p>=tail.load(std::memory_order_acquire);
+	}
+};
 
 #endif //SRC_CYCLINGINDEX_HPP_
@@ -1,352 +1,526 @@
+#include <algorithm>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "database.hpp"
+#include "util.hpp"
+
+static char const MAGIC[8] = "corecdb";
 
-Database::Database(char const* fname): file(fopen(fname, "rb+")) {
-	if (!file) file=fopen(fname, "rw+");
+static int open_file(char const* fname) {
+	int fd = ::open(fname, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (fd<0) throw Database::DatabaseIOError(errno);
+	return fd;
 }
 
-Database::~Database() {
-	fsync(fileno(file));
-	fclose(file);
+Database::PageCache::PageCache(int fd, size_t max_extents): fd(fd), max_extents(std::max<size_t>(max_extents, 1)) {
+	struct stat st;
+	if (fstat(fd, &st)<0) {
+		int err = errno;
+		::close(fd);
+		throw DatabaseIOError(err);
+	}
+
+	//a partial last page reads as zeros past the end
+	file_pages = (st.st_size+PAGE_SIZE-1)/PAGE_SIZE;
 }
 
-Database::BlockRef::BlockRef(Database& db, Block* block, uint64_t idx): db(db), block(block), idx(idx) {
-	block->prev=ntohll(block->prev);
-	block->next=ntohll(block->next);
+Database::PageCache::~PageCache() {
+	for (Extent& e: extents) if (e.data) munmap(e.data, EXTENT_SIZE);
+	::close(fd);
 }
 
-Database::BlockRef::~BlockRef() {
-	if (!block) return;
+char* Database::PageCache::pin(uint64_t page) {
+	size_t i = page/EXTENT_PAGES;
+	if (i>=extents.size()) extents.resize(i+1, Extent {.data=nullptr, .pins=0, .referenced=false});
 
-	block->prev=htonll(block->prev);
-	block->next=htonll(block->next);
-	munmap(block, sizeof(Block));
-}
+	Extent& e = extents[i];
+	if (!e.data) {
+		if (mapped>=max_extents) evict();
 
-Database::BlockRef::Address Database::BlockRef::insert(uint16_t size, unsigned char after) {
-	return Database::BlockRef::Address();
+		//extents are aligned to EXTENT_SIZE in the file, so the offset always is to pages
+		void* p = mmap(nullptr, EXTENT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, static_cast<off_t>(i*EXTENT_SIZE));
+		if (p==MAP_FAILED) throw DatabaseIOError(errno);
+
+		e.data = static_cast<char*>(p);
+		mapped++;
+	}
+
+	e.pins++;
+	e.referenced = true;
+	return e.data + (page%EXTENT_PAGES)*PAGE_SIZE;
 }
 
-Database::BlockRef Database::map_block(uint64_t idx) {
-	return Database::BlockRef(*this, reinterpret_cast<Block*>(mmap(nullptr, sizeof(Block), PROT_WRITE | PROT_READ, MAP_SHARED, fileno(file), idx)), idx);
+//one extent that isn't pinned or recently used, if any. dirty pages stay in the kernel's page cache once unmapped
+void Database::PageCache::evict() {
+	for (size_t tries=0; tries<2*extents.size(); tries++) {
+		Extent& e = extents[hand];
+		hand = (hand+1)%extents.size();
+
+		if (!e.data || e.pins) continue;
+		if (e.referenced) {
+			e.referenced = false;
+			continue;
+		}
+
+		munmap(e.data, EXTENT_SIZE);
+		e.data = nullptr;
+		mapped--;
+		return;
+	}
 }
 
-Database::BlockRef Database::make_block() {
-	fseek(file, SEEK_END, 0);
-	return map_block(ftell(file));
+void Database::PageCache::reserve(uint64_t pages) {
+	if (pages<=file_pages) return;
+
+	uint64_t want = (pages+EXTENT_PAGES-1)/EXTENT_PAGES*EXTENT_PAGES;
+	if (ftruncate(fd, static_cast<off_t>(want*PAGE_SIZE))<0) throw DatabaseIOError(errno);
+	file_pages = want;
 }
 
-Database::NodeRef::NodeRef(Database::Node* node): node(node) {
-	for (unsigned& cmp: node->cmps) cmp = ntohl(cmp);
-	for (unsigned& loc: node->locs) loc = ntohl(loc);
-	for (unsigned& weight: node->weights) weight = ntohl(weight);
+int Database::PageCache::sync() {
+	int err=0;
+	for (Extent& e: extents) {
+		if (e.data && msync(e.data, EXTENT_SIZE, MS_SYNC)<0 && !err) err = errno;
+	}
+
+	if (fsync(fd)<0 && !err) err = errno;
+	return err;
 }
 
-Database::NodeRef::NodeRef(): node(nullptr) {}
+Database::Database(char const* fname, size_t max_extents): cache(open_file(fname), max_extents) {
+	bool fresh = cache.file_pages==0;
+	if (fresh) cache.reserve(1);
 
-Database::NodeRef::~NodeRef() {
-	if (!node) return;
+	header_ref = PageRef(cache, 0);
+	header = header_ref.as<Header>();
 
-	for (unsigned& cmp: node->cmps) cmp = htonl(cmp);
-	for (unsigned& loc: node->locs) loc = htonl(loc);
-	for (unsigned& weight: node->weights) weight = htonl(weight);
+	if (fresh) {
+		std::memcpy(header->magic, MAGIC, sizeof(MAGIC));
+		header->version = FORMAT_VERSION;
+		header->flags = FORMAT_FLAGS;
+		header->pages = 1;
+		return;
+	}
 
-	munmap(node, sizeof(Node));
+	//the flags first, the version is swapped too when they don't match
+	if (std::memcmp(header->magic, MAGIC, sizeof(MAGIC))!=0) throw DatabaseFormatError("not a database");
+	if (header->flags!=FORMAT_FLAGS) throw DatabaseFormatError("database was written with the other byte order");
+	if (header->version!=FORMAT_VERSION) throw DatabaseFormatError("unsupported database version");
+	if (header->pages>cache.file_pages || header->n_tables>MAX_TABLES) throw DatabaseFormatError("database is truncated or corrupt");
 }
 
-Database::NodeRef Database::map_node(uint64_t idx) {
-	return Database::NodeRef(reinterpret_cast<Node*>(mmap(NULL, sizeof(Node), PROT_WRITE | PROT_READ, MAP_SHARED, fileno(file), idx)));
+Database::~Database() {
+	cache.sync();
 }
 
-Database::NodeRef Database::make_node() {
-	NodeRef ref;
-	if (free_node.node) {
-		ref=free_node.node;
-		
-		if (free_node.node->next_free_node!=-1) {
-			free_node = map_node(free_node.node->next_free_node);
-		}
-	} else {
-		fseek(file, 0, SEEK_END);
-		uint64_t idx = ftell(file);
-
-		char new_node[sizeof(Node)] = {0};
-		fwrite(new_node, sizeof(Node), 1, file);
-		fseek(file, idx, SEEK_SET);
+void Database::sync() {
+	int err = cache.sync();
+	if (err) throw DatabaseIOError(err);
+}
 
-		ref=map_node(idx);
+uint64_t Database::alloc_page() {
+	uint64_t page = header->free_page;
+	if (page) {
+		PageRef ref(cache, page);
+		header->free_page = ref.as<FreePage>()->next;
+		std::memset(ref.data, 0, PAGE_SIZE);
+		return page;
 	}
-	
-	ref.node->flags = 0;
 
-	for (unsigned& x: ref.node->cmps) x=UINT_MAX;
-	for (unsigned& x: ref.node->cmp_locs) x=-1;
-	for (unsigned& x: ref.node->locs) x=-1;
+	//new pages read as zeros
+	cache.reserve(header->pages+1);
+	return header->pages++;
+}
 
-	return ref;
+void Database::free_page(uint64_t page) {
+	PageRef ref(cache, page);
+	FreePage* free = ref.as<FreePage>();
+	free->kind = PAGE_FREE;
+	free->next = header->free_page;
+	header->free_page = page;
 }
 
-Database::Row::Row(Database& db, Database::BlockRef&& blockref): db(db), ref(blockref), ptr(blockref.block->data) {
-	VarIntRef vi(ptr);
-	row_sz = vi.value();
-	ptr+=vi.size;
-	row_i = 0;
+Database::Table Database::create_table(std::vector<ColType> const& cols) {
+	if (header->n_tables>=MAX_TABLES || cols.size()>MAX_COLUMNS) throw SchemaTooLarge();
+
+	TableDesc& desc = header->tables[header->n_tables];
+	desc = TableDesc();
+	desc.n_cols = static_cast<uint32_t>(cols.size());
+	std::copy(cols.begin(), cols.end(), desc.cols);
+
+	return Table(*this, header->n_tables++);
 }
 
-Database::Row Database::map_row(uint64_t block_idx, unsigned char rowi) {
-	Database::Row row = Database::Row(*this, Database::BlockRef(map_block(block_idx)));
-	for (unsigned char i=0; i<rowi; i++) if (!row.skip_row()) throw RowNoExists();
-	return row;
+Database::Table Database::table(unsigned id) {
+	if (id>=header->n_tables) throw TableNoExists();
+	return Table(*this, id);
 }
 
-void Database::Row::next(uint64_t amt) {
-	ptr+=amt;
+std::optional<Database::PageRef> Database::find_block(unsigned table, RowId id) const {
+	uint64_t page = id>>ROW_SLOT_BITS;
+	unsigned slot = id & ((1u<<ROW_SLOT_BITS)-1);
+	if (page==0 || page>=header->pages) return std::nullopt;
 
-	if (ptr>=ref.block->data+Block::BLOCK_SIZE) {
-		uint64_t diff = ptr-ref.block->data;
+	PageRef ref(cache, page);
+	Block const* block = ref.as<Block>();
+	if (block->kind!=PAGE_BLOCK || block->table!=table || slot>=block->n_slots || !block->slots[slot].offset) {
+		return std::nullopt;
+	}
 
-		while (diff>=Block::BLOCK_SIZE) {
-			ref = db.map_block(ref.block->next);
-			diff-=Block::BLOCK_SIZE;
-		}
+	return ref;
+}
 
-		row_i = 0;
-		ptr=ref.block->data + diff;
+std::optional<unsigned> Database::block_insert(Block* block, char const* row, size_t len) {
+	//reusing a removed row's slot if there is one
+	unsigned slot = block->n_slots;
+	if (block->live<block->n_slots) {
+		for (slot=0; block->slots[slot].offset; slot++);
 	}
+
+	size_t slots_end = sizeof(Block) + sizeof(Slot)*std::max<size_t>(block->n_slots, slot+1);
+	if (slots_end+block->used+len > PAGE_SIZE) return std::nullopt;
+	if (block->data_start < slots_end+len) compact(block);
+
+	block->data_start = static_cast<uint16_t>(block->data_start-len);
+	std::memcpy(reinterpret_cast<char*>(block)+block->data_start, row, len);
+	block->slots[slot] = Slot {.offset=block->data_start, .len=static_cast<uint16_t>(len)};
+
+	if (slot==block->n_slots) block->n_slots++;
+	block->used = static_cast<uint16_t>(block->used+len);
+	block->live++;
+	return slot;
 }
 
-bool Database::Row::skip_row() {
-	row_i++;
-	next(row_sz);
+//packs the rows against the end of the page again, closing the gaps removed ones left
+void Database::compact(Block* block) {
+	char* page = reinterpret_cast<char*>(block);
+	char copy[PAGE_SIZE];
+	std::memcpy(copy, page, PAGE_SIZE);
 
-	VarIntRef vi(ptr);
-	row_sz = vi.value();
-	if (row_sz==0) return false;
+	size_t at = PAGE_SIZE;
+	for (unsigned s=0; s<block->n_slots; s++) {
+		Slot& slot = block->slots[s];
+		if (!slot.offset) continue;
 
-	ptr+=vi.size;
-	return true;
+		at -= slot.len;
+		std::memcpy(page+at, copy+slot.offset, slot.len);
+		slot.offset = static_cast<uint16_t>(at);
+	}
+
+	block->data_start = static_cast<uint16_t>(at);
+}
+
+uint64_t Database::key_of(Value const& v) {
+	if (uint64_t const* x = std::get_if<uint64_t>(&v)) return *x;
+
+	std::string_view s = std::get<std::string_view>(v);
+	uint64_t key=0;
+	for (size_t i=0; i<8; i++) key = key<<8 | (i<s.size() ? static_cast<unsigned char>(s[i]) : 0);
+	return key;
 }
 
-bool Database::Row::skip_col() {
-	if (row_sz==0){
-		return false;
-	} else if (col_skipped) {
-		col_skipped=false;
-	} else {
-		next(8+col_sz);
-		row_sz -= 8+col_sz;
+Database::Row::Row(PageRef page, TableDesc const& table, RowId id): ref(std::move(page)), table(&table), id(id) {
+	Block const* block = ref.as<Block>();
+	data = ref.data + block->slots[id & ((1u<<ROW_SLOT_BITS)-1)].offset;
+
+	size_t at=0;
+	for (unsigned c=0; c<table.n_cols; c++) {
+		offsets[c] = static_cast<uint16_t>(at);
+
+		VarIntRef vi(data+at);
+		at += vi.size;
+		if (table.cols[c]==ColType::String) at += vi.value();
 	}
+}
 
-	VarIntRef vi(ptr);
-	col_sz = vi.value();
+void Database::Row::check(unsigned col, ColType type) const {
+	if (col>=table->n_cols || table->cols[col]!=type) throw ColNoExists();
+}
 
-	ptr+=vi.size;
-	return true;
+uint64_t Database::Row::get_unsigned(unsigned col) const {
+	check(col, ColType::Unsigned);
+	return VarIntRef(data+offsets[col]).value();
 }
 
-bool Database::Row::skip_ncol(unsigned n) {
-	for (; n!=-1; n--) if (!skip_col()) return false;
-	return true;
+std::string_view Database::Row::get_string(unsigned col) const {
+	check(col, ColType::String);
+	VarIntRef vi(data+offsets[col]);
+	return std::string_view(data+offsets[col]+vi.size, vi.value());
+}
+
+Database::Value Database::Row::operator[](unsigned col) const {
+	if (col>=table->n_cols) throw ColNoExists();
+	if (table->cols[col]==ColType::Unsigned) return get_unsigned(col);
+	return get_string(col);
 }
 
-Slice<MaybeOwnedSlice<char>> Database::Row::col_rawdata_index(bool skip_idx) {
-	if (row_sz==0) return Slice<MaybeOwnedSlice<char>>(MaybeOwnedSlice<char>());
+//each column is a VarInt, for strings their length followed by the bytes
+Database::RowId Database::Table::insert(std::vector<Value> const& vals) {
+	TableDesc& d = desc();
+	if (vals.size()!=d.n_cols) throw RowMismatch();
+
+	std::vector<char>& row = db.scratch;
+	row.clear();
+
+	for (unsigned c=0; c<d.n_cols; c++) {
+		//ColType's values are Value's alternatives
+		if (vals[c].index()!=static_cast<size_t>(d.cols[c])) throw RowMismatch();
+
+		std::string_view const* s = std::get_if<std::string_view>(&vals[c]);
+		uint64_t x = s ? s->size() : std::get<uint64_t>(vals[c]);
+		if (x>=uint64_t(1)<<61 || (s && row.size()+x>MAX_ROW)) throw RowTooLarge();
 
-	if (ptr+8+col_sz>=ref.block->data+Block::BLOCK_SIZE) {
-		col_skipped=true;
+		size_t at = row.size();
+		row.resize(at+8);
+		row.resize(at+VarIntRef::encode_wide(row.data()+at, x));
+		if (s) row.insert(row.end(), s->begin(), s->end());
+	}
 
-		col_sz+=8;
-		row_sz-=col_sz;
+	if (row.size()>MAX_ROW) throw RowTooLarge();
 
-		uint64_t saved_col_sz = skip_idx ? col_sz-8 : col_sz;
-		char* data = new char[saved_col_sz];
+	PageRef ref;
+	std::optional<unsigned> slot;
+	if (d.last_block) {
+		ref = PageRef(db.cache, d.last_block);
+		slot = db.block_insert(ref.as<Block>(), row.data(), row.size());
+	}
 
-		unsigned left = Block::BLOCK_SIZE-(ptr-ref.block->data);
+	if (!slot) {
+		uint64_t page = db.alloc_page();
+		PageRef fresh(db.cache, page);
 
-		do {
-			if (skip_idx) {
-				if (saved_col_sz+left>col_sz) {
-					if (saved_col_sz<col_sz) memcpy(data, ptr, left-saved_col_sz+col_sz);
-					else memcpy(data+saved_col_sz-col_sz, ptr, left);
-				}
-			} else {
-				memcpy(data+saved_col_sz-col_sz, ptr, left);
-			}
+		Block* block = fresh.as<Block>();
+		block->kind = PAGE_BLOCK;
+		block->table = id;
+		block->prev = d.last_block;
+		block->data_start = PAGE_SIZE;
 
-			ref = db.map_block(ref.block->next);
+		if (d.last_block) ref.as<Block>()->next = page;
+		else d.first_block = page;
+		d.last_block = page;
 
-			col_sz-=Block::BLOCK_SIZE;
-			left=Block::BLOCK_SIZE;
-			ptr=ref.block->data;
-		} while (col_sz>Block::BLOCK_SIZE);
+		ref = std::move(fresh);
+		slot = db.block_insert(block, row.data(), row.size());
+	}
 
-		memcpy(data+(saved_col_sz-col_sz), ptr, col_sz);
-		ptr+=col_sz;
-		col_sz=0;
+	RowId rid = ref.page<<ROW_SLOT_BITS | *slot;
+	d.rows++;
 
-		return Slice<MaybeOwnedSlice<char>>(MaybeOwnedSlice<char>(data, saved_col_sz, true));
-	} else {
-		return Slice<MaybeOwnedSlice<char>>(MaybeOwnedSlice<char>(skip_idx ? 8+ptr : ptr, skip_idx ? col_sz : 8+col_sz, false));
+	for (unsigned c=0; c<d.n_cols; c++) {
+		if (d.indexes[c]) db.index_insert(d.indexes[c], Entry {.key=key_of(vals[c]), .row=rid});
 	}
-}
 
-template<class T>
-Slice<MaybeOwnedSlice<T>> Database::Row::col_rawdata() {
-	Slice<MaybeOwnedSlice<char>> cdata = col_rawdata_index(true);
-	return Slice<MaybeOwnedSlice<T>>(MaybeOwnedSlice<T>(reinterpret_cast<T*>(cdata.data()), cdata.size(), cdata.slice_type.owned));
+	return rid;
 }
 
-template<class T>
-Slice<MaybeOwnedSlice<T>> Database::Row::col_data() {
-	return col_rawdata<T>();
+std::optional<Database::Row> Database::Table::get(RowId rid) const {
+	std::optional<PageRef> ref = db.find_block(id, rid);
+	if (!ref) return std::nullopt;
+	return Row(std::move(*ref), desc(), rid);
 }
 
-template<>
-Slice<MaybeOwnedSlice<unsigned>> Database::Row::col_data<unsigned>() {
-	Slice<MaybeOwnedSlice<unsigned>> cdata = col_rawdata<unsigned>();
-	cdata.slice_type.to_owned();
+//the space stays in the block until an insert there compacts it, a block left empty is freed unless it's the last
+bool Database::Table::remove(RowId rid) {
+	std::optional<PageRef> ref = db.find_block(id, rid);
+	if (!ref) return false;
 
-	for (unsigned& x: cdata) {
-		x = ntohl(x);
+	TableDesc& d = desc();
+	{
+		Row row(*ref, d, rid);
+		for (unsigned c=0; c<d.n_cols; c++) {
+			if (d.indexes[c]) db.index_erase(d.indexes[c], Entry {.key=key_of(row[c]), .row=rid});
+		}
+	}
+
+	Block* block = ref->as<Block>();
+	Slot& slot = block->slots[rid & ((1u<<ROW_SLOT_BITS)-1)];
+	block->used = static_cast<uint16_t>(block->used-slot.len);
+	block->live--;
+	slot = Slot {.offset=0, .len=0};
+	while (block->n_slots>0 && !block->slots[block->n_slots-1].offset) block->n_slots--;
+
+	d.rows--;
+
+	if (block->live==0 && ref->page!=d.last_block) {
+		if (block->prev) PageRef(db.cache, block->prev).as<Block>()->next = block->next;
+		else d.first_block = block->next;
+		PageRef(db.cache, block->next).as<Block>()->prev = block->prev;
+
+		uint64_t page = ref->page;
+		ref.reset();
+		db.free_page(page);
 	}
 
-	return cdata;
+	return true;
 }
 
-void Database::NodeIterator::shift_by() {
-	unsigned b_i = v_offset/8;
-	if (b_i<v.size()) {
-		char buf[8] = {0};
+void Database::Table::index(unsigned col) {
+	TableDesc& d = desc();
+	if (col>=d.n_cols) throw ColNoExists();
+	if (d.indexes[col]) return;
 
-		if (v.size()-b_i<5) {
-			end=true;
+	std::vector<Entry> entries;
+	entries.reserve(d.rows);
+	scan([&](Row const& row) {
+		entries.push_back(Entry {.key=key_of(row[col]), .row=row.id});
+	});
 
-			for (unsigned char i=0; i<v.size()-b_i; i++) {
-				buf[i] = *(v.data() + b_i+i);
-			}
+	//in order, so leaves split off full
+	std::sort(entries.begin(), entries.end());
+	uint64_t root = db.new_leaf();
+	for (Entry e: entries) db.index_insert(root, e);
 
-		} else {
-			*reinterpret_cast<unsigned*>(buf) = *reinterpret_cast<unsigned*>(v.data()+b_i);
-			buf[4] = *(v.data()+b_i+4);
-		}
+	d.indexes[col] = root;
+}
+
+std::vector<Database::RowId> Database::Table::find(unsigned col, Value const& v) const {
+	TableDesc const& d = desc();
+	if (col>=d.n_cols) throw ColNoExists();
+	if (v.index()!=static_cast<size_t>(d.cols[col])) throw RowMismatch();
+
+	std::vector<RowId> ret;
+	if (!d.indexes[col]) {
+		scan([&](Row const& row) {
+			if (row[col]==v) ret.push_back(row.id);
+		});
 
-		shifted_v = *reinterpret_cast<uint64_t*>(buf)<<(v_offset%8);
-	} else {
-		shifted_v = 0;
+		return ret;
 	}
-}
 
-void Database::NodeIterator::shift() {
-	int amt = __builtin_clz(min ^ max);
-	v_offset+=amt;
+	//strings sharing the key's 8 bytes are told apart by the rows themselves
+	uint64_t key = key_of(v);
+	std::string_view const* s = std::get_if<std::string_view>(&v);
+	db.index_from(d.indexes[col], Entry {.key=key, .row=0}, [&](Entry e) {
+		if (e.key!=key) return false;
+		if (!s || get(e.row)->get_string(col)==*s) ret.push_back(e.row);
+		return true;
+	});
 
-	shift_by();
+	return ret;
+}
 
-	min<<=amt;
-	max<<=amt;
-	max |= UINT_MAX>>(32-amt);
+uint64_t Database::new_leaf() {
+	uint64_t page = alloc_page();
+	PageRef(cache, page).as<Node>()->kind = PAGE_LEAF;
+	return page;
 }
 
-//UNDERCONSTRUCTION!11,'ouonibunhibnteu 🚧 🚧 🚧 🚧
-void Database::go(Database::NodeIterator& iter) {
-	unsigned i;
-	for (; i<NODE_BRANCHES-1; i++) {
-		if (iter.shifted_v<=iter.x.node->cmps[i]) break;
-	}
+//x before pos in the n at xs, which have room for it
+template<class T>
+static void insert_at(T* xs, uint32_t& n, T* pos, T x) {
+	std::memmove(pos+1, pos, (xs+n-pos)*sizeof(T));
+	*pos = x;
+	n++;
+}
 
-	if (i!=NODE_BRANCHES && iter.x.node->cmp_locs[i]==-1) {
-		//insert if needed
-		return;
-	}
+//the new root of a tree that split: one separator between the old root and what split off
+void Database::index_insert(uint64_t& root, Entry e) {
+	std::optional<std::pair<Entry, uint64_t>> split = node_insert(root, e);
+	if (!split) return;
+
+	uint64_t page = alloc_page();
+	PageRef ref(cache, page);
+	Node* node = ref.as<Node>();
+	node->kind = PAGE_INNER;
+	node->n = 1;
+	node->seps[0] = split->first;
+	node->children[0] = root;
+	node->children[1] = split->second;
+
+	root = page;
+}
 
-	if (i!=NODE_BRANCHES && iter.shifted_v==iter.x.node->cmps[i]) {
-		Row r = map_row(iter.x.node->cmp_locs[i], iter.x.node->cmp_loc_rowi[i]);
-
-		if (iter.end) {
-			unsigned char flag = iter.x.node->flags >> (2*i);
-			bool do_insert_reinsert;
-			if (flag & CMP_FLAGS_END) {
-				r.skip_ncol(iter.col_i);
-				if (r.col_sz==iter.col_sz) {
-					if (iter.insert && (iter.nonunique || iter.overwrite)) {
-						if (iter.overwrite) {
-							r.remove_exclude_index(iter.col_i);
-						}
-
-						r.insert_after(iter.rowdata);
-
-						if (iter.overwrite) {
-							iter.x.node->cmp_locs[i] = r.ref.idx;
-							iter.x.node->cmp_loc_rowi[i] = r.row_i;
-						}
-					}
-
-					return;
-				}
-
-				do_insert_reinsert = iter.col_sz<r.col_sz;
-			} else {
-				do_insert_reinsert = true;
-			}
-
-			if (do_insert_reinsert) {
-				//insert our node here (since it terminates earlier) and the other node downward
-				//(since the other node is already duplicated downstream)
-				return;
-			}
+//inserts under page, returning the separator and node to add to its parent if it split. full nodes split in half, or
+//when e goes at the very end keep everything and start the new node with e, so inserting in order leaves them full
+std::optional<std::pair<Database::Entry, uint64_t>> Database::node_insert(uint64_t page, Entry e) {
+	PageRef ref(cache, page);
+	Node* node = ref.as<Node>();
+
+	if (node->kind==PAGE_LEAF) {
+		Entry* pos = std::upper_bound(node->entries, node->entries+node->n, e);
+		if (node->n<LEAF_ENTRIES) {
+			insert_at(node->entries, node->n, pos, e);
+			return std::nullopt;
 		}
 
-		i++; //insert after cmp (GEQ side)
-
-		iter.min = 0;
-		iter.max = UINT_MAX;
-		iter.v_offset += 32;
-		iter.shift_by();
-	} else {
-		if (i>0 && i<iter.x.node->cmps.size()) {
-			iter.min = iter.x.node->cmps[0];
-			iter.max = iter.x.node->cmps[NODE_BRANCHES-2];
-		} else if (i==0) {
-			iter.max=iter.x.node->cmps[0];
-		} else if (i==iter.x.node->cmps.size()) {
-			iter.min=iter.x.node->cmps[NODE_BRANCHES-2];
-		}
+		uint64_t right_page = new_leaf();
+		PageRef right_ref(cache, right_page);
+		Node* right = right_ref.as<Node>();
+
+		uint32_t keep = pos==node->entries+LEAF_ENTRIES ? LEAF_ENTRIES : LEAF_ENTRIES/2;
+		std::memcpy(right->entries, node->entries+keep, (LEAF_ENTRIES-keep)*sizeof(Entry));
+		right->n = LEAF_ENTRIES-keep;
+		node->n = keep;
+
+		right->next = node->next;
+		node->next = right_page;
 
-		iter.shift();
+		if (pos-node->entries<static_cast<ptrdiff_t>(keep)) insert_at(node->entries, node->n, pos, e);
+		else insert_at(right->entries, right->n, right->entries+(pos-node->entries-keep), e);
+
+		return std::make_pair(right->entries[0], right_page);
 	}
 
-	if (iter.x.node->locs[i]==-1) {
-		if (iter.insert) {
-			NodeRef branch = make_node();
-			iter.x.node->locs[i] = branch.idx;
-			branch.node->cmps[0] = iter.cmp;
-//			branch.node->cmp_locs
-		}
+	uint32_t i = static_cast<uint32_t>(std::upper_bound(node->seps, node->seps+node->n, e)-node->seps);
+	std::optional<std::pair<Entry, uint64_t>> split = node_insert(node->children[i], e);
+	if (!split) return std::nullopt;
 
-		return;
+	if (node->n<INNER_SEPS) {
+		std::memmove(node->children+i+2, node->children+i+1, (node->n-i)*sizeof(uint64_t));
+		node->children[i+1] = split->second;
+		insert_at(node->seps, node->n, node->seps+i, split->first);
+		return std::nullopt;
 	}
 
-	iter.x = map_node(iter.x.node->locs[i]);
-	go(iter);
-}
-
-//template<template<class> class SliceType>
-//Database::NodeRef Database::insert_rec(Database::InsertInfo info, Database::NodeRef base) {
-//	Row r = map_row(base.node->cmp_locs[i], base.node->cmp_loc_rowi[i]);
-//	r.insert_after(info.rowdata);
-//	base.node->cmp_locs[] = r.
-//			base.x->flags |= NODE_FLAGS_END << (2*i);
-//
-//
-//	if (info.overwrite) {
-//		r.remove_exclude_index(info.col_i);
-//		base.node->cmp_locs[i] = info.loc;
-//	} else if (info.nonunique) {
-//
-//	}
-//
-//
-//	base.node->cmp_locs[i] = info.loc;
-//	base.node->flags |= CMP_FLAGS_END<<(2*i);
-//}
+	//all the separators and children with the new ones, then the middle separator goes up
+	Entry seps[INNER_SEPS+1];
+	uint64_t children[INNER_SEPS+2];
+	std::copy(node->seps, node->seps+i, seps);
+	seps[i] = split->first;
+	std::copy(node->seps+i, node->seps+INNER_SEPS, seps+i+1);
+	std::copy(node->children, node->children+i+1, children);
+	children[i+1] = split->second;
+	std::copy(node->children+i+1, node->children+INNER_SEPS+1, children+i+2);
+
+	uint32_t keep = i==INNER_SEPS ? INNER_SEPS : (INNER_SEPS+1)/2;
+
+	uint64_t right_page = alloc_page();
+	PageRef right_ref(cache, right_page);
+	Node* right = right_ref.as<Node>();
+	right->kind = PAGE_INNER;
+	right->n = INNER_SEPS-keep;
+	std::copy(seps+keep+1, seps+INNER_SEPS+1, right->seps);
+	std::copy(children+keep+1, children+INNER_SEPS+2, right->children);
+
+	node->n = keep;
+	std::copy(seps, seps+keep, node->seps);
+	std::copy(children, children+keep+1, node->children);
+
+	return std::make_pair(seps[keep], right_page);
+}
+
+void Database::index_erase(uint64_t root, Entry e) {
+	auto [ref, i] = index_seek(root, e);
+	Node* node = ref.as<Node>();
+	if (i<node->n && node->entries[i]==e) {
+		std::memmove(node->entries+i, node->entries+i+1, (node->n-i-1)*sizeof(Entry));
+		node->n--;
+	}
+}
+
+std::pair<Database::PageRef, unsigned> Database::index_seek(uint64_t root, Entry from) const {
+	PageRef ref(cache, root);
+	while (ref.as<Node>()->kind==PAGE_INNER) {
+		Node const* node = ref.as<Node>();
+		ref = PageRef(cache, node->children[std::upper_bound(node->seps, node->seps+node->n, from)-node->seps]);
+	}
+
+	Node const* node = ref.as<Node>();
+	unsigned i = static_cast<unsigned>(std::lower_bound(node->entries, node->entries+node->n, from)-node->entries);
+	return std::make_pair(std::move(ref), i);
+}
@@ -1,192 +1,425 @@
 #ifndef CORECOMMON_SRC_DATABASE_HPP_
 #define CORECOMMON_SRC_DATABASE_HPP_
 
-#include <sys/mman.h>
-#include <fstream>
-#include <array>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+
+//one file of tables, whose rows are unsigned (up to 61 bits) and string columns, with ordered indexes on any column.
+//the file is pages of PAGE_SIZE: the header, blocks of rows and index nodes. it's mapped in aligned extents of
+//EXTENT_PAGES pages, an extent staying mapped while any of its pages is pinned. past max_extents mapped, unpinned
+//extents are unmapped clock style (pinned ones never are, so it's a soft limit). nodes and blocks are pointers into
+//their extent and fields are native endian; the header flags the byte order that wrote it, opening on the other throws.
+//there's no journal, so a crash between sync()s can leave the file inconsistent. not thread safe
+class Database {
+ public:
+	static constexpr size_t PAGE_SIZE = 4096;
+	static constexpr size_t EXTENT_PAGES = 256;
+	static constexpr size_t EXTENT_SIZE = PAGE_SIZE*EXTENT_PAGES;
+	static constexpr unsigned MAX_TABLES = 16;
+	static constexpr unsigned MAX_COLUMNS = 16;
 
-#include "util.hpp"
+	enum class ColType: unsigned char {
+		Unsigned,
+		String
+	};
 
-class Database {
- private:
-	static const unsigned char NODE_FLAGS_END = 1<<0;
-	static const unsigned char CMP_FLAGS_END = 1<<1;
-	static const size_t NODE_BRANCHES = 4;
+	using Value = std::variant<uint64_t, std::string_view>;
+	//the block's page, then the row's slot in it
+	using RowId = uint64_t;
+	static constexpr unsigned ROW_SLOT_BITS = 12;
 
-	struct __attribute__((packed)) Node {
-		union {
-			struct {
-				unsigned char flags;
+	struct RowNoExists: public std::exception {
+		char const* what() const noexcept override {
+			return "row specified by an index does not exist";
+		}
+	};
 
-				std::array<unsigned, NODE_BRANCHES-1> cmps;
-				std::array<unsigned, NODE_BRANCHES-1> cmp_locs;
-				std::array<unsigned char, NODE_BRANCHES-1> cmp_loc_rowi;
+	struct ColNoExists: public std::exception {
+		char const* what() const noexcept override {
+			return "column needed for indexing or retrieval does not exist";
+		}
+	};
 
-				std::array<unsigned, NODE_BRANCHES> locs;
-				std::array<unsigned, NODE_BRANCHES> weights;
-			};
+	struct TableNoExists: public std::exception {
+		char const* what() const noexcept override {
+			return "table does not exist";
+		}
+	};
 
-			uint64_t next_free_node;
-		};
+	struct RowMismatch: public std::exception {
+		char const* what() const noexcept override {
+			return "values don't match the table's columns";
+		}
 	};
 
-	class NodeRef {
-	 public:
-		Node* node;
-		uint64_t idx;
+	struct RowTooLarge: public std::exception {
+		char const* what() const noexcept override {
+			return "row doesn't fit in a block, or an unsigned value has over 61 bits";
+		}
+	};
 
-		NodeRef(Node* node);
-		NodeRef();
-		~NodeRef();
+	struct SchemaTooLarge: public std::exception {
+		char const* what() const noexcept override {
+			return "more than MAX_TABLES tables or MAX_COLUMNS columns";
+		}
 	};
 
-	struct __attribute__((packed)) Block {
-		static const size_t BLOCK_SIZE=4096;
-		uint64_t prev, next;
+	struct DatabaseFormatError: public std::exception {
+		char const* msg;
 
-		struct Address {
-			uint64_t start;
-			unsigned char where;
-		};
+		explicit DatabaseFormatError(char const* msg): msg(msg) {}
 
-		char data[BLOCK_SIZE];
+		char const* what() const noexcept override {
+			return msg;
+		}
 	};
 
-	struct BlockRef {
-		Database& db;
+	//opening, growing, mapping or syncing the file failed with errno err
+	struct DatabaseIOError: public std::exception {
+		int err;
 
-		Block* block;
-		uint64_t idx;
+		explicit DatabaseIOError(int err): err(err) {}
 
-		struct Address {
-			uint64_t start;
-			unsigned char where;
-			char* data;
+		char const* what() const noexcept override {
+			return std::strerror(err);
+		}
+	};
 
-			Block::Address address() const;
+ private:
+	//owns the fd and the mapped extents
+	class PageCache {
+	 public:
+		struct Extent {
+			char* data;
+			unsigned pins;
+			//set when pinned, cleared as the clock hand passes
+			bool referenced;
 		};
 
-		BlockRef::Address insert(uint16_t size, unsigned char after);
-		BlockRef::Address push(uint16_t size);
-		void remove(unsigned char where);
+		int fd;
+		//the file's length, always whole extents
+		uint64_t file_pages;
+		std::vector<Extent> extents;
+		size_t mapped=0, max_extents, hand=0;
 
-		BlockRef::Address operator[](unsigned char where);
+		PageCache(int fd, size_t max_extents);
+		PageCache(PageCache const&) = delete;
+		PageCache& operator=(PageCache const&) = delete;
+		~PageCache();
 
-		BlockRef(Database& db, Block* block, uint64_t idx);
-		~BlockRef();
-	};
+		char* pin(uint64_t page);
 
-	NodeRef free_node;
-	BlockRef free_block;
+		void unpin(uint64_t page) {
+			extents[page/EXTENT_PAGES].pins--;
+		}
 
- public:
-	Database(char const* fname);
-	~Database();
+		//extends the file to whole extents covering pages
+		void reserve(uint64_t pages);
+		//0 or the errno of the first failure
+		int sync();
 
-	enum class ColType {
-		Unsigned,
-		String
+	 private:
+		void evict();
 	};
 
-	class Table {
-	 private:
-		struct Column {
-			ColType coltype;
-			NodeRef base; //nullable
-		};
+	//a pinned page, data stays valid until it's dropped
+	class PageRef {
+	 public:
+		PageCache* cache=nullptr;
+		uint64_t page=0;
+		char* data=nullptr;
 
-		std::vector<Column> cols;
-		friend class Database;
+		PageRef() {}
+		PageRef(PageCache& cache, uint64_t page): cache(&cache), page(page), data(cache.pin(page)) {}
 
-	 public:
-		unsigned const id;
-	};
+		PageRef(PageRef const& other): cache(other.cache), page(other.page), data(other.data) {
+			if (cache) cache->extents[page/EXTENT_PAGES].pins++;
+		}
 
-	class Row {
-	 private:
-		friend class Database;
+		PageRef(PageRef&& other) noexcept: cache(other.cache), page(other.page), data(other.data) {
+			other.cache = nullptr;
+		}
 
-		Database& db;
-		BlockRef ref;
+		PageRef& operator=(PageRef other) noexcept {
+			std::swap(cache, other.cache);
+			std::swap(page, other.page);
+			std::swap(data, other.data);
+			return *this;
+		}
 
-		char* ptr;
-		uint64_t row_sz, col_sz;
-		unsigned char row_i;
-		bool col_skipped;
+		~PageRef() {
+			if (cache) cache->unpin(page);
+		}
 
-		Row(Database& db, BlockRef&& blockref);
-		void next(uint64_t amt);
+		template<class T>
+		T* as() const {
+			return reinterpret_cast<T*>(data);
+		}
+	};
 
-		void remove_exclude_index(unsigned exclude_index);
+	//what a page holds, the first field of each
+	enum PageKind: uint32_t {
+		PAGE_FREE,
+		PAGE_BLOCK,
+		PAGE_LEAF,
+		PAGE_INNER
+	};
 
-		template<template<class> class SliceType>
-		void insert_after(Slice<SliceType<char>> rowdata);
+	static constexpr uint32_t FORMAT_VERSION = 1;
+	static constexpr uint32_t FORMAT_BIG_ENDIAN = 1<<0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__==__ORDER_BIG_ENDIAN__
+	static constexpr uint32_t FORMAT_FLAGS = FORMAT_BIG_ENDIAN;
+#else
+	static constexpr uint32_t FORMAT_FLAGS = 0;
+#endif
+
+	struct TableDesc {
+		//the chain of blocks, rows go into the last
+		uint64_t first_block, last_block;
+		uint64_t rows;
+		uint32_t n_cols;
+		ColType cols[MAX_COLUMNS];
+		//each column's index root, 0 if it isn't indexed
+		uint64_t indexes[MAX_COLUMNS];
+	};
 
-		Slice<MaybeOwnedSlice<char>> col_rawdata_index(bool skip_idx);
+	//page 0
+	struct Header {
+		char magic[8];
+		uint32_t version;
+		uint32_t flags;
+		//pages in use, the file goes on to the end of the extent
+		uint64_t pages;
+		//freed pages, linked through FreePage::next
+		uint64_t free_page;
+		uint32_t n_tables;
+		TableDesc tables[MAX_TABLES];
+	};
 
-	 public:
-		bool skip_row();
-		bool skip_col();
-		bool skip_ncol(unsigned n);
+	struct FreePage {
+		uint32_t kind;
+		uint64_t next;
+	};
 
-		template<class T>
-		Slice<MaybeOwnedSlice<T>> col_rawdata();
+	//offset 0 when the slot's row was removed
+	struct Slot {
+		uint16_t offset, len;
+	};
 
-		template<class T>
-		Slice<MaybeOwnedSlice<T>> col_data();
+	//slots grow up from the header, rows are packed down from the end of the page
+	struct Block {
+		uint32_t kind;
+		uint32_t table;
+		uint64_t prev, next;
+		uint16_t n_slots;
+		uint16_t data_start;
+		//bytes of rows still there and how many
+		uint16_t used, live;
+		Slot slots[];
 	};
 
-	struct RowNoExists: public std::exception {
-		char const* what() const noexcept {
-			return "row specified by an index does not exist";
+	static constexpr size_t MAX_ROW = PAGE_SIZE-sizeof(Block)-sizeof(Slot);
+	static_assert((PAGE_SIZE-sizeof(Block))/sizeof(Slot) <= 1u<<ROW_SLOT_BITS, "a block's slots fit in a RowId");
+
+	//an index entry, ordered by key then row so duplicate keys are still distinct entries. strings are keyed on
+	//their first 8 bytes, big endian so the order agrees, and compared in full against the row
+	struct Entry {
+		uint64_t key;
+		RowId row;
+
+		bool operator<(Entry const& other) const {
+			return key<other.key || (key==other.key && row<other.row);
 		}
-	};
 
-	struct ColNoExists: public std::exception {
-		char const* what() const noexcept {
-			return "column needed for indexing or retrieval does not exist";
+		bool operator==(Entry const& other) const {
+			return key==other.key && row==other.row;
 		}
 	};
 
- private:
-	FILE* file;
+	static constexpr size_t NODE_HEADER = 16;
+	static constexpr size_t LEAF_ENTRIES = (PAGE_SIZE-NODE_HEADER)/sizeof(Entry);
+	static constexpr size_t INNER_SEPS = (PAGE_SIZE-NODE_HEADER-sizeof(uint64_t))/(sizeof(Entry)+sizeof(uint64_t));
 
-	BlockRef map_block(uint64_t idx);
-	BlockRef make_block();
+	//a B+tree node. seps[i] is the least entry under children[i+1] when it split off, so entries go down
+	//children[number of seps <= them]. leaves are linked in order. removing doesn't merge nodes
+	struct Node {
+		uint32_t kind;
+		//entries in a leaf, separators in an inner node (with a child more)
+		uint32_t n;
+		//the next leaf, 0 at the end
+		uint64_t next;
 
-	Row map_row(uint64_t block_idx, unsigned char rowi);
+		union {
+			Entry entries[LEAF_ENTRIES];
 
-	NodeRef map_node(uint64_t idx);
-	NodeRef make_node();
+			struct {
+				Entry seps[INNER_SEPS];
+				uint64_t children[INNER_SEPS+1];
+			};
+		};
+	};
 
-	struct NodeIterator {
-		unsigned col_i, col_sz;
+	static_assert(sizeof(Header)<=PAGE_SIZE && sizeof(Node)<=PAGE_SIZE, "header and nodes are a page each");
 
-		unsigned min, max;
+ public:
+	//a row, pinning its block: views returned stay valid while it does
+	class Row {
+	 private:
+		friend class Database;
 
-		Slice<MaybeOwnedSlice<unsigned char>> v;
+		PageRef ref;
+		TableDesc const* table;
+		char const* data;
+		//where each column starts
+		uint16_t offsets[MAX_COLUMNS];
 
-		unsigned v_offset;
-		unsigned shifted_v;
-		bool end;
+		Row(PageRef ref, TableDesc const& table, RowId id);
+		void check(unsigned col, ColType type) const;
 
-		bool insert, nonunique, overwrite;
-		unsigned cmp;
-		Slice<DynSlice<char>> rowdata;
+	 public:
+		RowId id;
 
-		Database::NodeRef x;
+		unsigned columns() const {
+			return table->n_cols;
+		}
 
-		void shift_by();
-		void shift();
+		//throws ColNoExists when col isn't there or of that type
+		uint64_t get_unsigned(unsigned col) const;
+		std::string_view get_string(unsigned col) const;
+		Value operator[](unsigned col) const;
 	};
 
-	void go(NodeIterator& iter);
+	//a handle to a table, valid as long as its Database
+	class Table {
+	 private:
+		friend class Database;
+		Database& db;
+
+		Table(Database& db, unsigned id): db(db), id(id) {}
+
+		TableDesc& desc() const {
+			return db.header->tables[id];
+		}
+
+	 public:
+		unsigned const id;
+
+		size_t size() const {
+			return desc().rows;
+		}
+
+		std::vector<ColType> columns() const {
+			return std::vector<ColType>(desc().cols, desc().cols+desc().n_cols);
+		}
 
-	void balance(NodeRef x);
-//	template<template<class> class SliceType>
-//	NodeRef insert_rec(InsertInfo info, NodeRef base);
-	template<template<class> class SliceType>
-	NodeRef search(NodeRef base, Slice<SliceType<unsigned>> v);
+		bool indexed(unsigned col) const {
+			return col<desc().n_cols && desc().indexes[col]!=0;
+		}
+
+		//throws RowMismatch for the wrong number or types of values and RowTooLarge past MAX_ROW encoded
+		RowId insert(std::vector<Value> const& vals);
+		std::optional<Row> get(RowId id) const;
+		//false if it wasn't there
+		bool remove(RowId id);
+
+		//builds an index of col over the rows so far, maintained from then on
+		void index(unsigned col);
+
+		//the rows whose col is v, through its index if there is one, otherwise scanning
+		std::vector<RowId> find(unsigned col, Value const& v) const;
+
+		//every row in storage order. f can't change the table
+		template<class F>
+		void scan(F f) const {
+			for (uint64_t b=desc().first_block; b;) {
+				PageRef ref(db.cache, b);
+				Block const* block = ref.as<Block>();
+				for (unsigned s=0; s<block->n_slots; s++) {
+					if (block->slots[s].offset) f(Row(ref, desc(), b<<ROW_SLOT_BITS | s));
+				}
+
+				b = block->next;
+			}
+		}
+
+		//the rows with lo <= col <= hi in order of col, which has to be an indexed Unsigned column. f returns
+		//whether to go on, and can't change the table
+		template<class F>
+		void range(unsigned col, uint64_t lo, uint64_t hi, F f) const {
+			if (!indexed(col) || desc().cols[col]!=ColType::Unsigned) throw ColNoExists();
+
+			db.index_from(desc().indexes[col], Entry{.key=lo, .row=0}, [&](Entry e) {
+				if (e.key>hi) return false;
+				std::optional<Row> row = get(e.row);
+				return f(*row);
+			});
+		}
+	};
+
+	//opens fname, creating it if it doesn't exist. throws DatabaseIOError, and DatabaseFormatError for files that
+	//aren't databases or were written with the other byte order
+	explicit Database(char const* fname, size_t max_extents=1024);
+	Database(Database const&) = delete;
+	Database& operator=(Database const&) = delete;
+	//syncs, ignoring errors
+	~Database();
+
+	Table create_table(std::vector<ColType> const& cols);
+	Table table(unsigned id);
+
+	unsigned tables() const {
+		return header->n_tables;
+	}
+
+	//writes everything back to the file
+	void sync();
+
+ private:
+	mutable PageCache cache;
+	//page 0, pinned throughout
+	PageRef header_ref;
+	Header* header;
+	std::vector<char> scratch;
+
+	uint64_t alloc_page();
+	void free_page(uint64_t page);
+
+	//the row's slot, when id is in a block of table
+	std::optional<PageRef> find_block(unsigned table, RowId id) const;
+	//nothing when it doesn't fit
+	std::optional<unsigned> block_insert(Block* block, char const* row, size_t len);
+	static void compact(Block* block);
+
+	static uint64_t key_of(Value const& v);
+
+	uint64_t new_leaf();
+	void index_insert(uint64_t& root, Entry e);
+	std::optional<std::pair<Entry, uint64_t>> node_insert(uint64_t page, Entry e);
+	void index_erase(uint64_t root, Entry e);
+
+	//the leaf where entries >= from start, and the first such position in it
+	std::pair<PageRef, unsigned> index_seek(uint64_t root, Entry from) const;
+
+	//calls f with entries from from on, in order, while it returns true
+	template<class F>
+	void index_from(uint64_t root, Entry from, F f) const {
+		auto [ref, i] = index_seek(root, from);
+		while (true) {
+			Node const* node = ref.as<Node>();
+			for (; i<node->n; i++) if (!f(node->entries[i])) return;
+
+			if (!node->next) return;
+			ref = PageRef(cache, node->next);
+			i = 0;
+		}
+	}
 };
 
 #endif //CORECOMMON_SRC_DATABASE_HPP_
@@ -0,0 +1,82 @@
+#ifndef CORECOMMON_SRC_HASH_HPP_
+#define CORECOMMON_SRC_HASH_HPP_
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+//fast non-cryptographic hashing, after wyhash (final4, public domain) by Wang Yi
+constexpr uint64_t HASH_SECRET[4] = {0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull};
+
+//full 64x64->128 multiply, folded. every output bit depends on every input bit of both operands
+inline uint64_t hash_mum(uint64_t a, uint64_t b) {
+	__uint128_t r = static_cast<__uint128_t>(a)*b;
+	return static_cast<uint64_t>(r) ^ static_cast<uint64_t>(r>>64);
+}
+
+inline uint64_t hash_read8(unsigned char const* p) {
+	uint64_t v;
+	std::memcpy(&v, p, 8);
+	return v;
+}
+
+inline uint64_t hash_read4(unsigned char const* p) {
+	uint32_t v;
+	std::memcpy(&v, p, 4);
+	return v;
+}
+
+inline uint64_t hash_read3(unsigned char const* p, size_t len) {
+	return (static_cast<uint64_t>(p[0])<<16) | (static_cast<uint64_t>(p[len>>1])<<8) | p[len-1];
+}
+
+//finalizer for integers and other already-hashed values (eg. libstdc++'s identity std::hash)
+inline uint64_t hash_mix(uint64_t x) {
+	return hash_mum(x^HASH_SECRET[0], HASH_SECRET[1]);
+}
+
+inline uint64_t hash_bytes(void const* key, size_t len, uint64_t seed=0) {
+	unsigned char const* p = static_cast<unsigned char const*>(key);
+	seed ^= hash_mum(seed^HASH_SECRET[0], HASH_SECRET[1]);
+
+	uint64_t a, b;
+	if (len<=16) {
+		if (len>=4) {
+			a = (hash_read4(p)<<32) | hash_read4(p+((len>>3)<<2));
+			b = (hash_read4(p+len-4)<<32) | hash_read4(p+len-4-((len>>3)<<2));
+		} else if (len>0) {
+			a = hash_read3(p, len);
+			b = 0;
+		} else {
+			a = b = 0;
+		}
+	} else {
+		size_t i=len;
+		if (i>48) {
+			uint64_t see1=seed, see2=seed;
+			do {
+				seed = hash_mum(hash_read8(p)^HASH_SECRET[1], hash_read8(p+8)^seed);
+				see1 = hash_mum(hash_read8(p+16)^HASH_SECRET[2], hash_read8(p+24)^see1);
+				see2 = hash_mum(hash_read8(p+32)^HASH_SECRET[3], hash_read8(p+40)^see2);
+				p+=48;
+				i-=48;
+			} while (i>48);
+
+			seed ^= see1^see2;
+		}
+
+		while (i>16) {
+			seed = hash_mum(hash_read8(p)^HASH_SECRET[1], hash_read8(p+8)^seed);
+			i-=16;
+			p+=16;
+		}
+
+		a = hash_read8(p+i-16);
+		b = hash_read8(p+i-8);
+	}
+
+	__uint128_t r = static_cast<__uint128_t>(a^HASH_SECRET[1])*(b^seed);
+	return hash_mum(static_cast<uint64_t>(r)^HASH_SECRET[0]^len, static_cast<uint64_t>(r>>64)^HASH_SECRET[1]);
+}
+
+#endif //CORECOMMON_SRC_HASH_HPP_
@@ -1,22 +1,255 @@
 #ifndef CORECOMMON_SRC_LOCKTABLE_HPP_
 #define CORECOMMON_SRC_LOCKTABLE_HPP_
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <memory>
 #include <mutex>
-#include <vector>
+#include <shared_mutex>
+#include <thread>
+#include <type_traits>
 
-template<class K>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "map.hpp"
+
+//test and test-and-set, for critical sections a few instructions long.
+//backs off to yield() so a waiter can't burn the holder's timeslice forever when threads outnumber cores
+class SpinLock {
+ private:
+	std::atomic<bool> locked;
+
+	static void pause() {
+#if defined(__x86_64__) || defined(__i386__)
+		__builtin_ia32_pause();
+#elif defined(__aarch64__)
+		asm volatile("yield");
+#endif
+	}
+
+ public:
+	SpinLock(): locked(false) {}
+
+	bool try_lock() {
+		return !locked.load(std::memory_order_relaxed) && !locked.exchange(true, std::memory_order_acquire);
+	}
+
+	void lock() {
+		for (unsigned spins=0; !try_lock(); spins++) {
+			if (spins<64) pause();
+			else std::this_thread::yield();
+		}
+	}
+
+	void unlock() {
+		locked.store(false, std::memory_order_release);
+	}
+};
+
+//4 byte mutex that only enters the kernel when contended (drepper's "futexes are tricky", mutex2).
+//state is 0 unlocked, 1 locked, 2 locked and maybe waited on. off linux waiters just yield
+class FutexLock {
+ private:
+	std::atomic<uint32_t> state;
+
+	void wait() {
+#ifdef __linux__
+		syscall(SYS_futex, reinterpret_cast<uint32_t*>(&state), FUTEX_WAIT_PRIVATE, 2, nullptr, nullptr, 0);
+#else
+		std::this_thread::yield();
+#endif
+	}
+
+	void wake() {
+#ifdef __linux__
+		syscall(SYS_futex, reinterpret_cast<uint32_t*>(&state), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#endif
+	}
+
+ public:
+	FutexLock(): state(0) {}
+
+	bool try_lock() {
+		uint32_t c=0;
+		return state.compare_exchange_strong(c, 1, std::memory_order_acquire, std::memory_order_relaxed);
+	}
+
+	void lock() {
+		uint32_t c=0;
+		if (state.compare_exchange_strong(c, 1, std::memory_order_acquire, std::memory_order_relaxed)) return;
+
+		if (c!=2) c=state.exchange(2, std::memory_order_acquire);
+		while (c!=0) {
+			wait();
+			c=state.exchange(2, std::memory_order_acquire);
+		}
+	}
+
+	void unlock() {
+		if (state.exchange(0, std::memory_order_release)==2) wake();
+	}
+};
+
+//locks keys by hashing them onto a fixed set of stripes, each padded to its own cache line.
+//Mutex is std::shared_mutex (the default, which allows lock_shared), SpinLock, FutexLock or anything lockable.
+//stripes are picked by the top bits of Map's hash, so a Map keyed by the same hash can share the index (see ConcurrentMap)
+template<class K, class Mutex = std::shared_mutex, class Hash = MapHash<K>>
 class LockTable {
+ public:
+	using Lookup = typename MapLookup<K, Hash>::type;
+	using Lock = std::unique_lock<Mutex>;
+
+	static constexpr size_t CACHE_LINE=64;
+	static constexpr bool SHARED = std::is_same_v<Mutex, std::shared_mutex> || std::is_same_v<Mutex, std::shared_timed_mutex>;
+
+	struct Stats {
+		//every acquisition, shared or not
+		uint64_t acquisitions;
+		//acquisitions that found the stripe held and had to wait
+		uint64_t contended;
+	};
+
  private:
-	std::vector<std::mutex> mutexes;
+	struct alignas(CACHE_LINE) Stripe {
+		Mutex mtx;
+		std::atomic<uint64_t> acquisitions;
+		std::atomic<uint64_t> contended;
+	};
+
+	std::unique_ptr<Stripe[]> stripes;
+	unsigned stripe_bits;
+
+	void acquire(Stripe& s) {
+		if (!s.mtx.try_lock()) {
+			s.contended.fetch_add(1, std::memory_order_relaxed);
+			s.mtx.lock();
+		}
+
+		s.acquisitions.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void acquire_shared(Stripe& s) {
+		if (!s.mtx.try_lock_shared()) {
+			s.contended.fetch_add(1, std::memory_order_relaxed);
+			s.mtx.lock_shared();
+		}
+
+		s.acquisitions.fetch_add(1, std::memory_order_relaxed);
+	}
 
  public:
-	using Lock = typename std::lock_guard<std::mutex>;
+	//rounded up to a power of two
+	explicit LockTable(unsigned size=64): stripe_bits(0) {
+		while ((1u<<stripe_bits) < size) stripe_bits++;
+		stripes = std::make_unique<Stripe[]>(1<<stripe_bits);
+
+		for (size_t i=0; i<num_stripes(); i++) {
+			stripes[i].acquisitions=0;
+			stripes[i].contended=0;
+		}
+	}
+
+	size_t num_stripes() const {
+		return 1<<stripe_bits;
+	}
+
+	//stripe for a hash from Map<K,...,Hash>::hash
+	size_t stripe_for_hash(size_t h) const {
+		if (stripe_bits==0) return 0;
+		return h >> (sizeof(size_t)*CHAR_BIT - stripe_bits);
+	}
+
+	size_t stripe(Lookup k) const {
+		return stripe_for_hash(Map<K, char, false, std::allocator, Hash>::hash(k));
+	}
+
+	Lock lock_stripe(size_t i) {
+		acquire(stripes[i]);
+		return Lock(stripes[i].mtx, std::adopt_lock);
+	}
+
+	std::shared_lock<Mutex> lock_stripe_shared(size_t i) {
+		static_assert(SHARED, "shared locks need a shared mutex");
+		acquire_shared(stripes[i]);
+		return std::shared_lock<Mutex>(stripes[i].mtx, std::adopt_lock);
+	}
 
-	Lock lock(K& k) {
-		return std::lock_guard(mutexes[std::hash<K>()(k)%mutexes.size()]);
+	Lock lock(Lookup k) {
+		return lock_stripe(stripe(k));
 	}
 
-	LockTable(unsigned size): mutexes(size, std::mutex()) {}
+	std::shared_lock<Mutex> lock_shared(Lookup k) {
+		return lock_stripe_shared(stripe(k));
+	}
+
+	//holds every stripe of a lock_many() call, released in reverse order when destroyed
+	template<size_t N>
+	class ManyLock {
+	 private:
+		std::array<Mutex*, N> held;
+		size_t n;
+
+		friend LockTable;
+		ManyLock(): n(0) {}
+
+	 public:
+		ManyLock(ManyLock const&) = delete;
+		ManyLock(ManyLock&& other): held(other.held), n(other.n) {
+			other.n=0;
+		}
+
+		~ManyLock() {
+			while (n>0) held[--n]->unlock();
+		}
+	};
+
+	//locks the stripes of all keys in stripe order, each once, so two threads locking overlapping sets can't deadlock.
+	//don't hold another lock from this table while calling it, that would break the ordering
+	template<class ...Keys>
+	ManyLock<sizeof...(Keys)> lock_many(Keys const&... keys) {
+		std::array<size_t, sizeof...(Keys)> idx = {stripe(keys)...};
+		std::sort(idx.begin(), idx.end());
+
+		ManyLock<sizeof...(Keys)> many;
+		for (size_t i=0; i<idx.size(); i++) {
+			if (i>0 && idx[i]==idx[i-1]) continue;
+
+			acquire(stripes[idx[i]]);
+			many.held[many.n++] = &stripes[idx[i]].mtx;
+		}
+
+		return many;
+	}
+
+	Stats stats(size_t i) const {
+		return {.acquisitions=stripes[i].acquisitions.load(std::memory_order_relaxed),
+		        .contended=stripes[i].contended.load(std::memory_order_relaxed)};
+	}
+
+	Stats total_stats() const {
+		Stats total = {.acquisitions=0, .contended=0};
+		for (size_t i=0; i<num_stripes(); i++) {
+			Stats s = stats(i);
+			total.acquisitions += s.acquisitions;
+			total.contended += s.contended;
+		}
+
+		return total;
+	}
+
+	void reset_stats() {
+		for (size_t i=0; i<num_stripes(); i++) {
+			stripes[i].acquisitions.store(0, std::memory_order_relaxed);
+			stripes[i].contended.store(0, std::memory_order_relaxed);
+		}
+	}
 };
 
 #endif //CORECOMMON_SRC_LOCKTABLE_HPP_
@@ -3,32 +3,85 @@
 
 #include <array>
 #include <limits>
+#include <climits>
 #include <vector>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <utility>
 #include <optional>
+#include <tuple>
 
-#if __arm__
-#include <arm_neon.h>
-#endif
+#include "hash.hpp"
 
-#if __SSE__
+//group scans are vectorized per isa at compile time, define MAP_NO_SIMD to force the scalar loop
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
 #include <emmintrin.h>
 #endif
 
-template<class K, class V, bool multiple=false, template<class> class Allocator = std::allocator>
+//the low byte of a hash is used as its tag and the rest picks the group, so every bit has to be mixed.
+//std::hash alone won't do, eg. libstdc++ hashes integers to themselves and sequential ids would share a group
+template<class K>
+struct MapHash {
+	size_t operator()(K const& k) const {
+		return hash_mix(std::hash<K>()(k));
+	}
+};
+
+//strings hash through string_view, so stored keys and string_view/char const* probes agree without allocating
+template<>
+struct MapHash<std::string> {
+	using key_view = std::string_view;
+
+	size_t operator()(std::string_view k) const {
+		return hash_bytes(k.data(), k.size());
+	}
+};
+
+template<>
+struct MapHash<std::string_view>: MapHash<std::string> {};
+
+//lookups take the hash's key_view if it has one, otherwise a K const&
+template<class K, class Hash, class=void>
+struct MapLookup {
+	using type = K const&;
+};
+
+template<class K, class Hash>
+struct MapLookup<K, Hash, std::void_t<typename Hash::key_view>> {
+	using type = typename Hash::key_view;
+};
+
+//Hash may expose a key_view type for allocation-free lookups (see MapHash<std::string>).
+//with store_hash, full hashes are kept beside the buckets so rehashing never calls Hash and probes skip
+//comparing keys whose hashes differ, worth it when keys are expensive to hash or compare.
+//Allocator may be stateful (eg. ArenaAllocator), pass an instance to the constructor. it's rebound for the control
+//bytes and hashes, and follows the table through copies, moves and swaps
+template<class K, class V, bool multiple=false, template<class> class Allocator = std::allocator,
+         class Hash = MapHash<K>, bool store_hash = false>
 class Map {
  public:
 	size_t count;
+	//removed slots still marked SENTINEL, which lengthen probes until the next rehash
+	size_t tombstones;
 	using Bucket = std::pair<K, V>;
+	using Lookup = typename MapLookup<K, Hash>::type;
+	using allocator_type = Allocator<Bucket>;
 
-	Map() {
-		count=0;
+	Map(): Map(allocator_type()) {}
+
+	explicit Map(allocator_type const& alloc): count(0), tombstones(0), control_bytes(ControlBytesAllocator(alloc)),
+	                                           buckets(0, alloc), hashes(Allocator<size_t>(alloc)) {
 		resize(DEFAULT_BUCKETS);
 	}
 
-	Map(unsigned cap): count(0) {
+	Map(unsigned cap, allocator_type const& alloc = allocator_type()): count(0), tombstones(0), control_bytes(ControlBytesAllocator(alloc)),
+	                                                                   buckets(0, alloc), hashes(Allocator<size_t>(alloc)) {
 		unsigned sz=0;
 		for (; (1<<sz)<=cap; sz++);
 		resize((1<<(sz+1)));
@@ -38,86 +91,117 @@ class Map {
 		for (auto [k,v]: init) insert(k,v);
 	}
 
-	V* operator[](K const& k) {
-		FindIterator x=find_begin(k);
-		return x.bucket ? &x.bucket->second : nullptr;
+	Map(Map const& other): count(other.count), tombstones(other.tombstones), control_bytes(other.control_bytes),
+	                       buckets(other.buckets.size(), other.buckets.get_allocator()), hashes(other.hashes) {
+		for_each_full([&](size_t i) { ::new (&buckets[i]) Bucket(other.buckets[i]); });
 	}
 
-	V const* operator[](K const& k) const {
-		return const_cast<Map&>(*this)[k];
+	//leaves other empty without allocating, so containers of maps move them on reallocation instead of copying
+	Map(Map&& other) noexcept: count(0), tombstones(0), control_bytes(other.control_bytes.get_allocator()),
+	                           buckets(0, other.buckets.get_allocator()), hashes(other.hashes.get_allocator()) {
+		swap(other);
 	}
 
-	std::optional<V> insert(K k, V v) {
-		check_resize();
+	Map& swap(Map& other) noexcept {
+		std::swap(count, other.count);
+		std::swap(tombstones, other.tombstones);
+		control_bytes.swap(other.control_bytes);
+		buckets.swap(other.buckets);
+		hashes.swap(other.hashes);
+		return *this;
+	}
 
-		size_t h = do_hash(k);
-		Probe p = Probe(*this, h);
+	Map& operator=(Map other) {
+		return swap(other);
+	}
 
-		Bucket* bucket;
-		if (multiple) {
-			while (!(bucket = p.insert())) ++p;
-			count++;
-		} else {
-			while (true) {
-				MatchResult res = p.match(k);
-				if ((bucket=res.match)) {
-					V copy = std::move(bucket->second);
-					bucket->second = v;
-					return std::make_optional<V>(std::move(copy));
-				} else if (!res.cont) {
-					bucket=p.insert();
-					count++;
-					break;
-				}
+	~Map() {
+		for_each_full([&](size_t i) { buckets[i].~Bucket(); });
+	}
 
-				++p;
-			}
-		}
+	V* operator[](Lookup k) {
+		return find_hashed(k, do_hash(k));
+	}
 
-		bucket->first = k;
-		bucket->second = v;
-		return std::optional<V>();
+	V const* operator[](Lookup k) const {
+		return const_cast<Map&>(*this)[k];
 	}
 
-	V& upsert(K k) {
-		check_resize();
+	//returns the previous value if k was already present
+	std::optional<V> insert(K const& k, V v) {
+		return insert_or_assign(k, std::move(v), do_hash(k));
+	}
 
+	std::optional<V> insert(K&& k, V v) {
 		size_t h = do_hash(k);
-		Probe p = Probe(*this, h);
+		return insert_or_assign(std::move(k), std::move(v), h);
+	}
 
-		Bucket* bucket;
-		if (multiple) {
-			while (!(bucket = p.insert())) ++p;
-			count++;
-		} else {
-			while (true) {
-				MatchResult res = p.match(k);
-				if ((bucket=res.match)) {
-					return bucket->second;
-				} else if (!res.cont) {
-					bucket=p.insert();
-					count++;
-					break;
-				}
+	//constructs the value from args only if k isn't present, returning it and whether it was inserted
+	template<class ...Args>
+	std::pair<V*, bool> emplace(K const& k, Args&&... args) {
+		return emplace_key(do_hash(k), k, std::forward<Args>(args)...);
+	}
 
-				++p;
-			}
-		}
+	template<class ...Args>
+	std::pair<V*, bool> emplace(K&& k, Args&&... args) {
+		size_t h = do_hash(k);
+		return emplace_key(h, std::move(k), std::forward<Args>(args)...);
+	}
 
-		bucket->first = k;
-		return bucket->second;
+	V& upsert(K const& k) {
+		return *emplace_key(do_hash(k), k).first;
 	}
 
-	std::optional<V> remove(K& k) {
+	V& upsert(K&& k) {
 		size_t h = do_hash(k);
+		return *emplace_key(h, std::move(k)).first;
+	}
+
+	std::optional<V> remove(Lookup k) {
+		return remove_hashed(k, do_hash(k));
+	}
+
+	//the hash the table is keyed by, for callers that need one too (eg. ConcurrentMap picking a shard).
+	//the *_hashed functions take it back instead of hashing k again, anything but hash(k) corrupts the table
+	static size_t hash(Lookup k) {
+		return do_hash(k);
+	}
+
+	V* find_hashed(Lookup k, size_t h) {
+		FindIterator x(*this, k, h);
+		return x.bucket ? &x.bucket->second : nullptr;
+	}
+
+	V const* find_hashed(Lookup k, size_t h) const {
+		return const_cast<Map&>(*this).find_hashed(k, h);
+	}
+
+	std::optional<V> insert_hashed(K const& k, V v, size_t h) {
+		return insert_or_assign(k, std::move(v), h);
+	}
+
+	std::optional<V> insert_hashed(K&& k, V v, size_t h) {
+		return insert_or_assign(std::move(k), std::move(v), h);
+	}
+
+	template<class ...Args>
+	std::pair<V*, bool> emplace_hashed(size_t h, K const& k, Args&&... args) {
+		return emplace_key(h, k, std::forward<Args>(args)...);
+	}
+
+	std::optional<V> remove_hashed(Lookup k, size_t h) {
+		if (control_bytes.empty()) return std::optional<V>();
+
 		Probe p = Probe(*this, h);
 
 		while (true) {
 			MatchResult res = p.match(k);
 
 			if (res.match) {
+				std::optional<V> ret(std::move(res.match->second));
 				p.remove();
-				return std::optional(res.match->second);
+				return ret;
 			} else if (!res.cont) {
 				break;
 			}
@@ -130,6 +214,7 @@ class Map {
 
  private:
 	static const unsigned char NUM_CONTROL_BYTES=16;
+	static const unsigned char SLOT_MASK=NUM_CONTROL_BYTES-1;
 	static const unsigned char SENTINEL=0x80;
 	static const unsigned char DEFAULT_BUCKETS=2;
 
@@ -138,19 +223,99 @@ class Map {
 	using BucketAllocator = Allocator<Bucket>;
 	using ControlBytesAllocator = Allocator<ControlBytes>;
 
+	//raw storage, only slots whose control byte holds a tag have a constructed Bucket
+	class BucketStorage {
+	 private:
+		BucketAllocator alloc;
+		Bucket* ptr;
+		size_t sz;
+
+	 public:
+		BucketStorage(size_t n, BucketAllocator const& alloc): alloc(alloc),
+		                                                       ptr(n>0 ? std::allocator_traits<BucketAllocator>::allocate(this->alloc, n) : nullptr), sz(n) {}
+		BucketStorage(BucketStorage const&) = delete;
+
+		BucketAllocator get_allocator() const { return alloc; }
+
+		void swap(BucketStorage& other) noexcept {
+			std::swap(alloc, other.alloc);
+			std::swap(ptr, other.ptr);
+			std::swap(sz, other.sz);
+		}
+
+		Bucket* data() const { return ptr; }
+		size_t size() const { return sz; }
+		Bucket& operator[](size_t i) const { return ptr[i]; }
+
+		~BucketStorage() {
+			if (ptr) std::allocator_traits<BucketAllocator>::deallocate(alloc, ptr, sz);
+		}
+	};
+
 	//stores partial hashes of bucketed items, 0x80 if item ahead in probe chain
 	//0x00 if empty
 	std::vector<ControlBytes, ControlBytesAllocator> control_bytes;
-	std::vector<Bucket, BucketAllocator> buckets;
+	BucketStorage buckets;
+	//full hash per slot, only sized if store_hash
+	std::vector<size_t, Allocator<size_t>> hashes;
+
+	static bool is_full(unsigned char control) {
+		return control!=0 && control!=SENTINEL;
+	}
+
+	template<class F>
+	void for_each_full(F f) const {
+		for (size_t i=0; i<control_bytes.size(); i++) {
+			for (unsigned char c=0; c<NUM_CONTROL_BYTES; c++) {
+				if (is_full(control_bytes[i][c])) f(i*NUM_CONTROL_BYTES+c);
+			}
+		}
+	}
 
 	constexpr static float LOAD_FACTOR_CONSTANT = 2;
 
+	//tombstones count towards the load, otherwise churn could fill every group and probes would never end
 	bool load_factor() const {
-		return LOAD_FACTOR_CONSTANT*count>buckets.size();
+		return LOAD_FACTOR_CONSTANT*(count+tombstones)>buckets.size();
+	}
+
+	//compact instead of growing while live entries are at most 25/32 of the max load (like abseil), so a table
+	//churning at a steady size rebuilds in place. the rest of the max load is the slack before the next compaction
+	bool mostly_tombstones() const {
+		return 32*LOAD_FACTOR_CONSTANT*count<=25*buckets.size();
 	}
 
-	static size_t do_hash(K const& k) {
-		size_t h = std::hash<K>()(k);
+	//a group with an empty slot has never been full, so no probe went past it and the slot can be freed outright
+	void erase_slot(size_t slot) {
+		buckets[slot].~Bucket();
+
+		unsigned char* group = control_bytes[slot/NUM_CONTROL_BYTES].data();
+		unsigned char c = slot&SLOT_MASK;
+		if (Group(group).match_empty()) {
+			group[c] = 0;
+		} else {
+			group[c] = SENTINEL;
+			tombstones++;
+		}
+
+		count--;
+	}
+
+	//tags a free slot, taking it back from the tombstones if it was one
+	void occupy(size_t slot, size_t hash) {
+		unsigned char& control = control_bytes[slot/NUM_CONTROL_BYTES][slot&SLOT_MASK];
+		if (control==SENTINEL) tombstones--;
+		control = hash&UCHAR_MAX;
+	}
+
+	static unsigned groups_for(size_t n) {
+		unsigned to=DEFAULT_BUCKETS;
+		while (to*NUM_CONTROL_BYTES < LOAD_FACTOR_CONSTANT*n) to*=2;
+		return to;
+	}
+
+	static size_t do_hash(Lookup k) {
+		size_t h = Hash()(k);
 		if ((h&UCHAR_MAX)==0 || (h&UCHAR_MAX)==SENTINEL) {
 			h=~h;
 		}
@@ -163,191 +328,401 @@ class Map {
 		Bucket* match;
 	};
 
+	//one group of control bytes, scanned with a single compare+movemask per query where the isa allows it
+	//masks have one bit (or with neon, one nibble) per control byte; use offset() to turn the lowest set bit into an index
+	struct Group {
+#if defined(__ARM_NEON) && !defined(MAP_NO_SIMD)
+		using Mask = uint64_t;
+		//neon has no movemask, so we narrow each 16 bit lane by 4 and keep the top bit of every nibble
+		static constexpr unsigned MASK_SHIFT = 2;
+		static constexpr Mask MASK_BITS = 0x8888888888888888ull;
+
+		uint8x16_t ctrl;
+		explicit Group(unsigned char const* bytes): ctrl(vld1q_u8(bytes)) {}
+
+		static Mask movemask(uint8x16_t eq) {
+			return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0) & MASK_BITS;
+		}
+
+		Mask match(unsigned char target) const {
+			return movemask(vceqq_u8(ctrl, vdupq_n_u8(target)));
+		}
+
+		Mask match_empty() const {
+			return movemask(vceqq_u8(ctrl, vdupq_n_u8(0)));
+		}
+
+		Mask match_free() const {
+			return movemask(vorrq_u8(vceqq_u8(ctrl, vdupq_n_u8(0)), vceqq_u8(ctrl, vdupq_n_u8(SENTINEL))));
+		}
+
+		std::pair<Mask, Mask> match_and_empty(unsigned char target) const {
+			return {match(target), match_empty()};
+		}
+#elif defined(__SSE2__) && !defined(MAP_NO_SIMD)
+		using Mask = uint32_t;
+		static constexpr unsigned MASK_SHIFT = 0;
+
+		__m128i ctrl;
+		explicit Group(unsigned char const* bytes): ctrl(_mm_loadu_si128(reinterpret_cast<__m128i const*>(bytes))) {}
+
+		Mask match(unsigned char target) const {
+			return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(static_cast<char>(target))));
+		}
+
+		Mask match_empty() const {
+			return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_setzero_si128()));
+		}
+
+		Mask match_free() const {
+			return _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(ctrl, _mm_setzero_si128()),
+			                                      _mm_cmpeq_epi8(ctrl, _mm_set1_epi8(static_cast<char>(SENTINEL)))));
+		}
+
+		std::pair<Mask, Mask> match_and_empty(unsigned char target) const {
+#ifdef __AVX2__
+			//both lanes hold the group, compared against the tag in the low lane and empty in the high one
+			__m256i needle = _mm256_set_m128i(_mm_setzero_si128(), _mm_set1_epi8(static_cast<char>(target)));
+			Mask both = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_broadcastsi128_si256(ctrl), needle));
+			return {both & 0xFFFF, both >> NUM_CONTROL_BYTES};
+#else
+			return {match(target), match_empty()};
+#endif
+		}
+#else
+		using Mask = uint32_t;
+		static constexpr unsigned MASK_SHIFT = 0;
+
+		unsigned char const* ctrl;
+		explicit Group(unsigned char const* bytes): ctrl(bytes) {}
+
+		template<class F>
+		Mask scan(F f) const {
+			Mask m=0;
+			for (unsigned char c=0; c<NUM_CONTROL_BYTES; c++) {
+				m |= static_cast<Mask>(f(ctrl[c]))<<c;
+			}
+
+			return m;
+		}
+
+		Mask match(unsigned char target) const {
+			return scan([target](unsigned char x){ return x==target; });
+		}
+
+		Mask match_empty() const {
+			return scan([](unsigned char x){ return x==0; });
+		}
+
+		Mask match_free() const {
+			return scan([](unsigned char x){ return x==0 || x==SENTINEL; });
+		}
+
+		std::pair<Mask, Mask> match_and_empty(unsigned char target) const {
+			return {match(target), match_empty()};
+		}
+#endif
+
+		static unsigned char offset(Mask m) {
+			if constexpr (sizeof(Mask)>sizeof(unsigned)) return __builtin_ctzll(m) >> MASK_SHIFT;
+			else return __builtin_ctz(m) >> MASK_SHIFT;
+		}
+	};
+
+	//the number of groups is always a power of two, so probes wrap with a mask instead of a division.
+	//step n moves n groups past step n-1, ie. the nth group visited is home+n(n+1)/2. those triangular numbers are
+	//distinct mod any power of two for n<size, so a probe visits every group exactly once before it repeats
 	class Probe {
 	 public:
 		Map& map;
 
-		unsigned i;
+		size_t mask;
+		size_t i;
 		unsigned char* current;
 		unsigned probe_i;
 		unsigned char c;
 		unsigned char target;
+		size_t hash;
 
 		bool cont;
-#ifdef __SSE__
-		uint16_t current_matches;
-#elif defined(__arm__)
-		uint64_t current_matches[2];
-#endif
+		bool loaded;
+		typename Group::Mask current_matches;
 
-		Probe(Map& map, size_t hash): map(map), i((hash >> 8) % map.control_bytes.size()),
-		                              current(map.control_bytes[i].data()), probe_i(0), c(0), target(hash&UCHAR_MAX) {}
+		Probe(Map& map, size_t hash): map(map), mask(map.control_bytes.size()-1), i((hash >> 8) & mask),
+		                              current(map.control_bytes[i].data()), probe_i(0), c(0), target(hash&UCHAR_MAX), hash(hash), loaded(false) {}
 
 		void operator++() {
 			probe_i++;
-			i=(i+probe_i)%map.control_bytes.size();
+			i=(i+probe_i)&mask;
 			current=map.control_bytes[i].data();
 
 			c=0;
+			loaded=false;
 		}
 
-		MatchResult match(K const& k) {
-			//one of the big points about the extra metadata is that this is sse optimized
-			//but imma just let the compiler sort that out, hopefully (last time i used sse, it was practically the only hindrance from portability)
-			//its still better than just hashing in that i can store sentinels & shizz
-			//plus VERY locality, probably
+		//returns the next bucket in this group whose tag and key match, resuming after the previous match.
+		//cont is false once the group has an empty slot, since the key can't have been pushed past it
+		MatchResult match(Lookup k) {
 			MatchResult res = {.match=nullptr};
 
-			//does faster than sse experiments kinda, uncomment if u dont believe me (or look at the crappy "sse" code)
-#if true//!defined(__SSE__) && !defined(__arm__)
-			if (c==0) {
-				cont=true;
-				for (; c<NUM_CONTROL_BYTES; c++) {
-					if (!current[c]) {
-						cont=false;
-					}
-				}
-
-				c=0;
+			if (!loaded) {
+				auto [matches, empty] = Group(current).match_and_empty(target);
+				current_matches = matches;
+				cont = empty==0;
+				loaded = true;
 			}
 
-			for (; c<NUM_CONTROL_BYTES; c++) {
-				if (current[c]==target) {
-					Bucket* bucket = &map.buckets[i*NUM_CONTROL_BYTES+c];
-					if (bucket->first==k) {
-						res.match=bucket;
-						break;
-					}
-				}
-			}
-#else
-			if (c==0) {
-#ifdef __SSE__
-				__m128i control_byte_vec = _mm_loadu_si128((const __m128i*)current);
-
-				__m128i result = _mm_cmpeq_epi8(_mm_set1_epi8(target), control_byte_vec);
-				current_matches = _mm_movemask_epi8(result);
-
-				cont = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(0), control_byte_vec))==0;
-
-#elif defined(__arm__)
-				uint8x16_t control_byte_vec = vld1q_u8(current);
-				uint8x16_t result = vceqq_u8(control_byte_vec, vdupq_n_u8(target));
-				vst1q_u8((uint8_t*)current_matches, result); //no movemask?
-
-				uint8x16_t empty_res = vceqq_u8(control_byte_vec, vdupq_n_u8(0));
-				uint64_t empty_mem[2];
-				vst1q_u8((uint8_t*)empty_mem, empty_res);
+			while (current_matches) {
+				c = Group::offset(current_matches);
+				current_matches &= current_matches-1;
 
-				cont = empty_mem[0]==0 && empty_mem[1]==0;
-#endif
-			}
-
-			unsigned offset;
-#ifdef __SSE__
-			while (current_matches > 0) {
-				offset = __builtin_ctz(current_matches);
-#elif defined(__arm__)
-			while (masked[0] > 0 || masked[1] > 0) {
-				offset = masked[0]>0 ? __builtin_ctzll(masked[0])/8 : __builtin_ctzll(masked[1])/8;
-#endif
-
-#ifdef __SSE__
-				current_matches >>= offset+1;
-				c+=offset+1;
-#elif defined(__arm__)
-				if (masked[0]>0) {
-					masked[0] >>= 8*(c+1);
-					if (masked[0]==0) c=8;
-					else c += offset+1;
-				} else {
-					masked[1] >>= 8*(offset-7);
-					c += offset-7;
+				size_t slot = i*NUM_CONTROL_BYTES+c;
+				if constexpr (store_hash) {
+					if (map.hashes[slot]!=hash) continue;
 				}
-#endif
 
-				Bucket* bucket = &map.buckets[i*NUM_CONTROL_BYTES+c-1];
+				Bucket* bucket = &map.buckets[slot];
 				if (bucket->first==k) {
 					res.match=bucket;
 					break;
 				}
 			}
 
-#endif
-
 			res.cont=cont;
 			return res;
 		}
 
+		//the first empty or tombstone slot in the current group
+		std::optional<size_t> free_slot() const {
+			typename Group::Mask free = Group(current).match_free();
+			if (!free) return std::optional<size_t>();
+			return i*NUM_CONTROL_BYTES+Group::offset(free);
+		}
+
 		Bucket* insert() {
-			for (c=0; c<NUM_CONTROL_BYTES; c++) {
-				if (current[c]==0 || current[c]==SENTINEL) {
-					current[c] = target;
-					return &map.buckets[i*NUM_CONTROL_BYTES+c];
-				}
-			}
+			std::optional<size_t> slot = free_slot();
+			if (!slot) return nullptr;
 
-			return nullptr;
+			c = *slot&SLOT_MASK;
+			map.occupy(*slot, hash);
+			return &map.buckets[*slot];
 		}
 
 		void remove() {
-			current[c] = SENTINEL;
-			map.count--;
+			map.erase_slot(i*NUM_CONTROL_BYTES+c);
 		}
 	};
 
+	//moves every live bucket into a fresh table of `to` groups, dropping tombstones
 	void resize(unsigned to) {
-		unsigned long prev_sz = control_bytes.size();
-
 		ControlBytes cbytes;
 		cbytes.fill(0);
-		control_bytes.resize(to, cbytes);
 
-		buckets.resize(to*NUM_CONTROL_BYTES);
-
-		for (unsigned i=0; i<prev_sz; i++) {
-			ControlBytes& control = control_bytes[i];
+		std::vector<ControlBytes, ControlBytesAllocator> old_control(to, cbytes, control_bytes.get_allocator());
+		BucketStorage old_buckets(to*NUM_CONTROL_BYTES, buckets.get_allocator());
+		std::vector<size_t, Allocator<size_t>> old_hashes(store_hash ? to*NUM_CONTROL_BYTES : 0, hashes.get_allocator());
+		control_bytes.swap(old_control);
+		buckets.swap(old_buckets);
+		hashes.swap(old_hashes);
+		tombstones=0;
 
+		for (size_t i=0; i<old_control.size(); i++) {
 			for (unsigned char c=0; c<NUM_CONTROL_BYTES; c++) {
-				if (control[c]==SENTINEL) continue;
+				if (!is_full(old_control[i][c])) continue;
+
+				size_t slot = i*NUM_CONTROL_BYTES+c;
+				Bucket& bucket = old_buckets[slot];
+				Probe p(*this, store_hash ? old_hashes[slot] : do_hash(bucket.first));
+				Bucket* insertion = claim(p);
+
+				::new (insertion) Bucket(std::move(bucket));
+				bucket.~Bucket();
+			}
+		}
+	}
+
+	//rehashes at the same capacity without reallocating the buckets.
+	//every live bucket is marked pending and its control byte cleared, then each pending bucket is moved to the
+	//first free slot on its probe sequence, swapping with (and then placing) any pending bucket found there
+	void compact() {
+		std::vector<bool> pending(buckets.size());
 
-				if (control[c]) {
-					Bucket& bucket = buckets[i*NUM_CONTROL_BYTES+c];
-					size_t h = do_hash(bucket.first);
+		for (size_t i=0; i<control_bytes.size(); i++) {
+			for (unsigned char c=0; c<NUM_CONTROL_BYTES; c++) {
+				unsigned char& control = control_bytes[i][c];
+				pending[i*NUM_CONTROL_BYTES+c] = is_full(control);
+				control=0;
+			}
+		}
 
-					if ((h>>8)%to >= prev_sz) {
-						control[c] = SENTINEL;
+		tombstones=0;
 
-						Probe p(*this, h);
-						Bucket* insertion;
+		for (size_t s=0; s<buckets.size(); s++) {
+			while (pending[s]) {
+				Probe p(*this, store_hash ? hashes[s] : do_hash(buckets[s].first));
 
-						while ((insertion=p.insert())==nullptr)
-							++p;
+				Bucket* insertion;
+				while ((insertion=p.insert())==nullptr)
+					++p;
 
-						*insertion = bucket;
-					}
+				size_t t = insertion-buckets.data();
+				if (t==s) {
+					pending[s]=false;
+				} else if (pending[t]) {
+					std::swap(buckets[s], buckets[t]);
+					if constexpr (store_hash) std::swap(hashes[s], hashes[t]);
+					pending[t]=false;
+				} else {
+					::new (insertion) Bucket(std::move(buckets[s]));
+					buckets[s].~Bucket();
+					if constexpr (store_hash) hashes[t] = hashes[s];
+					pending[s]=false;
 				}
 			}
 		}
 	}
 
+	//claims the first free slot on p's probe sequence, recording its hash
+	Bucket* claim(Probe& p) {
+		Bucket* bucket;
+		while (!(bucket = p.insert())) ++p;
+
+		if constexpr (store_hash) hashes[bucket-buckets.data()] = p.hash;
+		return bucket;
+	}
+
 	void check_resize() {
-		if (load_factor()) {
-			resize(control_bytes.size()*2);
+		if (control_bytes.empty()) {
+			resize(DEFAULT_BUCKETS);
+		} else if (load_factor()) {
+			if (mostly_tombstones()) compact();
+			else resize(control_bytes.size()*2);
+		}
+	}
+
+	//where k's bucket is, or the free slot it should go in
+	struct Position {
+		size_t slot;
+		size_t hash;
+		bool found;
+	};
+
+	//free slots aren't marked here, the caller constructs the bucket and then calls commit().
+	//so a throwing key or value constructor leaves the table as it was
+	Position find_or_free(K const& k, size_t h) {
+		check_resize();
+
+		Probe p = Probe(*this, h);
+
+		if (multiple) {
+			std::optional<size_t> slot;
+			while (!(slot = p.free_slot())) ++p;
+			return {*slot, p.hash, false};
+		}
+
+		//the first free slot on the way, which may be a tombstone several groups before the one that ends the probe.
+		//it's only taken once k is known to be absent, otherwise churn never gets those tombstones back
+		std::optional<size_t> reuse;
+
+		while (true) {
+			MatchResult res = p.match(k);
+			if (res.match) {
+				return {static_cast<size_t>(res.match-buckets.data()), p.hash, true};
+			}
+
+			if (!reuse) reuse = p.free_slot();
+			if (!res.cont) return {*reuse, p.hash, false};
+
+			++p;
 		}
 	}
 
+	void commit(Position const& pos) {
+		occupy(pos.slot, pos.hash);
+		if constexpr (store_hash) hashes[pos.slot] = pos.hash;
+		count++;
+	}
+
+	template<class KRef>
+	std::optional<V> insert_or_assign(KRef&& k, V&& v, size_t h) {
+		Position pos = find_or_free(k, h);
+		Bucket* bucket = &buckets[pos.slot];
+
+		if (pos.found) {
+			V old = std::move(bucket->second);
+			bucket->second = std::move(v);
+			return std::make_optional<V>(std::move(old));
+		}
+
+		::new (bucket) Bucket(std::forward<KRef>(k), std::move(v));
+		commit(pos);
+		return std::optional<V>();
+	}
+
+	template<class KRef, class ...Args>
+	std::pair<V*, bool> emplace_key(size_t h, KRef&& k, Args&&... args) {
+		Position pos = find_or_free(k, h);
+		Bucket* bucket = &buckets[pos.slot];
+
+		if (!pos.found) {
+			::new (bucket) Bucket(std::piecewise_construct, std::forward_as_tuple(std::forward<KRef>(k)),
+			                      std::forward_as_tuple(std::forward<Args>(args)...));
+			commit(pos);
+		}
+
+		return {&bucket->second, !pos.found};
+	}
+
  public:
+	//grows so n entries fit without another resize
+	void reserve(size_t n) {
+		unsigned to = groups_for(n);
+		if (to>control_bytes.size()) resize(to);
+	}
+
+	//shrinks to the smallest table that holds the current entries, also dropping tombstones
+	void shrink_to_fit() {
+		resize(groups_for(count));
+	}
+
+	size_t capacity() const {
+		return buckets.size();
+	}
+
+	//histogram of how many groups each entry's probe visits before reaching it, so [1] counts entries in their
+	//home group. computed on demand by walking every entry, cheap enough to dump now and then to check table health
+	std::vector<size_t> probe_histogram() const {
+		std::vector<size_t> hist;
+		Map& map = const_cast<Map&>(*this);
+
+		for_each_full([&](size_t slot) {
+			Probe p(map, store_hash ? hashes[slot] : do_hash(buckets[slot].first));
+
+			size_t len=1;
+			for (; p.i!=slot/NUM_CONTROL_BYTES; len++) ++p;
+
+			if (hist.size()<=len) hist.resize(len+1);
+			hist[len]++;
+		});
+
+		return hist;
+	}
+
 	class FindIterator {
 	 private:
 		struct Cursor {
 			Probe probe;
-			K const& k;
+			Lookup k;
 		};
 
 		std::optional<Cursor> cursor;
 
-		FindIterator(Map& map, K const& k, size_t h): cursor({.probe=Probe(map, h), .k=k}) {
+		friend Map;
+		FindIterator(Map& map, Lookup k, size_t h) {
+			//a moved-from map has no groups to probe
+			if (map.control_bytes.empty()) return;
+
+			cursor.emplace(Cursor {.probe=Probe(map, h), .k=k});
 			++*this;
 		}
 
@@ -361,11 +736,10 @@ class Map {
 		Bucket* bucket=nullptr;
 
 		FindIterator() {}
-		FindIterator(Map& map, K const& k): FindIterator(map, k, do_hash(k)) { }
+		FindIterator(Map& map, Lookup k): FindIterator(map, k, do_hash(k)) { }
 
+		//the probe resumes after its last match, so duplicates in one group are all visited
 		void operator++() {
-			if (bucket) ++cursor->probe;
-
 			MatchResult res;
 			do {
 				res = cursor->probe.match(cursor->k);
@@ -402,7 +776,7 @@ class Map {
 		}
 	};
 
-	FindIterator find_begin(K const& k) {
+	FindIterator find_begin(Lookup k) {
 		return FindIterator(*this, k);
 	}
 
@@ -422,14 +796,14 @@ class Map {
 		Map& map;
 
 		void operator++() {
-			if (++c % NUM_CONTROL_BYTES == 0 && c!=0) ++iter;
+			if ((++c & SLOT_MASK) == 0 && c!=0) ++iter;
 
 			while (c<map.buckets.size()) {
 				do {
-					if ((*iter)[c%NUM_CONTROL_BYTES]!=0 && (*iter)[c%NUM_CONTROL_BYTES]!=SENTINEL) {
+					if (is_full((*iter)[c&SLOT_MASK])) {
 						return;
 					}
-				} while (++c % NUM_CONTROL_BYTES != 0);
+				} while ((++c & SLOT_MASK) != 0);
 
 				++iter;
 			}
@@ -444,8 +818,7 @@ class Map {
 		}
 
 		void remove() {
-			(*iter)[c%NUM_CONTROL_BYTES] = SENTINEL;
-			map.count--;
+			map.erase_slot(c);
 		}
 
 		std::pair<K,V>& operator*() {
@@ -470,14 +843,14 @@ class Map {
 		Map const& map;
 
 		void operator++() {
-			if (++c % NUM_CONTROL_BYTES == 0 && c!=0) ++iter; //ha! c++! geddit?!1
+			if ((++c & SLOT_MASK) == 0 && c!=0) ++iter; //ha! c++! geddit?!1
 
 			while (c<map.buckets.size()) {
 				do {
-					if ((*iter)[c%NUM_CONTROL_BYTES]!=0 && (*iter)[c%NUM_CONTROL_BYTES]!=SENTINEL) {
+					if (is_full((*iter)[c&SLOT_MASK])) {
 						return;
 					}
-				} while (++c % NUM_CONTROL_BYTES != 0);
+				} while ((++c & SLOT_MASK) != 0);
 
 				++iter;
 			}
@@ -511,8 +884,10 @@ class Map {
 	}
 
 	void clear() {
-		auto it = begin(), to=end();
-		for (; it!=to; ++it) it.remove();
+		for_each_full([&](size_t i) { buckets[i].~Bucket(); });
+		for (ControlBytes& control: control_bytes) control.fill(0);
+		count=0;
+		tombstones=0;
 	}
 
 	ConstIterator begin() const {
@@ -1,144 +1,874 @@
 #ifndef CORECOMMON_SRC_SERIALIZE_HPP_
 #define CORECOMMON_SRC_SERIALIZE_HPP_
 
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
 #include <iostream>
-#include <sstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "map.hpp"
 #include "util.hpp"
 
-struct UnserializableType: public std::exception {
-	char const* what() const noexcept {
-		return "could not serialize type";
+//the format: scalars are little endian and fixed width, lengths are VarInts (see VarIntRef), strings are a length
+//and their bytes, and arrays of scalars are a length, padding up to the element's alignment (counted from the start
+//of the output) and the elements as they are in memory on little endian hosts. so reading from an aligned buffer
+//can return views into it.
+//optionals are a byte saying whether there's a value and the value, variants the alternative's index as a VarInt
+//and the alternative, pairs both halves, Maps the count and each key and value, and structs with SerializeFields
+//their fields in order
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__==__ORDER_BIG_ENDIAN__
+static constexpr bool SERIALIZE_LITTLE_ENDIAN = false;
+#else
+static constexpr bool SERIALIZE_LITTLE_ENDIAN = true;
+#endif
+
+struct SerializeOverflow: public std::exception {
+	char const* what() const noexcept override {
+		return "serialized output doesn't fit";
+	}
+};
+
+struct DeserializeEnd: public std::exception {
+	char const* what() const noexcept override {
+		return "unexpected end of serialized input";
+	}
+};
+
+struct DeserializeInvalid: public std::exception {
+	char const* what() const noexcept override {
+		return "serialized input is malformed";
+	}
+};
+
+//opening, mapping or reading the input failed with errno err
+struct SerializeIOError: public std::exception {
+	int err;
+
+	explicit SerializeIOError(int err): err(err) {}
+
+	char const* what() const noexcept override {
+		return std::strerror(err);
+	}
+};
+
+struct MisalignedView: public std::exception {
+	char const* what() const noexcept override {
+		return "serialized array isn't aligned for a view, copy it out instead";
 	}
 };
 
+//caller memory to serialize into
+struct OutputSpan {
+	char* data;
+	size_t size;
+};
+
+//elements of a serialized array, pointing into the input
+template<class T>
+struct ArrayView {
+	T const* ptr;
+	size_t len;
+
+	T const* begin() const { return ptr; }
+	T const* end() const { return ptr+len; }
+	size_t size() const { return len; }
+	T const& operator[](size_t i) const { return ptr[i]; }
+};
+
+//scalars (arithmetic and enums) go out as they are, so they are what arrays can be copied in bulk
+template<class T>
+static constexpr bool SERIALIZE_SCALAR = std::is_arithmetic_v<T> || std::is_enum_v<T>;
+
+template<class T>
+T swap_le(T x) {
+	if constexpr (SERIALIZE_LITTLE_ENDIAN || sizeof(T)==1) {
+		return x;
+	} else {
+		unsigned char bytes[sizeof(T)];
+		std::memcpy(bytes, &x, sizeof(T));
+		std::reverse(bytes, bytes+sizeof(T));
+		std::memcpy(&x, bytes, sizeof(T));
+		return x;
+	}
+}
+
+template<class>
+static constexpr bool SERIALIZE_UNSUPPORTED = false;
+
+template<class T>
+struct IsVector: std::false_type {};
+
+template<class T, class Allocator>
+struct IsVector<std::vector<T, Allocator>>: std::true_type {};
+
+template<class T>
+struct IsOptional: std::false_type {};
+
+template<class T>
+struct IsOptional<std::optional<T>>: std::true_type {};
+
+template<class T>
+struct IsVariant: std::false_type {};
+
+template<class... Ts>
+struct IsVariant<std::variant<Ts...>>: std::true_type {};
+
+template<class T>
+struct IsPair: std::false_type {};
+
+template<class A, class B>
+struct IsPair<std::pair<A, B>>: std::true_type {};
+
+template<class T>
+struct IsMap: std::false_type {};
+
+template<class K, class V, bool multiple, template<class> class Allocator, class Hash, bool store_hash>
+struct IsMap<Map<K, V, multiple, Allocator, Hash, store_hash>>: std::true_type {};
+
+//the fields a struct serializes as, in order: a static constexpr tuple of member pointers named fields. specialize
+//it with SERIALIZE_FIELDS, or by hand for templates. reading default constructs the struct and assigns each field
+template<class T>
+struct SerializeFields {};
+
+#define SERIALIZE_FIELDS(T, ...) \
+	template<> \
+	struct SerializeFields<T> { \
+		static constexpr auto fields = std::make_tuple(__VA_ARGS__); \
+	}
+
+template<class T, class=void>
+static constexpr bool HAS_SERIALIZE_FIELDS = false;
+
+template<class T>
+static constexpr bool HAS_SERIALIZE_FIELDS<T, std::void_t<decltype(SerializeFields<T>::fields)>> = true;
+
+//writes into a std::vector<char>& (appending, grown geometrically), an OutputSpan (throws SerializeOverflow when
+//full) or a std::ostream& (through a 64KB buffer). finish() trims the vector or flushes the stream, which the
+//destructor also does
 template<class Output=std::ostream&>
 class Serialize {
+ private:
+	static constexpr bool TO_VECTOR = std::is_same_v<Output, std::vector<char>&>;
+	static constexpr bool TO_SPAN = std::is_same_v<Output, OutputSpan>;
+	static constexpr bool TO_STREAM = !TO_VECTOR && !TO_SPAN;
+	static constexpr size_t STREAM_BUFFER = 64*1024;
+
 	Output out;
+	//bytes go into [cur, end), buf is where the output (or the stream buffer) starts
+	char* buf, *cur, *end;
+	//bytes already flushed to the stream
+	uint64_t flushed=0;
+	std::vector<char> stream_buf;
+
+	void flush() {
+		if constexpr (TO_STREAM) {
+			out.write(buf, cur-buf);
+			flushed += cur-buf;
+			cur = buf;
+		}
+	}
+
+	void make_room(size_t n) {
+		if constexpr (TO_VECTOR) {
+			size_t used = cur-buf;
+			out.resize(std::max(used+n, out.size()*2));
+			buf = out.data();
+			cur = buf+used;
+			end = buf+out.size();
+		} else if constexpr (TO_SPAN) {
+			throw SerializeOverflow();
+		} else {
+			flush();
+			if (n>stream_buf.size()) {
+				stream_buf.resize(n);
+				buf = cur = stream_buf.data();
+				end = buf+n;
+			}
+		}
+	}
+
+	char* room(size_t n) {
+		if (static_cast<size_t>(end-cur)<n) make_room(n);
+		char* ret = cur;
+		cur += n;
+		return ret;
+	}
+
+	void pad(size_t align) {
+		size_t n = (align-size()%align)%align;
+		std::memset(room(n), 0, n);
+	}
+
  public:
+	explicit Serialize(Output out): out(out) {
+		if constexpr (TO_VECTOR) {
+			buf = out.data();
+			cur = buf+out.size();
+			end = cur;
+		} else if constexpr (TO_SPAN) {
+			buf = cur = out.data;
+			end = buf+out.size;
+		} else {
+			stream_buf.resize(STREAM_BUFFER);
+			buf = cur = stream_buf.data();
+			end = buf+STREAM_BUFFER;
+		}
+	}
+
+	Serialize(Serialize const&) = delete;
+	Serialize& operator=(Serialize const&) = delete;
+
+	~Serialize() {
+		finish();
+	}
+
+	//bytes written so far. for a vector this includes what was in it before
+	uint64_t size() const {
+		return flushed+(cur-buf);
+	}
+
+	void finish() {
+		if constexpr (TO_VECTOR) {
+			out.resize(cur-buf);
+			buf = out.data();
+			cur = end = buf+out.size();
+		} else if constexpr (TO_STREAM) {
+			flush();
+		}
+	}
+
+	void write_bytes(void const* p, size_t n) {
+		if constexpr (TO_STREAM) {
+			//big writes skip the buffer
+			if (n>=STREAM_BUFFER) {
+				flush();
+				out.write(static_cast<char const*>(p), n);
+				flushed += n;
+				return;
+			}
+		}
+
+		std::memcpy(room(n), p, n);
+	}
+
+	void write_size(uint64_t n) {
+		if (static_cast<size_t>(end-cur)>=8) {
+			cur += VarIntRef::encode_wide(cur, n);
+		} else {
+			//near the end of a span, which only needs room for the bytes it takes
+			char tmp[8];
+			write_bytes(tmp, VarIntRef::encode_wide(tmp, n));
+		}
+	}
+
 	template<class T>
 	void write(T const& x) {
-		throw UnserializableType();
+		if constexpr (SERIALIZE_SCALAR<T>) {
+			T le = swap_le(x);
+			std::memcpy(room(sizeof(T)), &le, sizeof(T));
+		} else if constexpr (std::is_convertible_v<T const&, std::string_view>) {
+			std::string_view s = x;
+			write_size(s.size());
+			write_bytes(s.data(), s.size());
+		} else if constexpr (IsVector<T>::value) {
+			write_vector(x);
+		} else if constexpr (IsOptional<T>::value) {
+			write(uint8_t(x.has_value()));
+			if (x) write(*x);
+		} else if constexpr (IsVariant<T>::value) {
+			write_size(x.index());
+			std::visit([this](auto const& alt) { write(alt); }, x);
+		} else if constexpr (IsPair<T>::value) {
+			write(x.first);
+			write(x.second);
+		} else if constexpr (IsMap<T>::value) {
+			write_size(x.count);
+			for (auto const& kv: x) {
+				write(kv.first);
+				write(kv.second);
+			}
+		} else if constexpr (HAS_SERIALIZE_FIELDS<T>) {
+			std::apply([this, &x](auto... field) { (write(x.*field), ...); }, SerializeFields<T>::fields);
+		} else {
+			static_assert(SERIALIZE_UNSUPPORTED<T>, "no serialization for this type");
+		}
+	}
+
+	//one memcpy on little endian hosts
+	template<class T>
+	void write_array(T const* p, size_t n) {
+		static_assert(SERIALIZE_SCALAR<T>, "bulk arrays are of scalars");
+		write_size(n);
+		pad(alignof(T));
+
+		if constexpr (SERIALIZE_LITTLE_ENDIAN || sizeof(T)==1) {
+			write_bytes(p, n*sizeof(T));
+		} else {
+			for (size_t i=0; i<n; i++) write(p[i]);
+		}
 	}
 
-	template<>
-	void write<int>(int const& x) {
-		int net = htonl(x);
-		out.write(reinterpret_cast<char*>(&net), sizeof(int));
+	template<class T>
+	void write_vector(std::vector<T> const& vec) {
+		if constexpr (SERIALIZE_SCALAR<T>) {
+			write_array(vec.data(), vec.size());
+		} else {
+			write_size(vec.size());
+			for (T const& t: vec) write(t);
+		}
 	}
 
-	template<>
-	void write<long>(long const& x) {
-		long net = htonll(x);
-		out.write(reinterpret_cast<char*>(&net), sizeof(long));
+	//f(serialize, element) writes each element
+	template<class T, class F>
+	void write_vector(std::vector<T> const& vec, F f) {
+		write_size(vec.size());
+		for (T const& t: vec) f(*this, t);
 	}
+};
+
+//a file mapped read only, to deserialize through view(). advised for one sequential pass, so the kernel reads further
+//ahead and can drop pages once they're behind
+class MappedFile {
+ private:
+	char* data=nullptr;
+	size_t size=0;
+
+ public:
+	explicit MappedFile(char const* path) {
+		int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+		if (fd<0) throw SerializeIOError(errno);
+
+		struct stat st;
+		if (fstat(fd, &st)<0) {
+			int err = errno;
+			::close(fd);
+			throw SerializeIOError(err);
+		}
+
+		size = st.st_size;
+		//mapping nothing fails
+		if (size>0) {
+			void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+			int err = errno;
+			::close(fd);
+			if (p==MAP_FAILED) throw SerializeIOError(err);
+
+			data = static_cast<char*>(p);
+			madvise(data, size, MADV_SEQUENTIAL);
+		} else {
+			::close(fd);
+		}
+	}
+
+	MappedFile(MappedFile const&) = delete;
+	MappedFile& operator=(MappedFile const&) = delete;
 
-	template<>
-	void write<short>(short const& x) {
-		short net = htons(x);
-		out.write(reinterpret_cast<char*>(&net), sizeof(short));
+	~MappedFile() {
+		if (data) munmap(data, size);
 	}
 
-	template<>
-	void write<unsigned>(unsigned const& x) {
-		unsigned net = htonl(x);
-		out.write(reinterpret_cast<char*>(&net), sizeof(unsigned));
+	std::string_view view() const {
+		return std::string_view(data, size);
 	}
+};
+
+//reads an fd (eg. a pipe or a socket) on a background thread into one of two chunks while the other is parsed.
+//a chunk is handed over once it's full or nothing more is available yet, so records are parsed as they arrive
+class ReadAhead {
+ public:
+	//bytes before each chunk where next() puts what the caller had left of the previous one
+	static constexpr size_t HEADROOM = 64;
+
+ private:
+	int fd;
+	size_t chunk;
+	std::vector<char> bufs[2];
+	//written to wake the thread up from poll when stopping
+	int wake[2];
+
+	std::mutex mut;
+	std::condition_variable cv;
+	//the chunk the thread should fill, the one it filled and the one the caller has, or -1
+	int to_fill=0, filled=-1, held=-1;
+	size_t filled_size=0;
+	bool done=false, stop=false;
+	int err=0;
+	std::thread thread;
+
+	void run() {
+		std::unique_lock lock(mut);
+		while (true) {
+			cv.wait(lock, [this]() { return to_fill>=0 || stop; });
+			if (stop) return;
+
+			int i = to_fill;
+			to_fill = -1;
+			lock.unlock();
+
+			char* p = bufs[i].data()+HEADROOM;
+			size_t got=0;
+			int e=0;
+			bool eof=false;
+
+			while (got<chunk) {
+				//only blocks with nothing to hand over
+				pollfd fds[2] = {{.fd=fd, .events=POLLIN, .revents=0}, {.fd=wake[0], .events=POLLIN, .revents=0}};
+				int ready = poll(fds, 2, got>0 ? 0 : -1);
+				if (ready<0) {
+					if (errno==EINTR) continue;
+					e = errno;
+					break;
+				}
+
+				if (fds[1].revents) return;
+				if (ready==0) break;
+
+				ssize_t r = ::read(fd, p+got, chunk-got);
+				if (r<0) {
+					if (errno==EINTR || errno==EAGAIN) continue;
+					e = errno;
+					break;
+				} else if (r==0) {
+					eof=true;
+					break;
+				}
 
-	template<>
-	void write<unsigned long>(unsigned long const& x) {
-		unsigned long net = htonll(x);
-		out.write(reinterpret_cast<char*>(&net), sizeof(unsigned long));
+				got += r;
+			}
+
+			lock.lock();
+			//what came before an error is still handed over, next() throws the call after
+			if (got>0 || !e) {
+				filled = i;
+				filled_size = got;
+			}
+
+			err = e;
+			done = eof || e;
+			cv.notify_all();
+			if (done) return;
+		}
 	}
 
-	template<>
-	void write<char*>(char* const& x) {
-		out.write(x, strlen(x)+1);
+ public:
+	ReadAhead(int fd, size_t chunk): fd(fd), chunk(chunk) {
+		for (std::vector<char>& b: bufs) b.resize(HEADROOM+chunk);
+		if (pipe(wake)<0) throw SerializeIOError(errno);
+		thread = std::thread([this]() { run(); });
 	}
 
-	template<>
-	void write<std::string>(std::string const& x) {
-		out.write(x.data(), x.length());
-		out.write("\0", 1);
+	ReadAhead(ReadAhead const&) = delete;
+	ReadAhead& operator=(ReadAhead const&) = delete;
+
+	~ReadAhead() {
+		{
+			std::lock_guard lock(mut);
+			stop=true;
+		}
+
+		cv.notify_all();
+		char c=0;
+		while (::write(wake[1], &c, 1)<0 && errno==EINTR);
+		thread.join();
+		::close(wake[0]);
+		::close(wake[1]);
 	}
 
-	template<class T>
-	void write_vector(std::vector<T> vec, std::function<void(Serialize<Output>&, T&)> f) {
-		write<unsigned long>(vec.size());
-		for (T& t: vec) {
-			f(*this, t);
+	//waits for the next chunk and returns its data and size, 0 at the end of the input. the left bytes at rest, at
+	//most HEADROOM, are copied right before the data, since the chunk they were in goes back to the thread to refill
+	std::pair<char*, size_t> next(char const* rest, size_t left) {
+		assert(left<=HEADROOM);
+
+		std::unique_lock lock(mut);
+		cv.wait(lock, [this]() { return filled>=0 || done; });
+		if (filled<0 && err) throw SerializeIOError(err);
+
+		//nothing more, rest is in the last chunk
+		if (filled<0) {
+			char* data = bufs[held].data()+HEADROOM;
+			if (left) std::memmove(data-left, rest, left);
+			return {data, 0};
 		}
+
+		int i = filled;
+		size_t size = filled_size;
+		filled = -1;
+		held = i;
+
+		char* data = bufs[i].data()+HEADROOM;
+		if (left) std::memcpy(data-left, rest, left);
+
+		if (!done) {
+			to_fill = 1-i;
+			cv.notify_all();
+		}
+
+		return {data, size};
 	}
+};
 
-	explicit Serialize(Output out): out(out) {}
+//a file descriptor to deserialize from through a ReadAhead, in reads of up to chunk bytes
+struct FdInput {
+	int fd;
+	size_t chunk = 1<<20;
 };
 
+template<class T, class Input>
+class RecordReader;
+
+//reads from a std::string_view (contiguous, strings and arrays can be read as views into it, eg. a MappedFile's),
+//a std::istream& (through a 64KB buffer) or an FdInput (through a ReadAhead). throws DeserializeEnd when the input
+//runs out
 template<class Input=std::istream&>
 class Deserialize {
  private:
+	static constexpr bool FROM_VIEW = std::is_same_v<Input, std::string_view>;
+	static constexpr bool FROM_FD = std::is_same_v<Input, FdInput>;
+	static constexpr size_t STREAM_BUFFER = 64*1024;
+
 	Input in;
+	char const* buf, *cur, *end;
+	//bytes before buf
+	uint64_t consumed=0;
+	std::vector<char> stream_buf;
+	std::unique_ptr<ReadAhead> ahead;
+
+	//reads more of the stream behind what's left, at least n bytes in total
+	void fill(size_t n) {
+		if constexpr (FROM_VIEW) {
+			throw DeserializeEnd();
+		} else if constexpr (FROM_FD) {
+			//what's left moves in front of the next chunk. only take() fills, with at most 8 bytes
+			consumed += cur-buf;
+			while (true) {
+				size_t left = end-cur;
+				auto [data, size] = ahead->next(cur, left);
+				buf = cur = data-left;
+				end = data+size;
+
+				if (static_cast<size_t>(end-cur)>=n) return;
+				if (size==0) throw DeserializeEnd();
+			}
+		} else {
+			//buf is stream_buf's data, which resizing moves
+			size_t at = cur-buf, left = end-cur;
+			consumed += at;
+			if (n>stream_buf.size()) stream_buf.resize(n);
+
+			std::memmove(stream_buf.data(), stream_buf.data()+at, left);
+			buf = cur = stream_buf.data();
+
+			in.read(stream_buf.data()+left, stream_buf.size()-left);
+			end = buf+left+in.gcount();
+			if (static_cast<size_t>(end-cur)<n) throw DeserializeEnd();
+		}
+	}
+
+	char const* take(size_t n) {
+		if (static_cast<size_t>(end-cur)<n) fill(n);
+		char const* ret = cur;
+		cur += n;
+		return ret;
+	}
+
+	void skip_pad(size_t align) {
+		take((align-position()%align)%align);
+	}
+
  public:
-	template<class T, class ReadInput=Input>
-	T read() {
-		throw UnserializableType();
+	explicit Deserialize(Input in): in(in) {
+		if constexpr (FROM_VIEW) {
+			buf = cur = in.data();
+			end = buf+in.size();
+		} else if constexpr (FROM_FD) {
+			ahead = std::make_unique<ReadAhead>(in.fd, in.chunk);
+			buf = cur = end = nullptr;
+		} else {
+			stream_buf.resize(STREAM_BUFFER);
+			buf = cur = end = stream_buf.data();
+		}
 	}
 
-	template<>
-	int read<int>() {
-		int net;
-		in.read(reinterpret_cast<char*>(&net), sizeof(int));
-		return ntohl(net);
+	Deserialize(Deserialize const&) = delete;
+	Deserialize& operator=(Deserialize const&) = delete;
+
+	uint64_t position() const {
+		return consumed+(cur-buf);
 	}
 
-	template<>
-	long read<long>() {
-		long net;
-		in.read(reinterpret_cast<char*>(&net), sizeof(long));
-		return ntohll(net);
+	bool at_end() {
+		if constexpr (FROM_VIEW) {
+			return cur==end;
+		} else {
+			if (cur!=end) return false;
+
+			try {
+				fill(1);
+				return false;
+			} catch (DeserializeEnd const&) {
+				return true;
+			}
+		}
 	}
 
-	template<>
-	short read<short>() {
-		short net;
-		in.read(reinterpret_cast<char*>(&net), sizeof(short));
-		return ntohs(net);
+	void read_bytes(void* p, size_t n) {
+		if constexpr (FROM_FD) {
+			//chunk by chunk
+			char* to = static_cast<char*>(p);
+			while (n>static_cast<size_t>(end-cur)) {
+				size_t left = end-cur;
+				if (left) std::memcpy(to, cur, left);
+				to += left;
+				n -= left;
+				cur = end;
+				fill(1);
+			}
+
+			std::memcpy(to, take(n), n);
+			return;
+		} else if constexpr (!FROM_VIEW) {
+			//big reads skip the buffer
+			size_t left = end-cur;
+			if (n>=STREAM_BUFFER && n>left) {
+				std::memcpy(p, cur, left);
+				consumed += cur-buf+left;
+				buf = cur = end = stream_buf.data();
+
+				in.read(static_cast<char*>(p)+left, n-left);
+				if (static_cast<size_t>(in.gcount())!=n-left) throw DeserializeEnd();
+				consumed += n-left;
+				return;
+			}
+		}
+
+		std::memcpy(p, take(n), n);
+	}
+
+	uint64_t read_size() {
+		if (end-cur>=8) {
+			uint64_t x;
+			cur += VarIntRef::decode_wide(cur, x);
+			return x;
+		}
+
+		if (cur==end) fill(1);
+		size_t n = ((*cur>>5)&7)+1;
+		VarIntRef vi(take(n));
+		return vi.value();
+	}
+
+	template<class T>
+	T read() {
+		if constexpr (SERIALIZE_SCALAR<T>) {
+			T x;
+			std::memcpy(&x, take(sizeof(T)), sizeof(T));
+			return swap_le(x);
+		} else if constexpr (std::is_same_v<T, std::string_view>) {
+			static_assert(FROM_VIEW, "string views need a contiguous input");
+			size_t n = read_size();
+			return std::string_view(take(n), n);
+		} else if constexpr (std::is_same_v<T, std::string>) {
+			std::string s(read_size(), '\0');
+			read_bytes(s.data(), s.size());
+			return s;
+		} else if constexpr (IsVector<T>::value) {
+			return read_vector<typename T::value_type>();
+		} else if constexpr (IsOptional<T>::value) {
+			if (!read<uint8_t>()) return std::nullopt;
+			return read<typename T::value_type>();
+		} else if constexpr (IsVariant<T>::value) {
+			return read_variant<T>(read_size(), std::make_index_sequence<std::variant_size_v<T>>());
+		} else if constexpr (IsPair<T>::value) {
+			//braces read in order, unlike arguments
+			return T {read<typename T::first_type>(), read<typename T::second_type>()};
+		} else if constexpr (IsMap<T>::value) {
+			T map;
+			size_t n = read_size();
+			map.reserve(n);
+			for (size_t i=0; i<n; i++) {
+				auto k = read<std::remove_const_t<typename T::Bucket::first_type>>();
+				map.insert(std::move(k), read<typename T::Bucket::second_type>());
+			}
+
+			return map;
+		} else if constexpr (HAS_SERIALIZE_FIELDS<T>) {
+			T x {};
+			read_to(x);
+			return x;
+		} else {
+			static_assert(SERIALIZE_UNSUPPORTED<T>, "no deserialization for this type");
+		}
+	}
+
+	//reads into x, reusing what it holds: strings' and vectors' buffers and struct fields in place. vectors of
+	//non-scalars need default constructible elements
+	template<class T>
+	void read_to(T& x) {
+		if constexpr (std::is_same_v<T, std::string>) {
+			x.resize(read_size());
+			read_bytes(x.data(), x.size());
+		} else if constexpr (IsVector<T>::value) {
+			using E = typename T::value_type;
+			x.resize(read_size());
+
+			if constexpr (SERIALIZE_SCALAR<E>) {
+				skip_pad(alignof(E));
+				read_bytes(x.data(), x.size()*sizeof(E));
+				if constexpr (!SERIALIZE_LITTLE_ENDIAN) for (E& e: x) e = swap_le(e);
+			} else {
+				for (E& e: x) read_to(e);
+			}
+		} else if constexpr (HAS_SERIALIZE_FIELDS<T>) {
+			std::apply([this, &x](auto... field) { (read_to(x.*field), ...); }, SerializeFields<T>::fields);
+		} else {
+			x = read<T>();
+		}
+	}
+
+	template<class T>
+	std::vector<T> read_vector() {
+		size_t n = read_size();
+
+		if constexpr (SERIALIZE_SCALAR<T>) {
+			std::vector<T> vec(n);
+			skip_pad(alignof(T));
+			read_bytes(vec.data(), vec.size()*sizeof(T));
+			if constexpr (!SERIALIZE_LITTLE_ENDIAN) for (T& x: vec) x = swap_le(x);
+			return vec;
+		} else {
+			//moved in as they are read, not default constructed and assigned over
+			std::vector<T> vec;
+			vec.reserve(n);
+			for (size_t i=0; i<n; i++) vec.push_back(read<T>());
+			return vec;
+		}
 	}
 
-	template<>
-	unsigned read<unsigned>() {
-		unsigned net;
-		in.read(reinterpret_cast<char*>(&net), sizeof(unsigned));
-		return ntohl(net);
+	//tries each alternative's index in turn, so the reads inline instead of going through a table
+	template<class T, size_t... I>
+	T read_variant(size_t index, std::index_sequence<I...>) {
+		std::optional<T> x;
+		((index==I && (x.emplace(std::in_place_index<I>, read<std::variant_alternative_t<I, T>>()), true)) || ...);
+		if (!x) throw DeserializeInvalid();
+		return std::move(*x);
 	}
 
-	template<>
-	unsigned long read<unsigned long>() {
-		unsigned long net;
-		in.read(reinterpret_cast<char*>(&net), sizeof(unsigned long));
-		return ntohll(net);
+	//f(deserialize) reads each element
+	template<class T, class F>
+	std::vector<T> read_vector(F f) {
+		size_t n = read_size();
+		std::vector<T> vec;
+		vec.reserve(n);
+		for (size_t i=0; i<n; i++) vec.push_back(f(*this));
+		return vec;
 	}
 
-	template<>
-	std::string read<std::string, std::ostream&>() {
-		std::ostringstream stream;
-		stream<<in.rdbuf();
-		return stream.str();
+	//the elements of a vector, each read as iteration gets to it
+	template<class T>
+	RecordReader<T, Input> read_records() {
+		uint64_t n = read_size();
+		if constexpr (SERIALIZE_SCALAR<T>) skip_pad(alignof(T));
+		return RecordReader<T, Input>(*this, n);
 	}
 
-	template<>
-	std::string read<std::string>() {
-		return in.read_string();
+	//records written one after another with write, up to the end of the input
+	template<class T>
+	RecordReader<T, Input> read_records_to_end() {
+		return RecordReader<T, Input>(*this, RecordReader<T, Input>::TO_END);
 	}
 
+	//the array where it is in the input, without copying. the input has to be aligned like the elements (as vectors
+	//and malloc'd memory are), else this throws MisalignedView. big endian hosts can only view bytes
 	template<class T>
-	std::vector<T> read_vector(std::function<T(Deserialize<Input>&)> f) {
-		unsigned long len = read<unsigned long>();
-		std::vector<T> vec(len);
-		for (unsigned long i=0; i<len; i++) {
-			vec[i] = f(*this);
+	ArrayView<T> read_view() {
+		static_assert(FROM_VIEW, "array views need a contiguous input");
+		static_assert(SERIALIZE_SCALAR<T> && (SERIALIZE_LITTLE_ENDIAN || sizeof(T)==1), "can't view these as they are");
+
+		size_t n = read_size();
+		skip_pad(alignof(T));
+		if (reinterpret_cast<uintptr_t>(cur)%alignof(T)!=0) throw MisalignedView();
+		return {.ptr=reinterpret_cast<T const*>(take(n*sizeof(T))), .len=n};
+	}
+};
+
+//pulls records one at a time, so they can be processed while the rest of the input is still arriving. either with
+//next(), which returns nothing past the last one, or as a range. a record is only valid until the next is read
+template<class T, class Input>
+class RecordReader {
+ public:
+	static constexpr uint64_t TO_END = UINT64_MAX;
+
+ private:
+	Deserialize<Input>& d;
+	//records still to read, or TO_END
+	uint64_t left;
+	std::optional<T> rec;
+
+ public:
+	RecordReader(Deserialize<Input>& d, uint64_t left): d(d), left(left) {}
+
+	T* next() {
+		if (left==TO_END ? d.at_end() : left==0) {
+			rec.reset();
+			return nullptr;
 		}
+
+		if (left!=TO_END) left--;
+		//reusing the previous record's buffers
+		if constexpr (std::is_default_constructible_v<T>) {
+			if (rec) {
+				d.read_to(*rec);
+				return &*rec;
+			}
+		}
+
+		rec = d.template read<T>();
+		return &*rec;
 	}
 
-	explicit Deserialize(Input in): in(in) {}
+	struct Iterator {
+		RecordReader* r;
+
+		T& operator*() const { return *r->rec; }
+		T* operator->() const { return &*r->rec; }
+
+		Iterator& operator++() {
+			if (!r->next()) r=nullptr;
+			return *this;
+		}
+
+		bool operator==(Iterator const& other) const { return r==other.r; }
+		bool operator!=(Iterator const& other) const { return r!=other.r; }
+	};
+
+	//reads the first record, so only iterate once
+	Iterator begin() {
+		return {.r=next() ? this : nullptr};
+	}
+
+	Iterator end() {
+		return {.r=nullptr};
+	}
 };
 
 #endif //CORECOMMON_SRC_SERIALIZE_HPP_
@@ -1,386 +1,331 @@
 #ifndef CORECOMMON_SRC_SMALLVECTOR_HPP_
 #define CORECOMMON_SRC_SMALLVECTOR_HPP_
 
-#include <vector>
-#include <array>
-
-template<class T, size_t MinCapacity>
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+//vector that keeps up to MinCapacity elements inline, then moves all of them to one heap buffer which grows by
+//doubling. elements are always contiguous, so iterators are plain pointers.
+//Allocator backs the heap buffer, eg. an ArenaAllocator so a request's vectors go away with its arena
+template<class T, size_t MinCapacity, class Allocator = std::allocator<T>>
 class SmallVector {
  private:
-	template<class TPtr, class TRef, class SmallVecRef>
-	class IteratorTemplate {
-	 private:
-		IteratorTemplate(TPtr p, SmallVecRef r): ptr(p), ref(r) {}
-		friend SmallVector;
-
-	 public:
-		using iterator_category = std::random_access_iterator_tag;
+	using AllocTraits = std::allocator_traits<Allocator>;
+
+	//yields the same element forever, for inserting count copies through the range path
+	struct Repeat {
+		using iterator_category = std::input_iterator_tag;
 		using difference_type = std::ptrdiff_t;
 		using value_type = T;
-		using pointer = TPtr;
-		using reference = TRef;
+		using pointer = T const*;
+		using reference = T const&;
 
-		TPtr ptr;
-		SmallVecRef ref;
+		T const* x;
 
-		template<class OtherTPtr, class OtherTRef, class OtherSmallVecRef>
-		IteratorTemplate(IteratorTemplate<OtherTPtr, OtherTRef, OtherSmallVecRef> const& from): ptr(from.ptr), ref(from.ref) {}
-
-		IteratorTemplate& operator=(IteratorTemplate const& other) {
-			ptr=other.ptr;
-			return *this;
-		}
+		T const& operator*() const { return *x; }
+		Repeat& operator++() { return *this; }
+		Repeat operator++(int) { return *this; }
+	};
 
-		IteratorTemplate& operator++() {
-			ptr++;
-			if (ptr==ref.arr.end()) ptr = ref.data;
-			return *this;
-		}
+	T* inline_data() {
+		return reinterpret_cast<T*>(small);
+	}
 
-		IteratorTemplate& operator--() {
-			if (ptr==ref.data) ptr = ref.arr.end()-1;
-			else ptr--;
-			return *this;
-		}
+	bool is_inline() const {
+		return ptr==reinterpret_cast<T const*>(small);
+	}
 
-		IteratorTemplate operator++(int) {
-			if (ptr==ref.arr.end()-1) {
-				ptr = ref.data;
-				return IteratorTemplate(ref.arr.end()-1, ref);
-			} else {
-				return IteratorTemplate(ptr++, ref);
-			}
+	//moves [first, last) to uninitialized dst if that can't throw (or T can't be copied), copies otherwise
+	static void relocate(T* first, T* last, T* dst) {
+		if constexpr (std::is_nothrow_move_constructible_v<T> || !std::is_copy_constructible_v<T>) {
+			std::uninitialized_move(first, last, dst);
+		} else {
+			std::uninitialized_copy(first, last, dst);
 		}
+	}
 
-		IteratorTemplate operator--(int) {
-			if (ptr==ref.data) {
-				ptr = ref.arr.end()-1;
-				return IteratorTemplate(ref.data, ref);
-			} else {
-				return IteratorTemplate(ptr--, ref);
-			}
-		}
+	void free_heap() {
+		if (!is_inline()) AllocTraits::deallocate(alloc, ptr, cap);
+	}
 
-		bool in_small_buf() const {
-			return ptr>=ref.arr.begin() && ptr<ref.arr.end();
-		}
+	//doubles, or more if n needs it
+	size_t grown(size_t n) const {
+		return std::max(n, cap*2);
+	}
 
-		IteratorTemplate& operator+=(std::ptrdiff_t d) {
-			if (in_small_buf() && (ref.arr.end()-ptr<=d)) ptr = ref.data+(d-(ref.arr.end()-ptr));
-			else ptr+=d;
-			return *this;
+	//moves other's elements here, stealing its buffer if it has one. other is left empty and inline
+	void take(SmallVector& other) {
+		if (other.is_inline()) {
+			ptr = inline_data();
+			cap = MinCapacity;
+			std::uninitialized_move(other.ptr, other.ptr+other.len, ptr);
+			std::destroy_n(other.ptr, other.len);
+		} else {
+			ptr = other.ptr;
+			cap = other.cap;
+			other.ptr = other.inline_data();
+			other.cap = MinCapacity;
 		}
 
-		IteratorTemplate operator+(std::ptrdiff_t d) const {
-			IteratorTemplate cpy = *this;
-			cpy+=d;
-			return cpy;
-		}
+		len = other.len;
+		other.len = 0;
+	}
 
-		IteratorTemplate& operator-=(std::ptrdiff_t d) {
-			if (!in_small_buf() && (ptr-ref.data<d)) ptr = (ref.arr.end()-d)+(ptr-ref.data);
-			else ptr-=d;
-			return *this;
-		}
+	//inserts count elements from first at off. first mustn't point into this vector
+	template<class It>
+	T* insert_n(size_t off, It first, size_t count) {
+		if (count==0) return ptr+off;
 
-		IteratorTemplate operator-(std::ptrdiff_t d) const {
-			IteratorTemplate cpy = *this;
-			cpy-=d;
-			return cpy;
-		}
+		if (len+count>cap) {
+			size_t n = grown(len+count);
+			T* p = AllocTraits::allocate(alloc, n);
 
-		std::ptrdiff_t operator-(IteratorTemplate const& other) {
-			if (in_small_buf()) {
-				return other.in_small_buf() ? ptr-other.ptr : -static_cast<std::ptrdiff_t>((ref.arr.end()-ptr)+(other.ptr-ref.data));
-			} else {
-				return other.in_small_buf() ? (ptr-ref.data)+(ref.arr.end()-other.ptr) : ptr-other.ptr;
+			try {
+				std::uninitialized_copy_n(first, count, p+off);
+			} catch (...) {
+				AllocTraits::deallocate(alloc, p, n);
+				throw;
 			}
-		}
-
-		bool operator==(IteratorTemplate const& other) const {
-			return ptr==other.ptr;
-		}
-
-		bool operator!=(IteratorTemplate const& other) const {
-			return ptr!=other.ptr;
-		}
-
-		bool operator>=(IteratorTemplate const& other) const {
-			bool a=in_small_buf(), b=other.in_small_buf();
-			if (a==b) return ptr>=other.ptr;
-			else return b;
-		}
-
-		bool operator>(IteratorTemplate const& other) const {
-			bool a=in_small_buf(), b=other.in_small_buf();
-			if (a==b) return ptr>other.ptr;
-			else return b;
-		}
 
-		bool operator<=(IteratorTemplate const& other) const {
-			return !(*this>other);
-		}
+			try {
+				relocate(ptr, ptr+off, p);
+			} catch (...) {
+				std::destroy_n(p+off, count);
+				AllocTraits::deallocate(alloc, p, n);
+				throw;
+			}
 
-		bool operator<(IteratorTemplate const& other) const {
-			return !(*this>=other);
-		}
+			try {
+				relocate(ptr+off, ptr+len, p+off+count);
+			} catch (...) {
+				std::destroy_n(p, off+count);
+				AllocTraits::deallocate(alloc, p, n);
+				throw;
+			}
 
-		TRef operator*() {
-			return *ptr;
+			std::destroy_n(ptr, len);
+			free_heap();
+			ptr = p;
+			cap = n;
+		} else {
+			T* pos = ptr+off, *old_end = ptr+len;
+			size_t tail = len-off;
+
+			//the last count elements move into uninitialized space, the rest shift over live ones
+			if (count<=tail) {
+				std::uninitialized_move(old_end-count, old_end, old_end);
+				std::move_backward(pos, pos+(tail-count), old_end);
+				std::copy_n(first, count, pos);
+			} else {
+				It mid = first;
+				std::advance(mid, tail);
+				std::uninitialized_copy_n(mid, count-tail, old_end);
+				std::uninitialized_move(pos, old_end, pos+count);
+				std::copy_n(first, tail, pos);
+			}
 		}
 
-		TRef operator->() {
-			return *ptr;
-		}
-	};
+		len += count;
+		return ptr+off;
+	}
 
  public:
-	std::array<T, MinCapacity> arr;
-	T* data;
+	Allocator alloc;
+	T* ptr;
 	size_t cap, len;
+	alignas(T) unsigned char small[sizeof(T)*(MinCapacity>0 ? MinCapacity : 1)];
 
-	SmallVector(std::initializer_list<T> il): len(il.size()) {
-		if (il.size()<=MinCapacity) {
-			std::move(il.begin(), il.end(), arr.begin());
-			cap=0;
-		} else {
-			cap=il.size()-MinCapacity;
-			data = new T[cap];
-			std::move(il.begin(), il.begin()+MinCapacity, arr.begin());
-			std::move(il.begin()+MinCapacity, il.end(), data);
-		}
-	}
+	using value_type = T;
+	using iterator = T*;
+	using const_iterator = T const*;
+	using reverse_iterator = std::reverse_iterator<iterator>;
+	using const_reverse_iterator = std::reverse_iterator<const_iterator>;
 
-	SmallVector(size_t n, T x): len(n) {
-		if (n<=MinCapacity) {
-			std::fill(arr.begin(), arr.begin()+n, x);
-			cap=0;
-		} else {
-			cap=n-MinCapacity;
-			data = new T[cap];
-			std::fill(arr.begin(), arr.end(), x);
-			std::fill(data, data+cap, x);
-		}
-	}
+	explicit SmallVector(Allocator const& alloc = Allocator()): alloc(alloc), ptr(inline_data()), cap(MinCapacity), len(0) {}
 
-	void reserve(size_t n) {
-		if (n<=cap+MinCapacity) return;
-		n-=MinCapacity;
-		T* new_data = new T[n];
-		std::copy(data, data+cap, new_data);
-
-		if (cap>0) delete data;
-		data = new_data;
-		cap=n;
+	//reserves n, empty
+	SmallVector(size_t n, Allocator const& alloc): SmallVector(alloc) {
+		reserve(n);
 	}
 
-	SmallVector(size_t n): len(0), cap(0) {
+	SmallVector(size_t n, T const& x, Allocator const& alloc = Allocator()): SmallVector(alloc) {
 		reserve(n);
+		std::uninitialized_fill_n(ptr, n, x);
+		len = n;
 	}
 
-	SmallVector(SmallVector const& other): SmallVector(other.len) {
-		len=other.len;
-		std::copy(other.begin(), other.end(), begin());
+	SmallVector(std::initializer_list<T> il, Allocator const& alloc = Allocator()): SmallVector(alloc) {
+		reserve(il.size());
+		std::uninitialized_copy(il.begin(), il.end(), ptr);
+		len = il.size();
 	}
 
-	using iterator = IteratorTemplate<T*, T&, SmallVector&>;
-	using const_iterator = IteratorTemplate<T const*, T const&, SmallVector const&>;
-
-	using reverse_iterator = std::reverse_iterator<iterator>;
-	using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+	SmallVector(SmallVector const& other): SmallVector(AllocTraits::select_on_container_copy_construction(other.alloc)) {
+		reserve(other.len);
+		std::uninitialized_copy(other.begin(), other.end(), ptr);
+		len = other.len;
+	}
 
- private:
-	iterator deconst(const_iterator x) {
-		return iterator(const_cast<T*>(x.ptr), *this);
+	SmallVector(SmallVector&& other) noexcept(std::is_nothrow_move_constructible_v<T>): alloc(std::move(other.alloc)), ptr(inline_data()) {
+		take(other);
 	}
 
-	iterator make_space(const_iterator where, size_t count) {
-		len+=count;
+	SmallVector& operator=(SmallVector const& other) {
+		if (this!=&other) *this = SmallVector(other);
+		return *this;
+	}
 
-		if (where.in_small_buf()) {
-			reserve(len);
-			iterator cpy = deconst(where);
-			std::move_backward(cpy, end()-count, end());
+	SmallVector& operator=(SmallVector&& other) noexcept(std::is_nothrow_move_constructible_v<T>) {
+		if (this==&other) return *this;
 
-			return cpy;
-		} else {
-			size_t off = where.ptr-data;
-			reserve(len);
-			if (off>=len-count-MinCapacity) return iterator(data+off, *this);
-			std::move(data+off, data+off+count, data+off+count);
-			return iterator(data+off, *this);
-		}
+		clear();
+		free_heap();
+		alloc = std::move(other.alloc);
+		take(other);
+		return *this;
 	}
 
- public:
-	iterator begin() {
-		return iterator(arr.begin(), *this);
+	SmallVector& swap(SmallVector& other) {
+		SmallVector tmp(std::move(other));
+		other = std::move(*this);
+		*this = std::move(tmp);
+		return *this;
 	}
 
-	iterator end() {
-		return iterator(len>=MinCapacity ? data+len-MinCapacity : arr.begin()+len, *this);
+	~SmallVector() {
+		std::destroy_n(ptr, len);
+		free_heap();
 	}
 
-	const_iterator begin() const {
-		return const_iterator(arr.begin(), *this);
-	}
+	void reserve(size_t n) {
+		if (n<=cap) return;
+
+		T* p = AllocTraits::allocate(alloc, n);
+		try {
+			relocate(ptr, ptr+len, p);
+		} catch (...) {
+			AllocTraits::deallocate(alloc, p, n);
+			throw;
+		}
 
-	const_iterator end() const {
-		return const_iterator(len>=MinCapacity ? data+len-MinCapacity : arr.begin()+len, *this);
+		std::destroy_n(ptr, len);
+		free_heap();
+		ptr = p;
+		cap = n;
 	}
 
-	reverse_iterator rbegin() {
-		return std::make_reverse_iterator(end());
-	}
+	iterator begin() { return ptr; }
+	iterator end() { return ptr+len; }
+	const_iterator begin() const { return ptr; }
+	const_iterator end() const { return ptr+len; }
 
-	reverse_iterator rend() {
-		return std::make_reverse_iterator(begin());
-	}
+	reverse_iterator rbegin() { return reverse_iterator(end()); }
+	reverse_iterator rend() { return reverse_iterator(begin()); }
+	const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+	const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
 
-	const_reverse_iterator rbegin() const {
-		return std::make_reverse_iterator(end());
-	}
+	T* data() { return ptr; }
+	T const* data() const { return ptr; }
 
-	const_reverse_iterator rend() const {
-		return std::make_reverse_iterator(begin());
-	}
+	T& operator[](size_t i) { return ptr[i]; }
+	T const& operator[](size_t i) const { return ptr[i]; }
+
+	T& front() { return ptr[0]; }
+	T& back() { return ptr[len-1]; }
+	T const& front() const { return ptr[0]; }
+	T const& back() const { return ptr[len-1]; }
 
-	SmallVector(SmallVector&& other): cap(other.cap), len(other.len) {
-		data = other.data;
-		other.cap=0;
-		other.len=MinCapacity;
-		std::move(other.arr.begin(), other.arr.begin()+std::min(other.len, MinCapacity), arr.begin());
+	size_t size() const { return len; }
+	size_t capacity() const { return cap; }
+	bool empty() const { return len==0; }
+
+	void clear() {
+		std::destroy_n(ptr, len);
+		len=0;
 	}
 
-	SmallVector& swap(SmallVector& other) {
-		std::swap(data, other.data);
-		std::swap(cap, other.cap);
-		std::swap(other.len, len);
-		std::swap(other.arr, arr);
-		return *this;
+	template<class... Args>
+	T& emplace_back(Args&&... args) {
+		if (len==cap) {
+			//args may refer to an element, so construct before the buffer moves
+			T x(std::forward<Args>(args)...);
+			reserve(grown(len+1));
+			::new (static_cast<void*>(ptr+len)) T(std::move(x));
+		} else {
+			::new (static_cast<void*>(ptr+len)) T(std::forward<Args>(args)...);
+		}
+
+		return ptr[len++];
 	}
 
-	SmallVector& operator=(SmallVector other) {
-		return swap(other);
+	void push_back(T const& v) {
+		emplace_back(v);
 	}
 
-	T& operator[](size_t i) {
-		if (i>=MinCapacity) return *(data+i-MinCapacity);
-		else return *(arr.begin()+i);
+	void push_back(T&& v) {
+		emplace_back(std::move(v));
 	}
 
-	T const& operator[](size_t i) const {
-		if (i>=MinCapacity) return *(data+i-MinCapacity);
-		else return *(arr.begin()+i);
+	void pop_back() {
+		std::destroy_at(ptr+(--len));
 	}
 
-	void clear() {
-		len=0;
+	template<class... Args>
+	iterator emplace(const_iterator where, Args&&... args) {
+		T x(std::forward<Args>(args)...);
+		return insert_n(where-ptr, std::make_move_iterator(&x), 1);
 	}
 
 	iterator insert(const_iterator where, T const& what) {
-		iterator x = make_space(where, 1);
-		*x = what;
-		return x;
+		return emplace(where, what);
 	}
 
-	iterator insert(const_iterator where, size_t count, T const& what) {
-		iterator x = make_space(where, count);
-		std::fill(x, x+count, what);
-		return x;
+	iterator insert(const_iterator where, T&& what) {
+		return emplace(where, std::move(what));
 	}
 
-	template<class InputIt>
-	typename std::enable_if<!std::is_same<typename std::iterator_traits<InputIt>::value_type, void>::value, iterator>::type
-	insert(const_iterator where, InputIt start, InputIt end) {
-		iterator x = make_space(where, end-start);
-		std::copy(start, end, x);
-		return x;
+	iterator insert(const_iterator where, size_t count, T const& what) {
+		T x(what);
+		return insert_n(where-ptr, Repeat {.x=&x}, count);
 	}
 
-	iterator insert(const_iterator where, std::initializer_list<T> il) {
-		iterator x = make_space(where, il.size());
-		std::copy(il.begin(), il.end(), x);
-		return x;
+	template<class InputIt, class=typename std::iterator_traits<InputIt>::iterator_category>
+	iterator insert(const_iterator where, InputIt start, InputIt end) {
+		return insert_n(where-ptr, start, std::distance(start, end));
 	}
 
-	template<class... Args>
-	iterator emplace(const_iterator where, Args&&... args) {
-		iterator x = make_space(where, 1);
-		if (!std::is_trivially_destructible<T>::value) (*x).~T();
-		::new (x.ptr) T(std::move<Args...>(args...));
-		return x;
+	iterator insert(const_iterator where, std::initializer_list<T> il) {
+		return insert_n(where-ptr, il.begin(), il.size());
 	}
 
 	iterator erase(const_iterator start, const_iterator end) {
+		T* s = ptr+(start-ptr);
 		size_t count = end-start;
+		if (count==0) return s;
 
-		std::move(end, const_iterator(this->end()), deconst(start));
-
-		if (!std::is_trivially_destructible<T>::value) {
-			iterator cpy = deconst(start+(const_iterator(this->end())-end));
-			for (; cpy!=this->end(); cpy++) (*cpy).~T();
-		}
-
+		std::move(s+count, ptr+len, s);
+		std::destroy_n(ptr+len-count, count);
 		len -= count;
-		return deconst(start);
+		return s;
 	}
 
 	iterator erase(const_iterator x) {
 		return erase(x, x+1);
 	}
 
+	//new elements are value initialized
 	void resize(size_t n) {
 		if (n>len) {
-			reserve(n);
-			len=n; //potentially undefined, bc im too lazy to figure out how to ensure it is default-insertible
+			reserve(n>cap ? grown(n) : n);
+			std::uninitialized_value_construct(ptr+len, ptr+n);
+			len=n;
 		} else {
 			erase(begin()+n, end());
 		}
 	}
-
-	void push_back(T const& v) {
-		insert(end(), v);
-	}
-
-	template<class ...Args>
-	void emplace_back(Args... args) {
-		emplace<Args...>(end(), args...);
-	}
-
-	void pop_back() {
-		erase(end()-1, end());
-	}
-
-	size_t size() const {
-		return len;
-	}
-
-	T& front() {
-		return arr.front();
-	}
-
-	T& back() {
-		return *(end()-1);
-	}
-
-	T const& front() const {
-		return arr.front();
-	}
-
-	T const& back() const {
-		return *(end()-1);
-	}
-
-	~SmallVector() {
-		if (!std::is_trivially_destructible<T>::value) {
-			for (T& x: *this) {
-				x.~T();
-			}
-		}
-
-		if (cap>0) delete data;
-	}
 };
 
 #endif //CORECOMMON_SRC_SMALLVECTOR_HPP_
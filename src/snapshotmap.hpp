@@ -0,0 +1,175 @@
+#ifndef CORECOMMON_SRC_SNAPSHOTMAP_HPP_
+#define CORECOMMON_SRC_SNAPSHOTMAP_HPP_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "map.hpp"
+
+//read-mostly Map for tables that are read on every request and written rarely (routes, config).
+//readers look up in an immutable snapshot without locks and without writing any cache line another thread uses.
+//writers edit a private staging map under a mutex, and publish() swaps a copy of it in (rcu style).
+//old snapshots are freed once every reader that might still see them has unpinned (epoch based reclamation)
+template<class K, class V, class Hash = MapHash<K>>
+class SnapshotMap {
+ public:
+	using Snapshot = Map<K, V, false, std::allocator, Hash>;
+	using Lookup = typename Snapshot::Lookup;
+
+	static constexpr size_t CACHE_LINE=64;
+
+	struct ReaderSlotsExhausted: public std::exception {
+		char const* what() const noexcept override {
+			return "no free reader slot in snapshot map";
+		}
+	};
+
+ private:
+	//the epoch a reader pinned at, or 0 when it holds nothing. only its owning reader writes it
+	struct alignas(CACHE_LINE) ReaderSlot {
+		std::atomic<uint64_t> epoch;
+		std::atomic<bool> claimed;
+	};
+
+	struct Retired {
+		uint64_t epoch;
+		std::unique_ptr<Snapshot const> snapshot;
+	};
+
+	alignas(CACHE_LINE) std::atomic<Snapshot const*> current;
+	std::atomic<uint64_t> epoch;
+
+	std::unique_ptr<ReaderSlot[]> slots;
+	size_t num_slots;
+
+	std::mutex writer_mtx;
+	Snapshot staging;
+	std::vector<Retired> retired;
+
+	//frees snapshots retired before every pinned reader's epoch
+	void reclaim() {
+		uint64_t oldest = UINT64_MAX;
+		for (size_t i=0; i<num_slots; i++) {
+			uint64_t e = slots[i].epoch.load();
+			if (e!=0 && e<oldest) oldest=e;
+		}
+
+		auto keep = retired.begin();
+		for (Retired& r: retired) {
+			if (r.epoch>=oldest) *keep++ = std::move(r);
+		}
+
+		retired.erase(keep, retired.end());
+	}
+
+ public:
+	explicit SnapshotMap(size_t max_readers=64): current(new Snapshot()), epoch(1),
+	                                             slots(std::make_unique<ReaderSlot[]>(max_readers)), num_slots(max_readers) {
+		for (size_t i=0; i<num_slots; i++) {
+			slots[i].epoch=0;
+			slots[i].claimed=false;
+		}
+	}
+
+	SnapshotMap(SnapshotMap const&) = delete;
+
+	//a thread's handle for reading. don't share one between threads
+	class Reader {
+	 private:
+		SnapshotMap& map;
+		ReaderSlot& slot;
+
+		friend SnapshotMap;
+		Reader(SnapshotMap& map, ReaderSlot& slot): map(map), slot(slot) {}
+
+	 public:
+		//keeps one snapshot alive and unchanged until destroyed. only one guard per reader at a time
+		class Guard {
+		 private:
+			ReaderSlot& slot;
+			Snapshot const* snap;
+
+			friend Reader;
+			Guard(ReaderSlot& slot, Snapshot const* snap): slot(slot), snap(snap) {}
+
+		 public:
+			Guard(Guard const&) = delete;
+
+			Snapshot const& operator*() const { return *snap; }
+			Snapshot const* operator->() const { return snap; }
+
+			V const* operator[](Lookup k) const {
+				return (*snap)[k];
+			}
+
+			~Guard() {
+				slot.epoch.store(0, std::memory_order_release);
+			}
+		};
+
+		Reader(Reader const&) = delete;
+
+		//announces our epoch before loading the pointer (both seq_cst), so publish() retiring the snapshot we
+		//load always does it at an epoch >= ours and reclaim() waits for us
+		Guard pin() {
+			slot.epoch.store(map.epoch.load());
+			return Guard(slot, map.current.load());
+		}
+
+		std::optional<V> get(Lookup k) {
+			Guard g = pin();
+			V const* v = g[k];
+			return v ? std::make_optional<V>(*v) : std::optional<V>();
+		}
+
+		~Reader() {
+			slot.claimed.store(false, std::memory_order_release);
+		}
+	};
+
+	//throws ReaderSlotsExhausted if max_readers readers are alive
+	Reader reader() {
+		for (size_t i=0; i<num_slots; i++) {
+			bool expected=false;
+			if (slots[i].claimed.compare_exchange_strong(expected, true)) return Reader(*this, slots[i]);
+		}
+
+		throw ReaderSlotsExhausted();
+	}
+
+	//edits the staging map, invisible to readers until publish()
+	std::optional<V> insert(K const& k, V v) {
+		std::lock_guard lock(writer_mtx);
+		return staging.insert(k, std::move(v));
+	}
+
+	std::optional<V> remove(Lookup k) {
+		std::lock_guard lock(writer_mtx);
+		return staging.remove(k);
+	}
+
+	template<class F>
+	auto update(F f) {
+		std::lock_guard lock(writer_mtx);
+		return f(staging);
+	}
+
+	//makes a copy of the staging map the snapshot new pins see
+	void publish() {
+		std::lock_guard lock(writer_mtx);
+
+		Snapshot const* old = current.exchange(new Snapshot(staging));
+		retired.push_back(Retired {.epoch=epoch.fetch_add(1), .snapshot=std::unique_ptr<Snapshot const>(old)});
+		reclaim();
+	}
+
+	//readers must be gone by now
+	~SnapshotMap() {
+		delete current.load();
+	}
+};
+
+#endif //CORECOMMON_SRC_SNAPSHOTMAP_HPP_
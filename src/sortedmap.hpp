@@ -1,178 +1,351 @@
 #ifndef CORECOMMON_SRC_SORTEDMAP_HPP_
 #define CORECOMMON_SRC_SORTEDMAP_HPP_
 
-#include <vector>
-#include <limits>
+#include <algorithm>
+#include <array>
+#include <cstdint>
 #include <functional>
-#include <list>
-#include <variant>
+#include <iterator>
+#include <new>
 #include <optional>
+#include <type_traits>
+#include <utility>
+
+//ordered map as a skip list. each node is one allocation holding the key, value and its tower of forward pointers,
+//so a search touches one cache line per step instead of chasing a separate list node and key/value.
+//heights are random with each level holding ~1/4 of the one below, which keeps towers short (1.33 links a node).
+//small trivially copyable keys are also copied into the links pointing at their node, so a search only dereferences
+//the nodes it moves to rather than every node it compares against
+template<class K, class V, class Compare=std::less<K>>
+class SortedMap {
+ public:
+	using KV = std::pair<K, V>;
 
-#include "util.hpp"
+	size_t count;
 
-template<class K, class V, class Compare=std::less_equal<const K>>
-class SortedMap {
  private:
-	using KV = std::pair<K,V>;
+	static constexpr unsigned MAX_HEIGHT=24;
+	static constexpr bool INLINE_KEYS = std::is_trivially_copyable_v<K> && sizeof(K)<=sizeof(void*);
+
+	struct Node;
+
+	struct KeyedLink {
+		Node* node;
+		K key;
+
+		K const& next_key() const { return key; }
 
-	struct Skip;
-	struct Up;
+		void set(Node* n) {
+			node=n;
+			if (n) key=n->kv.first;
+		}
+	};
 
-	using SkipIter = typename std::list<Skip>::iterator;
-	using KVIter = typename std::list<Up>::iterator;
+	struct PlainLink {
+		Node* node;
 
-	struct Skip {
-		KV* kv;
-		std::variant<SkipIter, KVIter> down;
-		std::optional<SkipIter> up;
+		K const& next_key() const { return node->kv.first; }
+		void set(Node* n) { node=n; }
 	};
 
-	SkipIter center;
+	using Link = std::conditional_t<INLINE_KEYS, KeyedLink, PlainLink>;
+
+	//the tower of height links follows the node in the same allocation
+	struct alignas(std::max(alignof(KV), alignof(Link))) Node {
+		KV kv;
+		unsigned height;
 
-	std::vector<std::list<Skip>> skiplists;
+		Link* tower() {
+			return reinterpret_cast<Link*>(this+1);
+		}
 
-	struct Up {
-		KV* kv;
-		std::optional<SkipIter> up;
+		Node* next() {
+			return tower()[0].node;
+		}
 	};
 
-	std::list<Up> kvs;
+	std::array<Link, MAX_HEIGHT> head;
+	//levels in use
+	unsigned height;
+	uint64_t rng;
+	Compare cmp;
+
+	unsigned random_height() {
+		rng ^= rng<<13;
+		rng ^= rng>>7;
+		rng ^= rng<<17;
 
-	template<class DK>
-	unsigned density(unsigned count, KVIter kv_iter) {
-		return __builtin_ctz(count);
+		//two random bits per level, capped at MAX_HEIGHT
+		return 1+__builtin_ctzll(rng | (1ull<<(2*(MAX_HEIGHT-1))))/2;
 	}
 
-	template<typename Iterator>
-	bool locate(Iterator begin, Iterator end, Iterator* iter, K const& k) const {
-		while (true) {
-			if (k==(*iter)->kv->first) {
-				return true;
-			}
+	template<class ...Args>
+	static Node* new_node(unsigned h, Args&&... args) {
+		void* mem = ::operator new(sizeof(Node)+h*sizeof(Link), std::align_val_t(alignof(Node)));
 
-			bool cmp = Compare()((*iter)->kv->first, k);
-			Iterator forward = *iter;
-			std::advance(forward, 1);
-			Iterator backward = *iter;
-			std::advance(backward, -1);
-			if (cmp && (forward==end || !Compare()(forward->kv->first, k))) {
-				*iter = forward;
-				return false;
-			} else if (!cmp && (*iter==begin || Compare()(backward->kv->first, k))) {
-				return false;
-			}
+		try {
+			return ::new (mem) Node {.kv=KV(std::forward<Args>(args)...), .height=h};
+		} catch (...) {
+			::operator delete(mem, std::align_val_t(alignof(Node)));
+			throw;
+		}
+	}
 
-			if (cmp) {
-				*iter = forward;
-			} else {
-				*iter = backward;
-			}
+	static void free_node(Node* n) {
+		n->~Node();
+		::operator delete(n, std::align_val_t(alignof(Node)));
+	}
+
+	//finds the link at each level that points at the first node not less than k, returning level 0's.
+	//preds may be null if only that node is wanted
+	Link* find(K const& k, std::array<Link*, MAX_HEIGHT>* preds) const {
+		Link* links = const_cast<Link*>(head.data());
+
+		for (unsigned l=height; l-->0;) {
+			while (links[l].node && cmp(links[l].next_key(), k)) links = links[l].node->tower();
+			if (preds) (*preds)[l] = &links[l];
 		}
+
+		return &links[0];
 	}
 
-	struct LocationRec {
-		bool match;
-		std::vector<SkipIter> path;
-		std::list<Skip>* current;
-		KVIter kv_iter;
-	};
+	Node* lower_node(K const& k) const {
+		return find(k, nullptr)->node;
+	}
 
-	LocationRec locate_rec(K const& k, bool stop_on_match) {
-		SkipIter cur = center;
-		bool reset=false;
-		std::vector<SkipIter> path;
-		for (std::list<Skip>& skipl: skiplists) {
-			if (reset) cur = skipl.begin();
-
-			if (cur!=skipl.end()) {
-				if (locate(skipl.begin(), skipl.end(), &cur, k) && stop_on_match) {
-					return (LocationRec){.match=true, .current=&skipl, .path=path, .kv_iter=kvs.end()};
-				}
-
-				if (cur==skipl.end()) cur--;
-				path.push_back(cur);
-				cur = std::get<SkipIter>(cur->down);
-				reset=false;
-			} else {
-				path.push_back(cur);
-				reset=true;
+	Node* upper_node(K const& k) const {
+		Node* n = lower_node(k);
+		while (n && !cmp(k, n->kv.first)) n=n->next();
+		return n;
+	}
+
+	bool matches(Node* n, K const& k) const {
+		return n && !cmp(k, n->kv.first);
+	}
+
+	//links nodes on in order after the current last one, tails being the last link of every level
+	struct Appender {
+		SortedMap& map;
+		std::array<Link*, MAX_HEIGHT> tails;
+
+		explicit Appender(SortedMap& map): map(map) {
+			for (unsigned l=0; l<MAX_HEIGHT; l++) tails[l] = &map.head[l];
+		}
+
+		template<class ...Args>
+		void append(Args&&... args) {
+			unsigned h = map.random_height();
+			Node* n = new_node(h, std::forward<Args>(args)...);
+
+			for (unsigned l=0; l<h; l++) {
+				tails[l]->set(n);
+				tails[l] = &n->tower()[l];
+				tails[l]->set(nullptr);
 			}
+
+			map.height = std::max(map.height, h);
+			map.count++;
 		}
+	};
 
-		if (kvs.size()==0)
-			return (LocationRec){.match=false, .current=nullptr, .kv_iter=kvs.end(), .path=path};
+	template<bool is_const>
+	class IteratorTemplate {
+	 private:
+		Node* node;
 
-		KVIter iter = reset ? kvs.begin() : std::get<KVIter>(cur->down);
-		bool match = locate(kvs.begin(), kvs.end(), &iter, k);
-		return (LocationRec){.match=match, .current=nullptr, .kv_iter=iter, .path=path};
-	}
+		explicit IteratorTemplate(Node* node): node(node) {}
+		friend SortedMap;
+		template<bool> friend class IteratorTemplate;
+
+	 public:
+		using iterator_category = std::forward_iterator_tag;
+		using difference_type = std::ptrdiff_t;
+		using value_type = KV;
+		using pointer = std::conditional_t<is_const, KV const*, KV*>;
+		using reference = std::conditional_t<is_const, KV const&, KV&>;
+
+		IteratorTemplate(): node(nullptr) {}
+
+		template<bool other_const, class=std::enable_if_t<is_const || !other_const>>
+		IteratorTemplate(IteratorTemplate<other_const> const& other): node(other.node) {}
+
+		IteratorTemplate& operator++() {
+			node=node->next();
+			return *this;
+		}
+
+		IteratorTemplate operator++(int) {
+			IteratorTemplate cpy = *this;
+			node=node->next();
+			return cpy;
+		}
+
+		bool operator==(IteratorTemplate const& other) const {
+			return node==other.node;
+		}
+
+		bool operator!=(IteratorTemplate const& other) const {
+			return node!=other.node;
+		}
+
+		reference operator*() const {
+			return node->kv;
+		}
+
+		pointer operator->() const {
+			return &node->kv;
+		}
+	};
 
  public:
-	SortedMap(): kvs(), skiplists() {
-		skiplists.emplace_back();
-		center=skiplists[0].begin();
+	using Iterator = IteratorTemplate<false>;
+	using ConstIterator = IteratorTemplate<true>;
+
+	template<class It>
+	struct Range {
+		It b, e;
+
+		It begin() const { return b; }
+		It end() const { return e; }
+	};
+
+	explicit SortedMap(Compare cmp={}): count(0), height(0), rng(0x9E3779B97F4A7C15ull), cmp(cmp) {
+		for (Link& l: head) l.set(nullptr);
+	}
+
+	SortedMap(std::initializer_list<KV> init, Compare cmp={}): SortedMap(cmp) {
+		for (KV const& kv: init) insert(kv.first, kv.second);
+	}
+
+	SortedMap(SortedMap const& other): SortedMap(other.cmp) {
+		Appender app(*this);
+		for (KV const& kv: other) app.append(kv);
+	}
+
+	SortedMap(SortedMap&& other): SortedMap(other.cmp) {
+		swap(other);
+	}
+
+	SortedMap& swap(SortedMap& other) {
+		std::swap(count, other.count);
+		std::swap(head, other.head);
+		std::swap(height, other.height);
+		std::swap(rng, other.rng);
+		std::swap(cmp, other.cmp);
+		return *this;
+	}
+
+	SortedMap& operator=(SortedMap other) {
+		return swap(other);
 	}
 
 	~SortedMap() {
-		for (Up& up: kvs) {
-			delete up.kv;
+		clear();
+	}
+
+	void clear() {
+		for (Node* n=head[0].node; n;) {
+			Node* next = n->next();
+			free_node(n);
+			n=next;
 		}
+
+		for (Link& l: head) l.set(nullptr);
+		height=0;
+		count=0;
 	}
 
-	void insert(K const& k, V const& v) {
-		KV* new_kv = new std::pair(k,v);
+	V* operator[](K const& k) {
+		Node* n = lower_node(k);
+		return matches(n, k) ? &n->kv.second : nullptr;
+	}
 
-		LocationRec rec = locate_rec(k, false);
-		KVIter kv_iter = kvs.insert(rec.kv_iter, (Up){.kv=new_kv});
-		std::variant<SkipIter, KVIter> down = std::variant<SkipIter, KVIter>(kv_iter);
-		std::optional<SkipIter>* up = &kv_iter->up;
+	V const* operator[](K const& k) const {
+		return const_cast<SortedMap&>(*this)[k];
+	}
 
-		unsigned d = density<K>(kvs.size(), kv_iter);
+	//returns the previous value if k was already present
+	std::optional<V> insert(K const& k, V v) {
+		std::array<Link*, MAX_HEIGHT> preds;
+		Node* n = find(k, &preds)->node;
 
-		while (d>skiplists.size()) {
-			skiplists.insert(skiplists.begin(), std::list<Skip>());
-			center = skiplists[0].begin();
+		if (matches(n, k)) {
+			std::optional<V> old(std::move(n->kv.second));
+			n->kv.second = std::move(v);
+			return old;
 		}
 
-		for (unsigned i=skiplists.size()-1; i!=(unsigned)skiplists.size()-1-d; i--) {
-			SkipIter insertion = skiplists[i].insert(rec.path[i], (Skip){.kv=new_kv, .down=down});
-			*up = std::optional(insertion);
-			down = std::variant<SkipIter, KVIter>(insertion);
-			up = &insertion->up;
+		unsigned h = random_height();
+		for (; height<h; height++) preds[height] = &head[height];
+
+		n = new_node(h, k, std::move(v));
+		for (unsigned l=0; l<h; l++) {
+			n->tower()[l] = *preds[l];
+			preds[l]->set(n);
 		}
 
-		*up = std::optional<SkipIter>();
+		count++;
+		return std::optional<V>();
 	}
 
-	V* operator[](K const& k) {
-		LocationRec rec = locate_rec(k, true);
-		if (rec.match) {
-			return &rec.kv_iter->kv->second;
-		} else {
-			return nullptr;
-		}
+	std::optional<V> remove(K const& k) {
+		std::array<Link*, MAX_HEIGHT> preds;
+		Node* n = find(k, &preds)->node;
+		if (!matches(n, k)) return std::optional<V>();
+
+		for (unsigned l=0; l<n->height; l++) *preds[l] = n->tower()[l];
+		while (height>0 && !head[height-1].node) height--;
+
+		std::optional<V> ret(std::move(n->kv.second));
+		free_node(n);
+		count--;
+		return ret;
 	}
 
-	bool remove(K const& k) {
-		LocationRec rec = locate_rec(k, false);
-		if (rec.loc.match) {
-			do {
-				std::optional<SkipIter> up = rec.kv_iter->up;
-				auto skipl_iter = skiplists.end();
-				while (up) {
-					skipl_iter--;
-					skipl_iter->erase(*up);
-					up = (**up).up;
-				}
-			} while (rec.kv_iter->kv->first == k);
+	//first entry with a key not less than k
+	Iterator lower_bound(K const& k) {
+		return Iterator(lower_node(k));
+	}
 
-			return true;
-		} else {
-			return false;
-		}
+	//first entry with a key greater than k
+	Iterator upper_bound(K const& k) {
+		return Iterator(upper_node(k));
+	}
+
+	ConstIterator lower_bound(K const& k) const {
+		return ConstIterator(lower_node(k));
+	}
+
+	ConstIterator upper_bound(K const& k) const {
+		return ConstIterator(upper_node(k));
 	}
 
-	//TODO: iterator
+	//entries with from <= key < to, for range-for
+	Range<Iterator> range(K const& from, K const& to) {
+		Node* b = lower_node(from);
+		return {.b=Iterator(b), .e=b && cmp(b->kv.first, to) ? lower_bound(to) : Iterator(b)};
+	}
+
+	Range<ConstIterator> range(K const& from, K const& to) const {
+		Node* b = lower_node(from);
+		return {.b=ConstIterator(b), .e=b && cmp(b->kv.first, to) ? lower_bound(to) : ConstIterator(b)};
+	}
+
+	Iterator begin() {
+		return Iterator(head[0].node);
+	}
+
+	Iterator end() {
+		return Iterator();
+	}
+
+	ConstIterator begin() const {
+		return ConstIterator(head[0].node);
+	}
+
+	ConstIterator end() const {
+		return ConstIterator();
+	}
 };
 
 #endif //CORECOMMON_SRC_SORTEDMAP_HPP_
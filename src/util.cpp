@@ -1,121 +1,377 @@
 #include "util.hpp"
 
+#include <array>
+#include <cassert>
 #include <fstream>
 #include <string>
 #include <tgmath.h>
 
-//kinda copied from https://nachtimwald.com/2017/09/24/hex-encode-and-decode-in-c/
-//since im too lazy to type all these ifs
+//the base64 and hex codecs are vectorized per isa at compile time (ssse3 or avx2, which x86-64 builds only get with
+//-mssse3/-mavx2 or -march), define UTIL_NO_SIMD to force the scalar loops
+#if defined(__AVX2__) && !defined(UTIL_NO_SIMD)
+#include <immintrin.h>
+#define UTIL_SSSE3
+#define UTIL_AVX2
+#elif defined(__SSSE3__) && !defined(UTIL_NO_SIMD)
+#include <tmmintrin.h>
+#define UTIL_SSSE3
+#endif
+
+static constexpr char HEX_DIGITS[] = "0123456789ABCDEF";
+
+//0xFF for characters that aren't hex digits
+static constexpr auto HEX_VALUES = []() {
+	std::array<unsigned char, 256> t {};
+	for (unsigned char& x: t) x = 0xFF;
+	for (int i=0; i<10; i++) t['0'+i] = i;
+	for (int i=0; i<6; i++) t['A'+i] = t['a'+i] = 10+i;
+	return t;
+}();
 
 char hexchar(char hex) {
-	if (hex >= '0' && hex <= '9') {
-		return hex - '0';
-	} else if (hex >= 'A' && hex <= 'F') {
-		return hex - 'A' + 10;
-	} else if (hex >= 'a' && hex <= 'f') {
-		return hex - 'a' + 10;
-	} else {
-		return 0;
-	}
+	unsigned char v = HEX_VALUES[static_cast<unsigned char>(hex)];
+	return v==0xFF ? 0 : v;
 }
 
 void charhex(unsigned char chr, char* out) {
-	char first = (char)(chr % 16u);
-	if (first < 10) out[1] = first+'0';
-	else out[1] = (first-10) + 'A';
+	out[0] = HEX_DIGITS[chr>>4];
+	out[1] = HEX_DIGITS[chr&15];
+}
 
-	chr /= 16;
+void hex_encode(char const* src, size_t len, char* out) {
+	unsigned char const* s = reinterpret_cast<unsigned char const*>(src);
+	size_t i=0;
+
+#ifdef UTIL_AVX2
+	//permuted so the in lane unpacks come out in order
+	__m256i lut = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<__m128i const*>(HEX_DIGITS)));
+	for (; i+32<=len; i+=32) {
+		__m256i v = _mm256_permute4x64_epi64(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(s+i)), 0b11011000);
+		__m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(15)));
+		__m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, _mm256_set1_epi8(15)));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out+2*i), _mm256_unpacklo_epi8(hi, lo));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out+2*i+32), _mm256_unpackhi_epi8(hi, lo));
+	}
+#endif
+
+#ifdef UTIL_SSSE3
+	__m128i lut128 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(HEX_DIGITS));
+	for (; i+16<=len; i+=16) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(s+i));
+		__m128i hi = _mm_shuffle_epi8(lut128, _mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(15)));
+		__m128i lo = _mm_shuffle_epi8(lut128, _mm_and_si128(v, _mm_set1_epi8(15)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out+2*i), _mm_unpacklo_epi8(hi, lo));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out+2*i+16), _mm_unpackhi_epi8(hi, lo));
+	}
+#endif
 
-	if (chr < 10) out[0] = chr+'0';
-	else out[0] = (chr-10) + 'A';
+	for (; i<len; i++) charhex(s[i], out+2*i);
 }
 
-char const* B64_ALPHABET = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+#ifdef UTIL_SSSE3
+//digits to their values, setting bad's bytes for other characters. letters are lowercased by setting 0x20
+static inline __m128i hex_values(__m128i c, __m128i& bad) {
+	__m128i lower = _mm_or_si128(c, _mm_set1_epi8(0x20));
+	__m128i digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0'-1)), _mm_cmplt_epi8(c, _mm_set1_epi8('9'+1)));
+	__m128i letter = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a'-1)), _mm_cmplt_epi8(lower, _mm_set1_epi8('f'+1)));
+	bad = _mm_or_si128(bad, _mm_andnot_si128(_mm_or_si128(digit, letter), _mm_set1_epi8(-1)));
+	return _mm_or_si128(_mm_and_si128(digit, _mm_sub_epi8(c, _mm_set1_epi8('0'))),
+	                    _mm_and_si128(letter, _mm_sub_epi8(lower, _mm_set1_epi8('a'-10))));
+}
+#endif
+
+#ifdef UTIL_AVX2
+static inline __m256i hex_values(__m256i c, __m256i& bad) {
+	__m256i lower = _mm256_or_si256(c, _mm256_set1_epi8(0x20));
+	__m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8('0'-1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('9'+1), c));
+	__m256i letter = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a'-1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('f'+1), lower));
+	bad = _mm256_or_si256(bad, _mm256_andnot_si256(_mm256_or_si256(digit, letter), _mm256_set1_epi8(-1)));
+	return _mm256_or_si256(_mm256_and_si256(digit, _mm256_sub_epi8(c, _mm256_set1_epi8('0'))),
+	                       _mm256_and_si256(letter, _mm256_sub_epi8(lower, _mm256_set1_epi8('a'-10))));
+}
+#endif
+
+bool hex_decode(char const* src, size_t len, char* out) {
+	if (len%2) return false;
+
+	unsigned char const* s = reinterpret_cast<unsigned char const*>(src);
+	size_t i=0;
+
+#ifdef UTIL_AVX2
+	__m256i bad256 = _mm256_setzero_si256();
+	for (; i+16<=len/2; i+=16) {
+		__m256i v = hex_values(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(s+2*i)), bad256);
+		//pairs to hi*16+lo, packed within lanes, then the lanes' halves together
+		__m256i bytes = _mm256_maddubs_epi16(v, _mm256_set1_epi16(0x0110));
+		bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(bytes, bytes), 0b1000);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out+i), _mm256_castsi256_si128(bytes));
+	}
 
-//designed for inefficiency and complexity
-unsigned char* bit_reinterpret(unsigned char* src, unsigned inlen, unsigned* outlen, unsigned char inl, unsigned char outl) {
-	*outlen = (inlen*inl)/outl + 1; //if aligned, remove padding
-	unsigned char* out = (unsigned char*)malloc(*outlen);
+	if (!_mm256_testz_si256(bad256, bad256)) return false;
+#endif
 
-	unsigned char* srccur = src;
-	unsigned char* cur = out;
-	unsigned pos=0;
+#ifdef UTIL_SSSE3
+	__m128i bad128 = _mm_setzero_si128();
+	for (; i+8<=len/2; i+=8) {
+		__m128i v = hex_values(_mm_loadu_si128(reinterpret_cast<__m128i const*>(s+2*i)), bad128);
+		__m128i bytes = _mm_maddubs_epi16(v, _mm_set1_epi16(0x0110));
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(out+i), _mm_packus_epi16(bytes, bytes));
+	}
 
-	*cur=0;
+	if (_mm_movemask_epi8(bad128)) return false;
+#endif
 
-	while (1) {
-		*cur |= (((*srccur<<(pos%inl))&(UCHAR_MAX<<(8-inl)))>>(pos%outl))&(UCHAR_MAX<<(8-outl));
+	//invalid digits set the top bit, checked once at the end
+	unsigned char bad=0;
+	for (; i<len/2; i++) {
+		unsigned char hi = HEX_VALUES[s[2*i]], lo = HEX_VALUES[s[2*i+1]];
+		bad |= hi|lo;
+		out[i] = static_cast<char>(hi<<4 | (lo&15));
+	}
 
-		char incr;
-		if (inl-(pos%inl) > outl-(pos%outl)) {
-			incr = outl-(pos%outl);
-		} else {
-			incr = inl-(pos%inl);
-		}
+	return !(bad&0x80);
+}
 
-		if ((pos%outl) + incr >= outl) {
-			cur++;
-			*cur = 0;
-		}
+struct Base64Tables {
+	//the characters for 62 and 63, which differ between alphabets
+	char c62, c63;
+	char enc[64];
+	//0xFF for characters outside the alphabet
+	unsigned char dec[256];
+};
+
+static constexpr Base64Tables make_base64_tables(char c62, char c63) {
+	Base64Tables t {.c62=c62, .c63=c63, .enc={}, .dec={}};
+	for (int i=0; i<256; i++) t.dec[i] = 0xFF;
+	for (int i=0; i<26; i++) {
+		t.enc[i] = 'A'+i;
+		t.enc[26+i] = 'a'+i;
+	}
 
-		if ((pos%inl) + incr >= inl) {
-			srccur++;
-			if (srccur-src >= inlen) {
-				pos += incr;
-				break;
-			}
-		}
+	for (int i=0; i<10; i++) t.enc[52+i] = '0'+i;
+	t.enc[62] = c62;
+	t.enc[63] = c63;
+	for (int i=0; i<64; i++) t.dec[static_cast<unsigned char>(t.enc[i])] = i;
+	return t;
+}
 
-		pos += incr;
-	}
+static constexpr Base64Tables BASE64_TABLES[] = {make_base64_tables('+', '/'), make_base64_tables('-', '_')};
+
+#ifdef UTIL_SSSE3
+//16 6 bit values (as bytes) to characters, from their distance to the start of their range: indices 0-25 map to 13,
+//26-51 to 0, 52-61 to 1-10, 62 to 11 and 63 to 12. then the table has the offset to add for each
+static inline __m128i base64_chars(__m128i idx, Base64Tables const& t) {
+	__m128i lut = _mm_setr_epi8('a'-26, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52,
+	                            t.c62-62, t.c63-63, 'A', 0, 0);
+	__m128i r = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+	r = _mm_or_si128(r, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), idx), _mm_set1_epi8(13)));
+	return _mm_add_epi8(_mm_shuffle_epi8(lut, r), idx);
+}
 
-	*outlen = cur-out + (pos%outl > 0 ? 1 : 0);
+//12 bytes in the low 3/4 of in to 16 6 bit values. each 32 bit lane gets bytes b,a,c,b so two multiplies can move
+//the four fields of abc into their own bytes
+static inline __m128i base64_split(__m128i in) {
+	in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+	__m128i t0 = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0FC0FC00)), _mm_set1_epi32(0x04000040));
+	__m128i t1 = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003F03F0)), _mm_set1_epi32(0x01000010));
+	return _mm_or_si128(t0, t1);
+}
 
-	return out;
+//16 characters to their values, setting bad's bytes for those outside the alphabet. chars past 0x7F compare negative
+static inline __m128i base64_values(__m128i c, Base64Tables const& t, __m128i& bad) {
+	auto in_range = [&](char lo, char hi) {
+		return _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8(lo-1)), _mm_cmplt_epi8(c, _mm_set1_epi8(hi+1)));
+	};
+
+	__m128i upper = in_range('A', 'Z'), lower = in_range('a', 'z'), digit = in_range('0', '9');
+	__m128i is62 = _mm_cmpeq_epi8(c, _mm_set1_epi8(t.c62)), is63 = _mm_cmpeq_epi8(c, _mm_set1_epi8(t.c63));
+
+	__m128i shift = _mm_or_si128(_mm_or_si128(_mm_and_si128(upper, _mm_set1_epi8(-'A')), _mm_and_si128(lower, _mm_set1_epi8(26-'a'))),
+	                             _mm_or_si128(_mm_and_si128(digit, _mm_set1_epi8(52-'0')),
+	                                          _mm_or_si128(_mm_and_si128(is62, _mm_set1_epi8(62-t.c62)), _mm_and_si128(is63, _mm_set1_epi8(63-t.c63)))));
+
+	__m128i valid = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(digit, _mm_or_si128(is62, is63)));
+	bad = _mm_or_si128(bad, _mm_andnot_si128(valid, _mm_set1_epi8(-1)));
+	return _mm_add_epi8(c, shift);
+}
+
+//16 6 bit values to 12 bytes in the low 3/4. pairs merge into 12 bits, then pairs of those into 24 in each lane
+static inline __m128i base64_pack(__m128i v) {
+	__m128i merged = _mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140));
+	__m128i lanes = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+	return _mm_shuffle_epi8(lanes, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+}
+#endif
+
+#ifdef UTIL_AVX2
+static inline __m256i base64_chars(__m256i idx, Base64Tables const& t) {
+	__m256i lut = _mm256_setr_epi8('a'-26, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52,
+	                               t.c62-62, t.c63-63, 'A', 0, 0,
+	                               'a'-26, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52,
+	                               t.c62-62, t.c63-63, 'A', 0, 0);
+	__m256i r = _mm256_subs_epu8(idx, _mm256_set1_epi8(51));
+	r = _mm256_or_si256(r, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), idx), _mm256_set1_epi8(13)));
+	return _mm256_add_epi8(_mm256_shuffle_epi8(lut, r), idx);
+}
+
+//12 bytes in the low 3/4 of each lane
+static inline __m256i base64_split(__m256i in) {
+	in = _mm256_shuffle_epi8(in, _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+	                                             10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+	__m256i t0 = _mm256_mulhi_epu16(_mm256_and_si256(in, _mm256_set1_epi32(0x0FC0FC00)), _mm256_set1_epi32(0x04000040));
+	__m256i t1 = _mm256_mullo_epi16(_mm256_and_si256(in, _mm256_set1_epi32(0x003F03F0)), _mm256_set1_epi32(0x01000010));
+	return _mm256_or_si256(t0, t1);
 }
 
-char* base64_encode(char* src, unsigned len) {
-	unsigned olen;
-	unsigned char* s = bit_reinterpret((unsigned char*)src, len, &olen, 8, 6);
-	char* o = (char*)s;
+static inline __m256i base64_values(__m256i c, Base64Tables const& t, __m256i& bad) {
+	auto in_range = [&](char lo, char hi) {
+		return _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8(lo-1)), _mm256_cmpgt_epi8(_mm256_set1_epi8(hi+1), c));
+	};
+
+	__m256i upper = in_range('A', 'Z'), lower = in_range('a', 'z'), digit = in_range('0', '9');
+	__m256i is62 = _mm256_cmpeq_epi8(c, _mm256_set1_epi8(t.c62)), is63 = _mm256_cmpeq_epi8(c, _mm256_set1_epi8(t.c63));
+
+	__m256i shift = _mm256_or_si256(_mm256_or_si256(_mm256_and_si256(upper, _mm256_set1_epi8(-'A')), _mm256_and_si256(lower, _mm256_set1_epi8(26-'a'))),
+	                                _mm256_or_si256(_mm256_and_si256(digit, _mm256_set1_epi8(52-'0')),
+	                                                _mm256_or_si256(_mm256_and_si256(is62, _mm256_set1_epi8(62-t.c62)), _mm256_and_si256(is63, _mm256_set1_epi8(63-t.c63)))));
+
+	__m256i valid = _mm256_or_si256(_mm256_or_si256(upper, lower), _mm256_or_si256(digit, _mm256_or_si256(is62, is63)));
+	bad = _mm256_or_si256(bad, _mm256_andnot_si256(valid, _mm256_set1_epi8(-1)));
+	return _mm256_add_epi8(c, shift);
+}
 
-	for (unsigned i=0; i<olen; i++) {
-		o[i] = B64_ALPHABET[s[i]>>2];
+//24 bytes in the low 3/4, the lanes' 12 bytes joined
+static inline __m256i base64_pack(__m256i v) {
+	__m256i merged = _mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140));
+	__m256i lanes = _mm256_madd_epi16(merged, _mm256_set1_epi32(0x00011000));
+	lanes = _mm256_shuffle_epi8(lanes, _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+	                                                    2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+	return _mm256_permutevar8x32_epi32(lanes, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+}
+#endif
+
+size_t base64_encode(char const* src, size_t len, char* out, Base64 alphabet, bool pad) {
+	Base64Tables const& t = BASE64_TABLES[static_cast<int>(alphabet)];
+	unsigned char const* s = reinterpret_cast<unsigned char const*>(src);
+	char* o = out;
+	size_t i=0;
+
+	//the loads take 4 bytes more than they use
+#ifdef UTIL_AVX2
+	for (; i+28<=len; i+=24, o+=32) {
+		__m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<__m128i const*>(s+i))),
+		                                     _mm_loadu_si128(reinterpret_cast<__m128i const*>(s+i+12)), 1);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(o), base64_chars(base64_split(in), t));
 	}
+#endif
 
-	o = (char*)realloc(o, ((len+2)/3)*4 + 1);
-	while ((olen*6)/24 != (len+2)/3) {
-		o[olen++] = '=';
+#ifdef UTIL_SSSE3
+	for (; i+16<=len; i+=12, o+=16) {
+		__m128i in = _mm_loadu_si128(reinterpret_cast<__m128i const*>(s+i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(o), base64_chars(base64_split(in), t));
+	}
+#endif
+
+	for (; i+3<=len; i+=3, o+=4) {
+		uint32_t w = s[i]<<16 | s[i+1]<<8 | s[i+2];
+		o[0] = t.enc[w>>18];
+		o[1] = t.enc[(w>>12)&63];
+		o[2] = t.enc[(w>>6)&63];
+		o[3] = t.enc[w&63];
 	}
 
-	o[olen] = 0;
+	if (len-i==1) {
+		o[0] = t.enc[s[i]>>2];
+		o[1] = t.enc[(s[i]&3)<<4];
+		o += 2;
+		if (pad) {
+			o[0] = o[1] = '=';
+			o += 2;
+		}
+	} else if (len-i==2) {
+		uint32_t w = s[i]<<8 | s[i+1];
+		o[0] = t.enc[w>>10];
+		o[1] = t.enc[(w>>4)&63];
+		o[2] = t.enc[(w<<2)&63];
+		o += 3;
+		if (pad) *o++ = '=';
+	}
 
-	return o;
+	return o-out;
 }
 
-//mods src
-char* base64_decode(char* src, unsigned* len) {
-	unsigned slen = strlen(src);
-	unsigned len_off=0;
-	while (slen>0 && src[slen-1]=='=') {
-		len_off++;
-		slen--;
+std::optional<size_t> base64_decode(char const* src, size_t len, char* out, Base64 alphabet) {
+	Base64Tables const& t = BASE64_TABLES[static_cast<int>(alphabet)];
+	if (len%4==0 && len>0 && src[len-1]=='=') len -= src[len-2]=='=' ? 2 : 1;
+	if (len%4==1) return std::nullopt;
+
+	unsigned char const* s = reinterpret_cast<unsigned char const*>(src);
+	char* o = out;
+	size_t i=0;
+
+	//the stores write 4 (or 8) bytes more than they produce, which the rest of the input makes room for
+#ifdef UTIL_AVX2
+	__m256i bad256 = _mm256_setzero_si256();
+	for (; i+48<=len; i+=32, o+=24) {
+		__m256i c = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(s+i));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(o), base64_pack(base64_values(c, t, bad256)));
+	}
+
+	if (!_mm256_testz_si256(bad256, bad256)) return std::nullopt;
+#endif
+
+#ifdef UTIL_SSSE3
+	__m128i bad = _mm_setzero_si128();
+	for (; i+24<=len; i+=16, o+=12) {
+		__m128i c = _mm_loadu_si128(reinterpret_cast<__m128i const*>(s+i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(o), base64_pack(base64_values(c, t, bad)));
+	}
+
+	if (_mm_movemask_epi8(bad)) return std::nullopt;
+#endif
+
+	//invalid characters set the top bit
+	unsigned char bad_bits=0;
+	for (; i+4<=len; i+=4, o+=3) {
+		unsigned char a = t.dec[s[i]], b = t.dec[s[i+1]], c = t.dec[s[i+2]], d = t.dec[s[i+3]];
+		bad_bits |= a|b|c|d;
+		uint32_t w = a<<18 | b<<12 | c<<6 | d;
+		o[0] = static_cast<char>(w>>16);
+		o[1] = static_cast<char>(w>>8);
+		o[2] = static_cast<char>(w);
 	}
 
-	for (unsigned i=0; i<slen; i++) {
-		src[i] = (strchr(B64_ALPHABET, src[i])-B64_ALPHABET)<<2;
+	if (len-i>=2) {
+		unsigned char a = t.dec[s[i]], b = t.dec[s[i+1]], c = len-i==3 ? t.dec[s[i+2]] : 0;
+		bad_bits |= a|b|c;
+		*o++ = static_cast<char>(a<<2 | (b&63)>>4);
+		if (len-i==3) *o++ = static_cast<char>(b<<4 | (c&63)>>2);
 	}
 
-	unsigned char* s = bit_reinterpret((unsigned char*)src, slen, len, 6, 8);
-	*len -= len_off;
-	return (char*)s;
+	if (bad_bits&0x80) return std::nullopt;
+	return o-out;
+}
+
+std::string base64_encode(std::string_view src, Base64 alphabet, bool pad) {
+	std::string out(base64_encoded_size(src.size()), '\0');
+	out.resize(base64_encode(src.data(), src.size(), out.data(), alphabet, pad));
+	return out;
+}
+
+std::optional<std::string> base64_decode(std::string_view src, Base64 alphabet) {
+	std::string out(base64_decoded_max(src.size()), '\0');
+	std::optional<size_t> len = base64_decode(src.data(), src.size(), out.data(), alphabet);
+	if (!len) return std::nullopt;
+	out.resize(*len);
+	return out;
 }
 
 VarIntRef::VarIntRef(VarIntRef::VarInt* var_vi, uint64_t x): vi(var_vi), size(1) {
+	assert(x<=MAX_VALUE);
 	var_vi->first = static_cast<unsigned char>(x) & ((1 << 5)-1);
 	x>>=5;
 	for (; x>0 && size<8; size++) {
-		var_vi->rest[size] = static_cast<unsigned char>(x);
+		var_vi->rest[size-1] = static_cast<unsigned char>(x);
 		x>>=8;
 	}
 
@@ -125,13 +381,68 @@ VarIntRef::VarIntRef(VarIntRef::VarInt* var_vi, uint64_t x): vi(var_vi), size(1)
 uint64_t VarIntRef::value() const {
 	uint64_t x=vi->first & ((1<<5)-1);
 
-	for (char i=0; i<size-1; i++) {
-		x |= vi->rest[i]<<(i*8+5);
+	for (int i=0; i<size-1; i++) {
+		x |= static_cast<uint64_t>(vi->rest[i])<<(i*8+5);
 	}
 
 	return x;
 }
 
+//runs of 8 values under 32 (one byte each) go through at once, which dominate eg. lengths and small counts.
+//otherwise one value per encode_wide, so the store's length never depends on a branch
+size_t VarIntRef::encode_many(uint64_t const* in, size_t n, char* out) {
+	char* start = out;
+	size_t i=0;
+
+	for (; i+8<=n; ) {
+		uint64_t any=0;
+		for (size_t j=0; j<8; j++) any |= in[i+j];
+
+		if (any<32) {
+			uint64_t w=0;
+			for (size_t j=0; j<8; j++) w |= in[i+j]<<(8*j);
+			store_le(out, w);
+			out += 8;
+			i += 8;
+		} else {
+			for (size_t j=0; j<8; j++) out += encode_wide(out, in[i+j]);
+			i += 8;
+		}
+	}
+
+	for (; i<n; i++) out += encode_wide(out, in[i]);
+	return out-start;
+}
+
+//8 byte loads while 8 bytes are left, a run of 8 one byte VarInts at once when their size bits are all clear
+std::optional<size_t> VarIntRef::decode_many(char const* in, size_t len, uint64_t* out, size_t n) {
+	char const* p = in, *end = in+len;
+	size_t i=0;
+
+	while (i<n && end-p>=8) {
+		uint64_t w = load_le(p);
+		if (i+8<=n && (w & 0xE0E0E0E0E0E0E0E0ull)==0) {
+			for (size_t j=0; j<8; j++) out[i+j] = (w>>(8*j)) & 0xFF;
+			p += 8;
+			i += 8;
+		} else {
+			p += decode_wide(p, out[i++]);
+		}
+	}
+
+	//the tail, without reading past end
+	for (; i<n; i++) {
+		if (p==end) return std::nullopt;
+
+		VarIntRef vi(p);
+		if (end-p<vi.size) return std::nullopt;
+		out[i] = vi.value();
+		p += vi.size;
+	}
+
+	return p-in;
+}
+
 std::string read_file(const char* path) {
 	std::ifstream file;
 	file.exceptions(std::ios::failbit);
@@ -140,16 +451,16 @@ std::string read_file(const char* path) {
 	return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
 }
 
+//multiplies in one factor at a time, so it only overflows when the result does. after step i res is (n-k+i choose i),
+//so res*m is divisible by i and splitting res into res/i and res%i keeps it exact without the wide product
 size_t binomial(size_t n, size_t k) {
 	if (n<k) return 0;
+	if (k>n-k) k=n-k;
 
 	size_t res=1;
-	for (size_t i=n-k+1; i<=n; i++) {
-		res *= i;
-	}
-
-	for (size_t i=2; i<=k; i++) {
-		res /= i;
+	for (size_t i=1; i<=k; i++) {
+		size_t m = n-k+i;
+		res = res/i*m + res%i*m/i;
 	}
 
 	return res;
@@ -1,12 +1,18 @@
 #ifndef CORECOMMON_SRC_UTIL_HPP_
 #define CORECOMMON_SRC_UTIL_HPP_
 
+#include <algorithm>
+#include <cassert>
 #include <cstddef>
+#include <cstdint>
 #include <cstring>
 #include <string>
+#include <string_view>
 #include <limits>
 #include <vector>
 #include <optional>
+#include <functional>
+#include <climits>
 
 #ifdef EMSCRIPTEN
 #include <emscripten.h>
@@ -251,6 +257,8 @@ class Slice {
 	}
 };
 
+//the first byte holds the low 5 bits of the value and the size minus one in its top 3 bits, the rest of the value
+//follows little endian. so the size is known from the first byte, and a whole VarInt is one 8 byte load and a mask
 class VarIntRef {
  public:
 	struct VarInt {
@@ -259,12 +267,61 @@ class VarIntRef {
 	};
 
 	VarInt const* vi;
+	//bytes taken, 1 to 8
 	char size;
 
+	//3 bits of size and 61 of value fill the 8 bytes. larger values are asserted against and otherwise keep their
+	//low 61 bits, so they still take 8 bytes and never more
+	static constexpr uint64_t MAX_VALUE = (uint64_t(1)<<61)-1;
+
 	VarIntRef(VarInt* var_vi, uint64_t x);
-	VarIntRef(VarInt const* vi): vi(vi), size((vi->first>>5) & 7) {};
+	VarIntRef(VarInt const* vi): vi(vi), size(((vi->first>>5) & 7)+1) {};
 	VarIntRef(char const* vi): VarIntRef(reinterpret_cast<VarInt const*>(vi)) {};
 	uint64_t value() const;
+
+	static uint64_t load_le(char const* p) {
+		uint64_t w;
+		std::memcpy(&w, p, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__==__ORDER_BIG_ENDIAN__
+		w = __builtin_bswap64(w);
+#endif
+		return w;
+	}
+
+	static void store_le(char* p, uint64_t w) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__==__ORDER_BIG_ENDIAN__
+		w = __builtin_bswap64(w);
+#endif
+		std::memcpy(p, &w, 8);
+	}
+
+	static size_t encoded_size(uint64_t x) {
+		//bits past the first 5, rounded up to bytes
+		return std::min<size_t>((64-__builtin_clzll(x|1)+2)/8+1, 8);
+	}
+
+	//without branching on the size, but writes 8 bytes at out whatever the size, which it returns
+	static size_t encode_wide(char* out, uint64_t x) {
+		assert(x<=MAX_VALUE);
+		x &= MAX_VALUE;
+		size_t size = encoded_size(x);
+		store_le(out, (x&31) | ((size-1)<<5) | ((x>>5)<<8));
+		return size;
+	}
+
+	//reads 8 bytes at in whatever the size, which it returns
+	static size_t decode_wide(char const* in, uint64_t& x) {
+		uint64_t w = load_le(in);
+		size_t size = ((w>>5)&7)+1;
+		w &= ~uint64_t(0)>>(64-8*size);
+		x = (w&31) | ((w>>8)<<5);
+		return size;
+	}
+
+	//n values (up to MAX_VALUE) into out, which needs room for 8 bytes each. returns the bytes written
+	static size_t encode_many(uint64_t const* in, size_t n, char* out);
+	//n VarInts from the len bytes at in into out. returns the bytes they took, or nothing if in runs out first
+	static std::optional<size_t> decode_many(char const* in, size_t len, uint64_t* out, size_t n);
 };
 
 std::string read_file(const char* path);
@@ -297,9 +354,38 @@ static void html_local_set(char const* name, char const* val) {
 
 size_t binomial(size_t n, size_t k);
 
+//a hex digit's value (either case), 0 if it isn't one
 char hexchar(char hex);
+//two uppercase digits
 void charhex(unsigned char chr, char* out);
 
+//2*len uppercase digits into out
+void hex_encode(char const* src, size_t len, char* out);
+//len/2 bytes into out. false if len is odd or a character isn't a hex digit
+bool hex_decode(char const* src, size_t len, char* out);
+
+//Url is the url and filename safe alphabet of rfc 4648, with - and _ for + and /
+enum class Base64 { Standard, Url };
+
+//with padding
+constexpr size_t base64_encoded_size(size_t len) {
+	return (len+2)/3*4;
+}
+
+//room decoding len characters needs
+constexpr size_t base64_decoded_max(size_t len) {
+	return (len+3)/4*3;
+}
+
+//writes base64_encoded_size(len) characters into out (fewer without padding) and returns how many
+size_t base64_encode(char const* src, size_t len, char* out, Base64 alphabet=Base64::Standard, bool pad=true);
+//decodes padded or unpadded input into out, which needs base64_decoded_max(len) bytes. returns the bytes written, or
+//nothing if src isn't base64 in that alphabet
+std::optional<size_t> base64_decode(char const* src, size_t len, char* out, Base64 alphabet=Base64::Standard);
+
+std::string base64_encode(std::string_view src, Base64 alphabet=Base64::Standard, bool pad=true);
+std::optional<std::string> base64_decode(std::string_view src, Base64 alphabet=Base64::Standard);
+
 //for constructing an overloaded lambda
 //eg. overloaded {
 //            [](auto arg) { std::cout << arg << ' '; },
@@ -0,0 +1,103 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "arena.hpp"
+#include "map.hpp"
+
+using namespace std::chrono;
+
+std::string const REQUEST =
+	"Host: example.com\r\n"
+	"User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:109.0) Gecko/20100101 Firefox/115.0\r\n"
+	"Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+	"Accept-Language: en-US,en;q=0.5\r\n"
+	"Accept-Encoding: gzip, deflate, br\r\n"
+	"Connection: keep-alive\r\n"
+	"Cookie: session=8f2a9c1e; theme=dark; lang=en; tz=UTC; seen=1\r\n"
+	"Upgrade-Insecure-Requests: 1\r\n"
+	"Sec-Fetch-Dest: document\r\n"
+	"Sec-Fetch-Mode: navigate\r\n"
+	"Sec-Fetch-Site: none\r\n"
+	"Sec-Fetch-User: ?1\r\n"
+	"Content-Type: multipart/form-data; boundary=----abc; charset=utf-8\r\n"
+	"Content-Length: 1234\r\n"
+	"\r\n";
+
+//what Request builds per header: the value and its ;-separated parameters
+template<template<class> class Allocator>
+struct Header {
+	std::string_view val;
+	std::vector<std::string_view, Allocator<std::string_view>> extra;
+};
+
+//parses the header block into a Map of headers the way the server does, minus the copies into std::string.
+//returns something derived from the result so it isn't optimized out
+template<template<class> class Allocator, class Alloc>
+size_t parse(std::string_view req, Alloc alloc) {
+	Map<std::string_view, Header<Allocator>, false, Allocator> headers{Allocator<std::pair<std::string_view, Header<Allocator>>>(alloc)};
+
+	while (true) {
+		size_t eol = req.find("\r\n");
+		std::string_view line = req.substr(0, eol);
+		req.remove_prefix(eol+2);
+		if (line.empty()) break;
+
+		size_t colon = line.find(':');
+		std::string_view name = line.substr(0, colon), rest = line.substr(colon+2);
+
+		Header<Allocator> hdr {.val=rest.substr(0, rest.find(';')), .extra=decltype(Header<Allocator>::extra)(alloc)};
+		for (size_t semi=rest.find(';'); semi!=std::string_view::npos;) {
+			rest.remove_prefix(semi+1);
+			semi = rest.find(';');
+			hdr.extra.push_back(rest.substr(0, semi));
+		}
+
+		headers.insert(name, std::move(hdr));
+	}
+
+	return headers.count + (*headers["Cookie"]).extra.size();
+}
+
+template<class F>
+double time_per_op(size_t n, F f) {
+	time_point tp = high_resolution_clock::now();
+	f();
+	return static_cast<double>(duration_cast<nanoseconds>(high_resolution_clock::now()-tp).count())/n;
+}
+
+int main(int argc, char** argv) {
+	size_t n = argc>1 ? std::stoul(argv[1]) : 1000000;
+	size_t sum=0;
+
+	double heap_ns = time_per_op(n, [&]() {
+		for (size_t i=0; i<n; i++) sum += parse<std::allocator>(REQUEST, std::allocator<char>());
+	});
+
+	//one arena per connection, reset after every request
+	Arena arena;
+	double arena_ns = time_per_op(n, [&]() {
+		for (size_t i=0; i<n; i++) {
+			sum += parse<ArenaAllocator>(REQUEST, ArenaAllocator<char>(arena));
+			arena.reset();
+		}
+	});
+
+	Pool pool;
+	double pool_ns = time_per_op(n, [&]() {
+		for (size_t i=0; i<n; i++) {
+			sum += parse<PoolAllocator>(REQUEST, PoolAllocator<char>(pool));
+			pool.reset();
+		}
+	});
+
+	std::cout << "allocator ns_per_request" << std::endl;
+	std::cout << "std::allocator " << heap_ns << std::endl;
+	std::cout << "arena " << arena_ns << std::endl;
+	std::cout << "pool " << pool_ns << std::endl;
+	std::cout << "arena_reserved_bytes " << arena.reserved() << std::endl;
+
+	return sum==0;
+}
@@ -0,0 +1,98 @@
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "arena.hpp"
+#include "map.hpp"
+#include "smallvector.hpp"
+
+int main() {
+	Arena arena(256);
+
+	//alignment is honoured across chunk boundaries, and big blocks get a chunk of their own
+	for (size_t align: {1, 2, 8, 16, 64}) {
+		for (int i=0; i<50; i++) {
+			void* p = arena.allocate(i*3+1, align);
+			assert(reinterpret_cast<uintptr_t>(p)%align==0);
+		}
+	}
+
+	void* big = arena.allocate(10000, 16);
+	assert(big!=nullptr && arena.reserved()>=10000);
+
+	//reset keeps the chunks, so the same work again doesn't grow the arena
+	size_t reserved = arena.reserved();
+	arena.reset();
+	void* again = arena.allocate(1, 1);
+	for (int i=0; i<50; i++) arena.allocate(i*3+1, 8);
+	arena.allocate(10000, 16);
+	assert(arena.reserved()==reserved);
+
+	//the newest block can be given back
+	void* last = arena.allocate(32, 8);
+	arena.deallocate(last, 32);
+	assert(arena.allocate(32, 8)==last);
+
+	arena.release();
+	assert(arena.reserved()==256);
+	assert(arena.allocate(1, 1)==again);
+
+	//freed blocks are reused by their size class
+	Pool pool(1024);
+	void* a = pool.allocate(24, 8);
+	void* b = pool.allocate(20, 4);
+	assert(a!=b);
+	pool.deallocate(a, 24, 8);
+	assert(pool.allocate(32, 8)==a);
+	void* huge = pool.allocate(100000, 16);
+	pool.deallocate(huge, 100000, 16);
+
+	//maps and vectors on an arena, reset between "requests"
+	Arena req(4096);
+	for (int round=0; round<3; round++) {
+		//everything on the arena has to be gone before reset
+		{
+			Map<std::string, int, false, ArenaAllocator> m{ArenaAllocator<std::pair<std::string, int>>(req)};
+			for (int i=0; i<1000; i++) m.insert(std::to_string(i), i);
+			for (int i=0; i<1000; i++) assert(*m[std::to_string(i)]==i);
+
+			Map<std::string, int, false, ArenaAllocator> copy = m;
+			assert(copy.count==1000 && *copy["999"]==999);
+
+			Map<std::string, int, false, ArenaAllocator> moved = std::move(copy);
+			assert(moved.count==1000 && copy.count==0);
+			copy.insert("x", 1);
+			assert(*copy["x"]==1);
+
+			std::vector<int, ArenaAllocator<int>> v{ArenaAllocator<int>(req)};
+			for (int i=0; i<10000; i++) v.push_back(i);
+			assert(v[9999]==9999);
+
+			SmallVector<std::string, 2, ArenaAllocator<std::string>> sv{ArenaAllocator<std::string>(req)};
+			for (int i=0; i<10; i++) sv.push_back(std::to_string(i));
+			assert(sv.size()==10 && sv[7]=="7");
+			SmallVector<std::string, 2, ArenaAllocator<std::string>> sv2 = sv;
+			assert(sv2[9]=="9");
+
+			//containers on different arenas swap their allocators with their storage
+			Arena other(4096);
+			Map<std::string, int, false, ArenaAllocator> there{ArenaAllocator<std::pair<std::string, int>>(other)};
+			there.insert("there", 1);
+			there.swap(moved);
+			assert(*moved["there"]==1 && *there["5"]==5);
+			there.swap(moved);
+
+			//with the Pool, churn recycles freed blocks
+			Pool p(4096);
+			Map<int, int, false, PoolAllocator> pm{PoolAllocator<std::pair<int, int>>(p)};
+			for (int i=0; i<5000; i++) pm.insert(i, i);
+			pm.shrink_to_fit();
+			for (int i=0; i<5000; i++) assert(*pm[i]==i);
+		}
+
+		req.reset();
+	}
+
+	return 0;
+}
@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "arrayset.hpp"
+
+using namespace std::chrono;
+
+template<class F>
+double time_per_op(size_t n, F f) {
+	time_point tp = high_resolution_clock::now();
+	f();
+	return static_cast<double>(duration_cast<nanoseconds>(high_resolution_clock::now()-tp).count())/n;
+}
+
+uint64_t x=0x9E3779B97F4A7C15ull;
+uint64_t next() {
+	x ^= x<<13;
+	x ^= x>>7;
+	x ^= x<<17;
+	return x;
+}
+
+//the old operator[]: copy to a vector, sort descending and sum binomial()s
+size_t old_rank(size_t const* idx, size_t k) {
+	std::vector<size_t> elem_vec(idx, idx+k);
+	std::sort(elem_vec.begin(), elem_vec.end());
+	std::reverse(elem_vec.begin(), elem_vec.end());
+
+	size_t out_i=0;
+	for (size_t i=0; i<k; i++) out_i += binomial(elem_vec[i], k-i);
+	return out_i;
+}
+
+//ns per subset for ranking m random unsorted subsets the old way, with rank(), rank_many() and rank_many_sorted(),
+//and for unrank(). K=0 is the runtime k version
+template<size_t K>
+void ranking(size_t k, size_t n, size_t m, size_t& sum) {
+	Combinations<K> comb(k, n);
+
+	std::vector<size_t> idx;
+	for (size_t i=0; i<m; i++) {
+		size_t e[8];
+		comb.unrank(next()%comb.count(), e);
+		std::shuffle(e, e+k, std::default_random_engine(i));
+		idx.insert(idx.end(), e, e+k);
+	}
+
+	std::vector<size_t> sorted = idx;
+	for (size_t i=0; i<m; i++) std::sort(sorted.begin()+i*k, sorted.begin()+(i+1)*k, std::greater<size_t>());
+
+	std::vector<size_t> out(m);
+
+	double old = time_per_op(m, [&]() {
+		for (size_t i=0; i<m; i++) sum += old_rank(idx.data()+i*k, k);
+	});
+
+	double one = time_per_op(m, [&]() {
+		for (size_t i=0; i<m; i++) sum += comb.rank(idx.data()+i*k);
+	});
+
+	double many = time_per_op(m, [&]() { comb.rank_many(idx.data(), m, out.data()); });
+	sum += out[m/2];
+	double many_sorted = time_per_op(m, [&]() { comb.rank_many_sorted(sorted.data(), m, out.data()); });
+	sum += out[m/3];
+
+	double unrank = time_per_op(m, [&]() {
+		size_t e[8];
+		for (size_t i=0; i<m; i++) {
+			comb.unrank(out[i], e);
+			sum += e[k-1];
+		}
+	});
+
+	std::cout << k << " " << n << " " << (K ? "fixed" : "runtime") << " " << old << " " << one << " " << many << " "
+		<< many_sorted << " " << unrank << std::endl;
+}
+
+template<size_t K>
+void ranking(size_t m, size_t& sum) {
+	for (size_t n: {50, 100, 200}) {
+		ranking<0>(K, n, m, sum);
+		ranking<K>(K, n, m, sum);
+	}
+}
+
+//fills a table with a function of each subset, split into ranges across 1..max_threads threads. ms
+template<size_t K>
+void fill(size_t n, unsigned max_threads, size_t& sum) {
+	ArraySet<uint32_t, K> set(K, n);
+	for (unsigned threads=1; threads<=max_threads; threads*=2) {
+		time_point tp = high_resolution_clock::now();
+
+		std::vector<std::thread> ts;
+		for (auto range: set.split(threads)) {
+			ts.emplace_back([range]() {
+				for (auto [e, v]: range) v = static_cast<uint32_t>(e[0]*31+e[K-1]);
+			});
+		}
+
+		for (std::thread& t: ts) t.join();
+		double ms = static_cast<double>(duration_cast<microseconds>(high_resolution_clock::now()-tp).count())/1000;
+		std::cout << K << " " << n << " " << set.vec.size() << " " << threads << " " << ms << std::endl;
+		sum += set.vec[set.vec.size()/2];
+	}
+}
+
+int main(int argc, char** argv) {
+	size_t m = argc>1 ? std::stoul(argv[1]) : 1000000;
+	unsigned max_threads = argc>2 ? std::stoul(argv[2]) : 8;
+	size_t sum=0;
+
+	std::cout << "k n impl old_ns rank_ns rank_many_ns rank_many_sorted_ns unrank_ns" << std::endl;
+	ranking<3>(m, sum);
+	ranking<4>(m, sum);
+	ranking<5>(m, sum);
+	ranking<6>(m, sum);
+
+	std::cout << "hardware_concurrency " << std::thread::hardware_concurrency() << std::endl;
+	std::cout << "k n entries threads fill_ms" << std::endl;
+	fill<3>(200, max_threads, sum);
+	fill<4>(100, max_threads, sum);
+	fill<5>(60, max_threads, sum);
+	fill<6>(40, max_threads, sum);
+
+	std::cerr << sum << std::endl;
+	return 0;
+}
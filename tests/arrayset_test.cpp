@@ -0,0 +1,77 @@
+#include <cassert>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "arrayset.hpp"
+
+//iterating visits every subset once in rank order, and rank/unrank/rank_many agree with it
+template<size_t K>
+void check(size_t k, size_t n) {
+	ArraySet<size_t, K> set(k, n, 0);
+	assert(set.vec.size()==binomial(n, k));
+
+	size_t i=0;
+	std::set<std::vector<size_t>> seen;
+	std::vector<size_t> flat;
+	for (auto iter=set.begin(); iter!=set.end(); ++iter, i++) {
+		auto [e, v] = *iter;
+		for (size_t j=0; j+1<k; j++) assert(e[j]>e[j+1]);
+		assert(e[0]<n);
+		assert(seen.emplace(e.begin(), e.end()).second);
+
+		assert(set.comb.rank_sorted(e.data())==i);
+		std::vector<size_t> shuffled(e.rbegin(), e.rend());
+		std::swap(shuffled[0], shuffled[k/2]);
+		assert(&set[shuffled.data()]==&v);
+
+		std::vector<size_t> back(k);
+		set.comb.unrank(i, back.data());
+		assert(std::equal(back.begin(), back.end(), e.begin()));
+
+		flat.insert(flat.end(), shuffled.begin(), shuffled.end());
+	}
+
+	assert(i==set.vec.size());
+
+	std::vector<size_t> ranks(i);
+	set.comb.rank_many(flat.data(), i, ranks.data());
+	for (size_t j=0; j<i; j++) assert(ranks[j]==j);
+
+	//disjoint ranges filled from threads cover each entry once
+	for (size_t parts: {1, 3, 7}) {
+		std::vector<std::thread> threads;
+		for (auto range: set.split(parts)) {
+			threads.emplace_back([&set, range]() {
+				for (auto [e, v]: range) v += set.comb.rank_sorted(e.data())+1;
+			});
+		}
+
+		for (std::thread& t: threads) t.join();
+	}
+
+	for (size_t j=0; j<i; j++) assert(set.vec[j]==3*(j+1));
+}
+
+int main() {
+	assert(binomial(5, 2)==10 && binomial(3, 5)==0 && binomial(7, 0)==1 && binomial(7, 7)==1);
+	//the old running product overflowed far below these
+	assert(binomial(67, 33)==14226520737620288370ull);
+	assert(binomial(200, 6)==82408626300ull);
+
+	check<0>(1, 10);
+	check<0>(3, 12);
+	check<2>(2, 30);
+	check<3>(3, 25);
+	check<4>(4, 18);
+	check<6>(6, 14);
+	check<0>(5, 5);
+
+	Combinations<5> big(200);
+	assert(big.count()==binomial(200, 5));
+	size_t e[5];
+	big.unrank(big.count()-1, e);
+	assert(e[0]==199 && e[4]==195 && big.rank_sorted(e)==big.count()-1);
+
+	return 0;
+}
@@ -0,0 +1,87 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "bplustree.hpp"
+#include "btree.hpp"
+
+using namespace std::chrono;
+
+template<class F>
+double time_per_op(size_t n, F f) {
+	time_point tp = high_resolution_clock::now();
+	f();
+	return static_cast<double>(duration_cast<nanoseconds>(high_resolution_clock::now()-tp).count())/n;
+}
+
+//random inserts, lookups of every key in another random order, and a full in order scan. the B+tree also bulk loads.
+//sizes are the arguments (default 1M and 10M), the AVL tree needs ~80 bytes an entry so 100M wants ~8GB for it alone
+int main(int argc, char** argv) {
+	std::vector<size_t> sizes;
+	for (int i=1; i<argc; i++) sizes.push_back(std::stoul(argv[i]));
+	if (sizes.empty()) sizes = {1000000, 10000000};
+
+	uint64_t sum=0;
+	std::cout << "n impl insert_ns find_ns scan_ns_per_entry bulk_load_ns" << std::endl;
+
+	for (size_t n: sizes) {
+		std::vector<uint64_t> keys(n);
+		uint64_t x=0x9E3779B97F4A7C15ull;
+		for (uint64_t& k: keys) {
+			x ^= x<<13;
+			x ^= x>>7;
+			x ^= x<<17;
+			k = x>>1;
+		}
+
+		std::vector<uint64_t> lookups = keys;
+		std::reverse(lookups.begin(), lookups.end());
+
+		{
+			BPlusTree<uint64_t, uint64_t> tree;
+			double ins = time_per_op(n, [&]() {
+				for (uint64_t k: keys) tree.insert(k, k);
+			});
+
+			double find = time_per_op(n, [&]() {
+				for (uint64_t k: lookups) sum += *tree[k];
+			});
+
+			double scan = time_per_op(tree.count, [&]() {
+				for (auto [k, v]: tree) sum += v;
+			});
+
+			std::vector<std::pair<uint64_t, uint64_t>> sorted;
+			sorted.reserve(n);
+			for (auto [k, v]: tree) sorted.emplace_back(k, v);
+
+			double bulk = time_per_op(n, [&]() {
+				tree.bulk_load(sorted.begin(), sorted.end());
+			});
+
+			std::cout << n << " BPlusTree " << ins << " " << find << " " << scan << " " << bulk << std::endl;
+		}
+
+		{
+			Node<uint64_t, uint64_t>::Root tree;
+			double ins = time_per_op(n, [&]() {
+				for (uint64_t k: keys) tree.insert(uint64_t(k), uint64_t(k));
+			});
+
+			double find = time_per_op(n, [&]() {
+				for (uint64_t k: lookups) sum += tree.find(k)->v;
+			});
+
+			size_t entries=0;
+			double scan = time_per_op(n, [&]() {
+				for (auto it=tree.begin(); it!=tree.end(); ++it, entries++) sum += it->v;
+			});
+
+			std::cout << n << " AVL_Node " << ins << " " << find << " " << scan << " -" << std::endl;
+		}
+	}
+
+	std::cerr << sum << std::endl;
+	return 0;
+}
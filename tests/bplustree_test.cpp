@@ -0,0 +1,96 @@
+#include <cassert>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "bplustree.hpp"
+
+//random inserts, replaces and removes checked against std::map, then in order iteration and lower_bound
+template<class Tree, class MakeKey>
+void check(MakeKey make_key, unsigned range) {
+	Tree tree;
+	std::map<decltype(make_key(0)), int> ref;
+
+	uint64_t x = 0x9E3779B97F4A7C15ull;
+	for (int i=0; i<30000; i++) {
+		x ^= x<<13;
+		x ^= x>>7;
+		x ^= x<<17;
+
+		auto k = make_key(x%range);
+		if (x>>62) {
+			auto old = tree.insert(k, i);
+			auto it = ref.find(k);
+			assert(it==ref.end() ? !old : old==it->second);
+			ref[k]=i;
+		} else {
+			auto old = tree.remove(k);
+			auto it = ref.find(k);
+			assert(it==ref.end() ? !old : old==it->second);
+			if (it!=ref.end()) ref.erase(it);
+		}
+
+		assert(tree.count==ref.size());
+		assert(tree[k] ? ref.count(k) && *tree[k]==ref[k] : !ref.count(k));
+	}
+
+	auto it = ref.begin();
+	for (auto [k, v]: tree) {
+		assert(it!=ref.end() && k==it->first && v==it->second);
+		++it;
+	}
+
+	assert(it==ref.end());
+
+	for (unsigned i=0; i<range; i+=7) {
+		auto k = make_key(i);
+		auto a = tree.lower_bound(k);
+		auto b = ref.lower_bound(k);
+		assert(b==ref.end() ? a==tree.end() : a.key()==b->first && a.value()==b->second);
+	}
+
+	//bulk load the same entries, then keep inserting into the packed leaves
+	std::vector<std::pair<decltype(make_key(0)), int>> sorted(ref.begin(), ref.end());
+	tree.bulk_load(sorted.begin(), sorted.end());
+	assert(tree.count==ref.size());
+
+	for (unsigned i=0; i<range; i+=3) {
+		auto k = make_key(i);
+		tree.insert(k, -1);
+		ref[k]=-1;
+	}
+
+	it = ref.begin();
+	for (auto [k, v]: tree) {
+		assert(k==it->first && v==it->second);
+		++it;
+	}
+
+	assert(it==ref.end() && tree.count==ref.size());
+}
+
+int main() {
+	check<BPlusTree<uint64_t, int, 4>>([](unsigned i) { return uint64_t(i)*0x100000001ull; }, 3000);
+	check<BPlusTree<uint64_t, int>>([](unsigned i) { return uint64_t(i)<<40; }, 20000);
+	//negative keys and unsigned keys with the top bit set go through the sign flip
+	check<BPlusTree<int32_t, int, 8>>([](unsigned i) { return static_cast<int32_t>(i)-1500; }, 3000);
+	check<BPlusTree<uint32_t, int, 16>>([](unsigned i) { return 0xFFFFFFFFu-i*3; }, 3000);
+	check<BPlusTree<int64_t, int, 12>>([](unsigned i) { return (static_cast<int64_t>(i)-1500)*1000000007ll; }, 3000);
+	check<BPlusTree<std::string, int, 6>>([](unsigned i) { return std::to_string(i); }, 3000);
+
+	BPlusTree<int, int, 4> empty;
+	assert(empty.begin()==empty.end() && !empty[3] && empty.lower_bound(1)==empty.end());
+
+	std::vector<std::pair<int, int>> seq;
+	for (int i=0; i<100000; i++) seq.emplace_back(i*2, i);
+	BPlusTree<int, int, 8> packed;
+	packed.bulk_load(seq.begin(), seq.end(), 6);
+	assert(packed.count==seq.size() && *packed[1000]==500 && !packed[1001]);
+	assert(packed.lower_bound(1001).key()==1002);
+
+	BPlusTree<int, int, 8> moved(std::move(packed));
+	assert(moved.count==seq.size() && packed.count==0 && packed.begin()==packed.end());
+
+	return 0;
+}
@@ -0,0 +1,74 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "btree.hpp"
+
+using namespace std::chrono;
+
+//resident memory in bytes, 0 where /proc isn't there
+size_t resident() {
+#ifdef __linux__
+	std::ifstream statm("/proc/self/statm");
+	size_t size=0, rss=0;
+	statm >> size >> rss;
+	return rss*4096;
+#else
+	return 0;
+#endif
+}
+
+//fills a tree to n entries, then removes a random entry and inserts a new one churn times so every insert allocates
+//and every remove frees. prints the fill and churn ns per op and resident bytes per entry after filling
+template<class N>
+void run(char const* name, size_t n, size_t churn, uint64_t& sum) {
+	uint64_t x=0x9E3779B97F4A7C15ull;
+	auto next = [&]() {
+		x ^= x<<13;
+		x ^= x>>7;
+		x ^= x<<17;
+		return x;
+	};
+
+	std::vector<uint64_t> keys(n);
+	for (uint64_t& k: keys) k = next();
+
+	size_t before = resident();
+	typename N::Root tree;
+
+	time_point tp = high_resolution_clock::now();
+	for (uint64_t k: keys) tree.insert(uint64_t(k), uint64_t(k));
+	double fill = static_cast<double>(duration_cast<nanoseconds>(high_resolution_clock::now()-tp).count())/n;
+
+	size_t after = resident();
+
+	tp = high_resolution_clock::now();
+	for (size_t i=0; i<churn; i++) {
+		uint64_t& k = keys[next()%n];
+		sum += tree.find(k)->remove()->v;
+		k = next();
+		tree.insert(uint64_t(k), uint64_t(k));
+	}
+
+	double ns = static_cast<double>(duration_cast<nanoseconds>(high_resolution_clock::now()-tp).count())/churn;
+	std::cout << name << " " << n << " " << fill << " " << ns << " "
+		<< static_cast<double>(after-before)/n << " " << sizeof(N) << std::endl;
+}
+
+//arguments are n, churn and which of malloc/pooled to run. the freed memory of the first run gets reused by the
+//second, so compare memory between separate runs
+int main(int argc, char** argv) {
+	size_t n = argc>1 ? std::stoul(argv[1]) : 1000000;
+	size_t churn = argc>2 ? std::stoul(argv[2]) : 2000000;
+	std::string impl = argc>3 ? argv[3] : "both";
+
+	uint64_t sum=0;
+	std::cout << "impl n fill_ns churn_ns_per_remove_insert rss_bytes_per_entry sizeof_node" << std::endl;
+	if (impl!="pooled") run<Node<uint64_t, uint64_t>>("malloc", n, churn, sum);
+	if (impl!="malloc") run<Node<uint64_t, uint64_t, NoAggregate, false, true>>("pooled", n, churn, sum);
+
+	std::cerr << sum << std::endl;
+	return 0;
+}
@@ -0,0 +1,64 @@
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "btree.hpp"
+
+using namespace std::chrono;
+
+template<class F>
+double time_per_op(size_t n, F f) {
+	time_point tp = high_resolution_clock::now();
+	f();
+	return static_cast<double>(duration_cast<nanoseconds>(high_resolution_clock::now()-tp).count())/n;
+}
+
+//percentile queries: stepping an iterator k times on a plain tree vs select() and range sums on a sized one,
+//plus what keeping sizes and sums costs inserts
+int main(int argc, char** argv) {
+	size_t max_n = argc>1 ? std::stoul(argv[1]) : 1000000;
+	//stepping is O(n) a query, so it gets fewer
+	const size_t queries=1000, step_queries=100;
+	unsigned long sum=0;
+
+	std::cout << "n plain_insert_ns sized_insert_ns step_percentile_ns select_percentile_ns range_sum_ns" << std::endl;
+
+	for (size_t n=1000; n<=max_n; n*=10) {
+		std::vector<uint64_t> keys(n);
+		uint64_t x=0x9E3779B97F4A7C15ull;
+		for (uint64_t& k: keys) {
+			x ^= x<<13;
+			x ^= x>>7;
+			x ^= x<<17;
+			k = x>>1;
+		}
+
+		Node<uint64_t, uint64_t>::Root plain;
+		Node<uint64_t, uint64_t, SumAggregate<uint64_t>, true>::Root sized;
+
+		double plain_ins = time_per_op(n, [&]() {
+			for (uint64_t k: keys) plain.insert(uint64_t(k), uint64_t(k));
+		});
+
+		double sized_ins = time_per_op(n, [&]() {
+			for (uint64_t k: keys) sized.insert(uint64_t(k), uint64_t(k));
+		});
+
+		double step = time_per_op(step_queries, [&]() {
+			for (size_t q=0; q<step_queries; q++) sum += (plain.begin()+static_cast<unsigned>(n*q/step_queries))->v;
+		});
+
+		double select = time_per_op(queries, [&]() {
+			for (size_t q=0; q<queries; q++) sum += sized.select(n*q/queries)->v;
+		});
+
+		double range = time_per_op(queries, [&]() {
+			for (size_t q=0; q<queries; q++) sum += sized.range_aggregate(keys[q], keys[q]+(UINT64_MAX>>4));
+		});
+
+		std::cout << n << " " << plain_ins << " " << sized_ins << " " << step << " " << select << " " << range << std::endl;
+	}
+
+	std::cerr << sum << std::endl;
+	return 0;
+}
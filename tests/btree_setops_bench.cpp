@@ -0,0 +1,73 @@
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "btree.hpp"
+
+using namespace std::chrono;
+
+using Tree = Node<uint64_t, uint64_t>;
+
+template<class F>
+double time_ms(F f) {
+	time_point tp = high_resolution_clock::now();
+	f();
+	return static_cast<double>(duration_cast<microseconds>(high_resolution_clock::now()-tp).count())/1000;
+}
+
+//every other key of 0..2n, and every third, so the two sets overlap by a third
+std::vector<std::pair<uint64_t, uint64_t>> keys(size_t n, uint64_t step) {
+	std::vector<std::pair<uint64_t, uint64_t>> ret;
+	for (uint64_t i=0; i<n; i++) ret.emplace_back(i*step, i);
+	return ret;
+}
+
+//building from sorted input vs inserting one by one, then union/intersection of two n entry trees by split and join
+//vs inserting one into the other, at 1 to max_threads threads. times are ms
+int main(int argc, char** argv) {
+	size_t n = argc>1 ? std::stoul(argv[1]) : 1000000;
+	unsigned max_threads = argc>2 ? std::stoul(argv[2]) : 8;
+	std::cout << "hardware_concurrency " << std::thread::hardware_concurrency() << std::endl;
+
+	{
+		auto a = keys(n, 2);
+		Tree::Root built, inserted;
+		double b = time_ms([&]() { built.build(a.begin(), a.end()); });
+		double i = time_ms([&]() {
+			for (auto& [k, v]: keys(n, 2)) inserted.insert(uint64_t(k), uint64_t(v));
+		});
+
+		std::cout << "build_ms " << b << " insert_each_ms " << i << std::endl;
+	}
+
+	{
+		Tree::Root a, b;
+		auto ka = keys(n, 2), kb = keys(n, 3);
+		a.build(ka.begin(), ka.end());
+		b.build(kb.begin(), kb.end());
+
+		double t = time_ms([&]() {
+			for (auto iter=b.begin(); iter!=b.end(); ++iter) {
+				if (a.find(iter->x)->x!=iter->x) a.insert(uint64_t(iter->x), uint64_t(iter->v));
+			}
+		});
+
+		std::cout << "union_by_insert_ms " << t << std::endl;
+	}
+
+	std::cout << "threads union_ms intersection_ms" << std::endl;
+	for (unsigned threads=1; threads<=max_threads; threads*=2) {
+		Tree::Root a, b, c, d;
+		auto ka = keys(n, 2), kb = keys(n, 3), kc = keys(n, 2), kd = keys(n, 3);
+		a.build(ka.begin(), ka.end());
+		b.build(kb.begin(), kb.end());
+		c.build(kc.begin(), kc.end());
+		d.build(kd.begin(), kd.end());
+
+		double u = time_ms([&]() { a.set_union(b, threads); });
+		double i = time_ms([&]() { c.set_intersection(d, threads); });
+		std::cout << threads << " " << u << " " << i << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,223 @@
+#include <cassert>
+#include <algorithm>
+#include <map>
+#include <numeric>
+#include <vector>
+
+#include "btree.hpp"
+
+using SumNode = Node<int, long, SumAggregate<long>, true>;
+using PooledNode = Node<int, long, SumAggregate<long>, true, true>;
+
+//recomputes sizes, sums and heights from scratch, checking every node's stored ones. returns the height
+template<class N>
+int check(N* n, N* parent=nullptr) {
+	if (!n) return 0;
+	assert(n->parent==parent);
+
+	int l = check(n->left.get(), n), r = check(n->right.get(), n);
+	assert(n->h_diff==r-l);
+	assert(n->size==1+N::size_of(n->left.get())+N::size_of(n->right.get()));
+	assert(n->agg==N::agg_of(n->left.get())+n->v+N::agg_of(n->right.get()));
+	return std::max(l, r)+1;
+}
+
+int main() {
+	SumNode::Root root;
+	std::map<int, long> ref;
+	std::vector<std::unique_ptr<SumNode>> removed;
+
+	uint64_t x = 0x9E3779B97F4A7C15ull;
+	auto next = [&]() {
+		x ^= x<<13;
+		x ^= x>>7;
+		x ^= x<<17;
+		return x;
+	};
+
+	for (int i=0; i<20000; i++) {
+		int k = next()%2000;
+		unsigned op = next()%8;
+
+		if (op<4) {
+			if (!ref.count(k)) {
+				root.insert(int(k), long(i));
+				ref[k]=i;
+			}
+		} else if (op<7) {
+			if (ref.count(k)) {
+				removed.push_back(root.find(k)->remove());
+				assert(removed.back()->size==1 && removed.back()->agg==removed.back()->v);
+				ref.erase(k);
+			}
+		} else if (ref.size()>=2) {
+			//swap two entries' positions and then their keys, which moves the values between keys
+			auto a = ref.lower_bound(k);
+			if (a==ref.end()) a=ref.begin();
+			auto b = std::next(a)==ref.end() ? ref.begin() : std::next(a);
+
+			SumNode* na = root.find(a->first);
+			SumNode* nb = root.find(b->first);
+			na->swap_positions(nb);
+			std::swap(na->x, nb->x);
+			std::swap(a->second, b->second);
+		}
+
+		if (i%500==0) check(root.ptr.get());
+	}
+
+	check(root.ptr.get());
+	assert(root.ptr->size==ref.size());
+
+	std::vector<std::pair<int, long>> sorted(ref.begin(), ref.end());
+	for (size_t i=0; i<sorted.size(); i++) {
+		SumNode* n = root.select(i);
+		assert(n && n->x==sorted[i].first && n->v==sorted[i].second);
+		assert(root.rank(sorted[i].first)==i);
+		assert(root.iter_ref(n).current==(root.begin()+i).current);
+	}
+
+	assert(!root.select(sorted.size()) && root.begin()+sorted.size()==root.end());
+	assert(root.rank(-1)==0 && root.rank(1000000)==sorted.size());
+
+	for (int i=0; i<3000; i++) {
+		int lo = next()%2100-50, hi = next()%2100-50;
+		long sum=0;
+		for (auto& [k, v]: sorted) if (k>=lo && k<hi) sum+=v;
+		assert(root.range_aggregate(lo, hi)==sum);
+	}
+
+	//editing a value in place
+	SumNode* n = root.select(sorted.size()/2);
+	n->v += 1000;
+	n->update_path();
+	check(root.ptr.get());
+
+	//O(n) build, then split and join back at random keys
+	std::vector<std::pair<int, long>> built;
+	for (int i=0; i<5000; i++) built.emplace_back(i*3, i);
+
+	SumNode::Root tree;
+	tree.build(built.begin(), built.end());
+	check(tree.ptr.get());
+	assert(tree.ptr->size==5000 && tree.range_aggregate(0, 15000)==5000l*4999/2);
+
+	for (int i=0; i<200; i++) {
+		int key = next()%15100;
+		SumNode::Root right;
+		tree.split(key, right);
+		check(tree.ptr.get());
+		check(right.ptr.get());
+
+		size_t below = (key+2)/3;
+		assert(SumNode::size_of(tree.ptr.get())==std::min<size_t>(below, 5000));
+		assert(!right.ptr || right.begin()->x>=key);
+		assert(!tree.ptr || (tree.end()-1)->x<key);
+
+		if (i%2) {
+			tree.join(right);
+		} else if (right.ptr) {
+			//through a detached middle node
+			std::unique_ptr<SumNode> mid = right.begin()->remove();
+			tree.join(std::move(mid), right);
+		} else {
+			tree.join(right);
+		}
+
+		check(tree.ptr.get());
+		assert(!right.ptr && tree.ptr->size==5000);
+	}
+
+	for (int i=0; i<5000; i++) assert(tree.select(i)->x==i*3 && tree.select(i)->v==i);
+
+	//union and intersection of random sets, single and multi threaded, against std::map
+	for (unsigned threads: {1u, 4u}) {
+		for (int round=0; round<6; round++) {
+			std::map<int, long> a, b;
+			size_t na = next()%40000, nb = round%3==0 ? 10 : next()%40000;
+			for (size_t i=0; i<na; i++) a.emplace(next()%100000, 1);
+			for (size_t i=0; i<nb; i++) b.emplace(next()%100000, 2);
+
+			std::vector<std::pair<int, long>> va(a.begin(), a.end()), vb(b.begin(), b.end());
+			SumNode::Root ta, tb, ia, ib;
+			ta.build(va.begin(), va.end());
+			tb.build(vb.begin(), vb.end());
+			ia.build(va.begin(), va.end());
+			ib.build(vb.begin(), vb.end());
+
+			ta.set_union(tb, threads);
+			ia.set_intersection(ib, threads);
+			check(ta.ptr.get());
+			check(ia.ptr.get());
+			assert(!tb.ptr && !ib.ptr);
+
+			std::map<int, long> u = a, in;
+			u.insert(b.begin(), b.end());
+			for (auto& [k, v]: a) if (b.count(k)) in.emplace(k, v);
+
+			auto it = u.begin();
+			for (auto n=ta.begin(); n!=ta.end(); ++n, ++it) assert(n->x==it->first && n->v==it->second);
+			assert(it==u.end());
+
+			it = in.begin();
+			for (auto n=ia.begin(); n!=ia.end(); ++n, ++it) assert(n->x==it->first && n->v==it->second);
+			assert(it==in.end());
+		}
+	}
+
+	//pooled nodes: churn that reuses freed slots, nodes outliving their Root and moving between Roots' pools
+	{
+		std::vector<PooledNode::Ptr> kept;
+		std::map<int, long> pref;
+		PooledNode::Root a;
+
+		for (int i=0; i<50000; i++) {
+			int k = next()%3000;
+			if (next()%2) {
+				if (!pref.count(k)) {
+					a.insert(int(k), long(i));
+					pref[k]=i;
+				}
+			} else if (pref.count(k)) {
+				PooledNode::Ptr n = a.find(k)->remove();
+				if (i%100==0) kept.push_back(std::move(n));
+				pref.erase(k);
+			}
+		}
+
+		check(a.ptr.get());
+		assert(a.ptr->size==pref.size() && a.ptr->agg==std::accumulate(pref.begin(), pref.end(), 0l,
+			[](long s, auto& kv) { return s+kv.second; }));
+
+		std::vector<std::pair<int, long>> vb;
+		for (int i=0; i<4000; i++) vb.emplace_back(i*2+1, 5);
+
+		{
+			PooledNode::Root b;
+			b.build(vb.begin(), vb.end());
+			a.set_union(b, 4);
+			assert(!b.ptr);
+		}
+
+		for (auto& [k, v]: vb) pref.emplace(k, v);
+		check(a.ptr.get());
+
+		PooledNode::Root right;
+		a.split(3000, right);
+		for (int i=0; i<1000; i++) right.insert(int(10000+i), long(i));
+		a.join(right);
+		for (int i=0; i<1000; i++) pref[10000+i]=i;
+
+		check(a.ptr.get());
+		auto it = pref.begin();
+		for (auto n=a.begin(); n!=a.end(); ++n, ++it) assert(n->x==it->first && n->v==it->second);
+		assert(it==pref.end());
+	}
+
+	//plain nodes are unchanged and still step their iterators
+	Node<int, int>::Root plain;
+	for (int i=0; i<100; i++) plain.insert(int(i), int(i));
+	assert((plain.begin()+42)->x==42);
+
+	return 0;
+}
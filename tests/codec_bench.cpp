@@ -0,0 +1,178 @@
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "util.hpp"
+
+using namespace std::chrono;
+
+//best of 3
+template<class F>
+double time_ms(F f) {
+	double best=0;
+	for (int i=0; i<3; i++) {
+		time_point tp = high_resolution_clock::now();
+		f();
+		double ms = static_cast<double>(duration_cast<microseconds>(high_resolution_clock::now()-tp).count())/1000;
+		if (i==0 || ms<best) best=ms;
+	}
+
+	return best;
+}
+
+//the previous codecs, which repacked bits one field at a time into a malloc'd buffer and decoded with strchr
+char const* OLD_ALPHABET = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+unsigned char* old_bit_reinterpret(unsigned char* src, unsigned inlen, unsigned* outlen, unsigned char inl, unsigned char outl) {
+	*outlen = (inlen*inl)/outl + 1;
+	unsigned char* out = (unsigned char*)malloc(*outlen);
+
+	unsigned char* srccur = src;
+	unsigned char* cur = out;
+	unsigned pos=0;
+
+	*cur=0;
+
+	while (1) {
+		*cur |= (((*srccur<<(pos%inl))&(UCHAR_MAX<<(8-inl)))>>(pos%outl))&(UCHAR_MAX<<(8-outl));
+
+		char incr;
+		if (inl-(pos%inl) > outl-(pos%outl)) {
+			incr = outl-(pos%outl);
+		} else {
+			incr = inl-(pos%inl);
+		}
+
+		if ((pos%outl) + incr >= outl) {
+			cur++;
+			*cur = 0;
+		}
+
+		if ((pos%inl) + incr >= inl) {
+			srccur++;
+			if (srccur-src >= inlen) {
+				pos += incr;
+				break;
+			}
+		}
+
+		pos += incr;
+	}
+
+	*outlen = cur-out + (pos%outl > 0 ? 1 : 0);
+	return out;
+}
+
+char* old_base64_encode(char* src, unsigned len) {
+	unsigned olen;
+	unsigned char* s = old_bit_reinterpret((unsigned char*)src, len, &olen, 8, 6);
+	char* o = (char*)s;
+
+	for (unsigned i=0; i<olen; i++) o[i] = OLD_ALPHABET[s[i]>>2];
+
+	o = (char*)realloc(o, ((len+2)/3)*4 + 1);
+	while ((olen*6)/24 != (len+2)/3) o[olen++] = '=';
+
+	o[olen] = 0;
+	return o;
+}
+
+char* old_base64_decode(char* src, unsigned* len) {
+	unsigned slen = strlen(src);
+	unsigned len_off=0;
+	while (slen>0 && src[slen-1]=='=') {
+		len_off++;
+		slen--;
+	}
+
+	for (unsigned i=0; i<slen; i++) src[i] = (strchr(OLD_ALPHABET, src[i])-OLD_ALPHABET)<<2;
+
+	unsigned char* s = old_bit_reinterpret((unsigned char*)src, slen, len, 6, 8);
+	*len -= len_off;
+	return (char*)s;
+}
+
+//base64 and hex of payloads of each size, old and new, in GB/s of the unencoded bytes. build it with -mssse3 or
+//-mavx2 (see codec_bench_avx2) for the vector kernels
+int main(int argc, char** argv) {
+	size_t total = argc>1 ? std::stoul(argv[1]) : 64<<20;
+
+	uint64_t x = 0x9E3779B97F4A7C15ull;
+	std::vector<char> data(total);
+	for (char& c: data) {
+		x ^= x<<13;
+		x ^= x>>7;
+		x ^= x<<17;
+		c = static_cast<char>(x);
+	}
+
+	uint64_t sum=0;
+	std::cout << "payload old_enc old_dec enc dec url_enc url_dec hex_enc hex_dec (GB/s)" << std::endl;
+
+	for (size_t payload: {size_t(64), size_t(1024), size_t(64*1024), total}) {
+		size_t count = total/payload;
+		std::vector<char> enc(count*(base64_encoded_size(payload)+1)), dec(count*payload+base64_decoded_max(base64_encoded_size(payload)));
+		std::vector<char> hex(2*total);
+		size_t enc_len = base64_encoded_size(payload);
+
+		auto gbs = [&](double ms) { return static_cast<double>(count*payload)/ms/1e6; };
+
+		//the old decode overwrites its input, so it gets a copy of each payload's encoding
+		std::vector<char> old_enc(count*(enc_len+1));
+		double old_e = time_ms([&]() {
+			for (size_t i=0; i<count; i++) {
+				char* o = old_base64_encode(data.data()+i*payload, payload);
+				std::memcpy(old_enc.data()+i*(enc_len+1), o, enc_len+1);
+				free(o);
+			}
+		});
+
+		std::vector<char> scratch(enc_len+1);
+		double old_d = time_ms([&]() {
+			for (size_t i=0; i<count; i++) {
+				std::memcpy(scratch.data(), old_enc.data()+i*(enc_len+1), enc_len+1);
+				unsigned len;
+				char* o = old_base64_decode(scratch.data(), &len);
+				sum += static_cast<unsigned char>(o[len/2]);
+				free(o);
+			}
+		});
+
+		double results[6];
+		Base64 alphabets[] = {Base64::Standard, Base64::Url};
+		for (int a=0; a<2; a++) {
+			results[2*a] = time_ms([&]() {
+				for (size_t i=0; i<count; i++) base64_encode(data.data()+i*payload, payload, enc.data()+i*enc_len, alphabets[a]);
+			});
+
+			if (a==0 && std::memcmp(enc.data(), old_enc.data(), enc_len)!=0) std::cerr << "encodings differ" << std::endl;
+
+			results[2*a+1] = time_ms([&]() {
+				for (size_t i=0; i<count; i++) {
+					sum += *base64_decode(enc.data()+i*enc_len, enc_len, dec.data()+i*payload, alphabets[a]);
+				}
+			});
+
+			if (std::memcmp(dec.data(), data.data(), count*payload)!=0) std::cerr << "decoded wrong" << std::endl;
+		}
+
+		results[4] = time_ms([&]() {
+			for (size_t i=0; i<count; i++) hex_encode(data.data()+i*payload, payload, hex.data()+2*i*payload);
+		});
+
+		results[5] = time_ms([&]() {
+			for (size_t i=0; i<count; i++) sum += hex_decode(hex.data()+2*i*payload, 2*payload, dec.data()+i*payload);
+		});
+
+		std::cout << payload << " " << gbs(old_e) << " " << gbs(old_d);
+		for (double r: results) std::cout << " " << gbs(r);
+		std::cout << std::endl;
+	}
+
+	std::cerr << sum << std::endl;
+	return 0;
+}
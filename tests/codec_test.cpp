@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "util.hpp"
+
+uint64_t rng = 0x9E3779B97F4A7C15ull;
+
+uint64_t next_rand() {
+	rng ^= rng<<13;
+	rng ^= rng>>7;
+	rng ^= rng<<17;
+	return rng;
+}
+
+//a bit at a time, straight from rfc 4648
+std::string reference_base64(std::string const& src, Base64 alphabet, bool pad) {
+	std::string chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789";
+	chars += alphabet==Base64::Url ? "-_" : "+/";
+
+	std::string out;
+	unsigned acc=0, bits=0;
+	for (unsigned char c: src) {
+		acc = acc<<8 | c;
+		bits += 8;
+		while (bits>=6) {
+			bits -= 6;
+			out += chars[(acc>>bits)&63];
+		}
+	}
+
+	if (bits) out += chars[(acc<<(6-bits))&63];
+	while (pad && out.size()%4) out += '=';
+	return out;
+}
+
+//exactly len bytes on the heap, so sanitizers catch reads and writes past the end
+std::unique_ptr<char[]> exact(std::string const& s, size_t len) {
+	std::unique_ptr<char[]> ret(new char[len ? len : 1]);
+	std::memcpy(ret.get(), s.data(), std::min(s.size(), len));
+	return ret;
+}
+
+int main() {
+	char const* vectors[][2] = {{"", ""}, {"f", "Zg=="}, {"fo", "Zm8="}, {"foo", "Zm9v"}, {"foob", "Zm9vYg=="},
+	                            {"fooba", "Zm9vYmE="}, {"foobar", "Zm9vYmFy"}};
+	for (auto [plain, enc]: vectors) {
+		assert(base64_encode(plain)==enc);
+		assert(base64_decode(enc)==std::string(plain));
+	}
+
+	assert(base64_encode("\xfb\xff", Base64::Url)=="-_8=" && base64_encode("\xfb\xff")=="+/8=");
+	assert(base64_decode("-_8", Base64::Url)==std::string("\xfb\xff") && !base64_decode("-_8="));
+
+	for (int round=0; round<3000; round++) {
+		//long enough for several vector iterations and every tail
+		size_t len = next_rand()%300;
+		std::string src(len, '\0');
+		for (char& c: src) c = static_cast<char>(next_rand());
+
+		Base64 alphabet = round%2 ? Base64::Url : Base64::Standard;
+		bool pad = round%3!=0;
+		std::string ref = reference_base64(src, alphabet, pad);
+
+		std::unique_ptr<char[]> in = exact(src, len);
+		size_t enc_len = pad ? base64_encoded_size(len) : ref.size();
+		std::unique_ptr<char[]> enc = exact("", enc_len);
+		size_t n = base64_encode(in.get(), len, enc.get(), alphabet, pad);
+		assert(n==ref.size() && std::string(enc.get(), n)==ref);
+
+		std::unique_ptr<char[]> dec_in = exact(ref, ref.size());
+		std::unique_ptr<char[]> dec = exact("", base64_decoded_max(ref.size()));
+		std::optional<size_t> got = base64_decode(dec_in.get(), ref.size(), dec.get(), alphabet);
+		assert(got && std::string(dec.get(), *got)==src);
+
+		//one character outside the alphabet anywhere
+		if (!ref.empty()) {
+			std::string broken = ref;
+			size_t at = next_rand()%broken.size();
+			char const bad[] = {'*', '\n', ' ', '\x80', '\xff', alphabet==Base64::Url ? '+' : '-', '=', '\0'};
+			broken[at] = bad[next_rand()%sizeof(bad)];
+
+			//a = in the last two can be padding
+			bool still_valid = broken[at]=='=' && at+2>=ref.size();
+			if (!still_valid) {
+				std::unique_ptr<char[]> b = exact(broken, broken.size());
+				assert(!base64_decode(b.get(), broken.size(), dec.get(), alphabet));
+			}
+		}
+
+		//hex round trips, in either case
+		std::unique_ptr<char[]> hex = exact("", 2*len);
+		hex_encode(in.get(), len, hex.get());
+		for (size_t i=0; i<len; i++) {
+			char digits[2];
+			charhex(static_cast<unsigned char>(src[i]), digits);
+			assert(hex[2*i]==digits[0] && hex[2*i+1]==digits[1]);
+			assert(hexchar(digits[0])*16+hexchar(digits[1])==static_cast<unsigned char>(src[i]));
+		}
+
+		std::string lower(hex.get(), 2*len);
+		for (char& c: lower) c = static_cast<char>(std::tolower(c));
+
+		std::unique_ptr<char[]> unhex = exact("", len);
+		assert(hex_decode(hex.get(), 2*len, unhex.get()) && std::string(unhex.get(), len)==src);
+		assert(hex_decode(lower.data(), 2*len, unhex.get()) && std::string(unhex.get(), len)==src);
+
+		if (len) {
+			lower[next_rand()%lower.size()] = 'g';
+			assert(!hex_decode(lower.data(), 2*len, unhex.get()));
+			assert(!hex_decode(lower.data(), 2*len-1, unhex.get()));
+		}
+	}
+
+	assert(hexchar('x')==0 && hexchar('f')==15 && hexchar('A')==10);
+	return 0;
+}
@@ -0,0 +1,83 @@
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "concurrentmap.hpp"
+
+using namespace std::chrono;
+
+//what we had before, one Map behind one mutex
+struct GlobalLockMap {
+	std::mutex mtx;
+	Map<unsigned long, unsigned long> map;
+
+	std::optional<unsigned long> get(unsigned long k) {
+		std::lock_guard lock(mtx);
+		unsigned long* v = map[k];
+		return v ? std::make_optional(*v) : std::optional<unsigned long>();
+	}
+
+	void insert(unsigned long k, unsigned long v) {
+		std::lock_guard lock(mtx);
+		map.insert(k, v);
+	}
+};
+
+//90% reads / 10% writes over uniformly random keys, returns million ops per second across all threads
+template<class M>
+double run(M& map, unsigned threads, size_t keys, size_t ops_per_thread) {
+	std::vector<std::thread> workers;
+	std::vector<unsigned long> sums(threads);
+
+	time_point tp = high_resolution_clock::now();
+
+	for (unsigned t=0; t<threads; t++) {
+		workers.emplace_back([&, t]() {
+			//summed locally, neighbouring threads' slots in sums share a cache line
+			unsigned long sum=0;
+			uint64_t x = 0x9E3779B97F4A7C15ull*(t+1);
+			for (size_t i=0; i<ops_per_thread; i++) {
+				x ^= x<<13;
+				x ^= x>>7;
+				x ^= x<<17;
+
+				unsigned long k = x%keys;
+				if (x%10==0) map.insert(k, i);
+				else sum += map.get(k).value_or(0);
+			}
+
+			sums[t]=sum;
+		});
+	}
+
+	for (std::thread& w: workers) w.join();
+
+	double secs = static_cast<double>(duration_cast<nanoseconds>(high_resolution_clock::now()-tp).count())/1e9;
+	return static_cast<double>(threads*ops_per_thread)/secs/1e6;
+}
+
+int main(int argc, char** argv) {
+	unsigned max_threads = argc>1 ? std::stoul(argv[1]) : 32;
+	size_t keys = argc>2 ? std::stoul(argv[2]) : 1000000;
+	size_t ops = argc>3 ? std::stoul(argv[3]) : 2000000;
+
+	ConcurrentMap<unsigned long, unsigned long> sharded(256);
+	GlobalLockMap global;
+	for (size_t k=0; k<keys; k++) {
+		sharded.insert(k, k);
+		global.insert(k, k);
+	}
+
+	std::cout << "hardware_concurrency " << std::thread::hardware_concurrency() << std::endl;
+	std::cout << "threads ConcurrentMap_mops global_mutex_mops" << std::endl;
+
+	for (unsigned threads=1; threads<=max_threads; threads*=2) {
+		double a = run(sharded, threads, keys, ops);
+		double b = run(global, threads, keys, ops);
+		std::cout << threads << " " << a << " " << b << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,65 @@
+#include <cassert>
+#include <string>
+#include <thread>
+#include <vector>
+#include <atomic>
+
+#include "concurrentmap.hpp"
+
+int main() {
+	ConcurrentMap<std::string, int> map(16);
+	assert(map.num_shards()==16);
+
+	const int threads=8, per_thread=5000;
+	std::atomic<int> computed=0;
+	std::vector<std::thread> workers;
+
+	//disjoint inserts, plus every thread racing on the same shared keys
+	for (int t=0; t<threads; t++) {
+		workers.emplace_back([&, t]() {
+			for (int i=0; i<per_thread; i++) {
+				map.insert(std::to_string(t) + ":" + std::to_string(i), i);
+
+				int v = map.compute_if_absent("shared" + std::to_string(i%100), [&]() {
+					computed++;
+					return i%100;
+				});
+
+				assert(v==i%100);
+			}
+		});
+	}
+
+	for (std::thread& w: workers) w.join();
+
+	assert(computed==100);
+	assert(map.size()==threads*per_thread + 100);
+	assert(map.get("3:42")==std::optional<int>(42));
+	assert(map.contains(std::string_view("shared7")));
+
+	size_t visited=0;
+	map.for_each([&](std::string const& k, int const& v) { visited++; });
+	assert(visited==map.size());
+
+	auto removed = map.remove("3:42");
+	assert(removed==std::optional<int>(42));
+	assert(!map.get("3:42"));
+	assert(map.lock_stats().acquisitions>0);
+
+	//exclusive-only stripes take the write lock for reads too
+	ConcurrentMap<int, int, MapHash<int>, SpinLock> spin(8);
+	std::vector<std::thread> spinners;
+	for (int t=0; t<4; t++) {
+		spinners.emplace_back([&, t]() {
+			for (int i=0; i<2000; i++) {
+				spin.insert(t*2000+i, i);
+				assert(spin.get(t*2000+i)==std::optional<int>(i));
+			}
+		});
+	}
+
+	for (std::thread& w: spinners) w.join();
+	assert(spin.size()==8000);
+
+	return 0;
+}
@@ -0,0 +1,116 @@
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "concurrentsortedmap.hpp"
+#include "sortedmap.hpp"
+
+using namespace std::chrono;
+
+//mixed workload over random keys per thread: 50% lookups, 20% inserts, 20% removes and 10% scans of 16 entries.
+//returns millions of operations per second over all threads
+template<class Map>
+double run(unsigned threads, size_t keys, size_t ops_per_thread, Map& map) {
+	std::vector<std::thread> workers;
+	std::vector<unsigned long> sums(threads);
+	time_point tp = high_resolution_clock::now();
+
+	for (unsigned t=0; t<threads; t++) {
+		workers.emplace_back([&, t]() {
+			unsigned long sum=0;
+			uint64_t x = 0x9E3779B97F4A7C15ull*(t+1);
+			for (size_t i=0; i<ops_per_thread; i++) {
+				x ^= x<<13;
+				x ^= x>>7;
+				x ^= x<<17;
+
+				unsigned long k = (x>>8)%keys;
+				switch (x%10) {
+					case 0: case 1: map.insert(k, i); break;
+					case 2: case 3: map.remove(k); break;
+					case 4: sum += map.scan(k, 16); break;
+					default: sum += map.get(k).value_or(0);
+				}
+			}
+
+			sums[t]=sum;
+		});
+	}
+
+	for (std::thread& w: workers) w.join();
+	double secs = static_cast<double>(duration_cast<nanoseconds>(high_resolution_clock::now()-tp).count())/1e9;
+	return static_cast<double>(threads*ops_per_thread)/secs/1e6;
+}
+
+struct LockFree {
+	ConcurrentSortedMap<unsigned long, unsigned long> map;
+
+	void insert(unsigned long k, unsigned long v) { map.insert(k, v); }
+	void remove(unsigned long k) { map.remove(k); }
+	std::optional<unsigned long> get(unsigned long k) { return map.get(k); }
+
+	unsigned long scan(unsigned long k, unsigned n) {
+		unsigned long sum=0;
+		for (auto [key, v]: map.range_from(k)) {
+			sum+=v;
+			if (--n==0) break;
+		}
+
+		return sum;
+	}
+};
+
+struct Locked {
+	std::mutex mtx;
+	SortedMap<unsigned long, unsigned long> map;
+
+	void insert(unsigned long k, unsigned long v) {
+		std::lock_guard lock(mtx);
+		map.insert(k, v);
+	}
+
+	void remove(unsigned long k) {
+		std::lock_guard lock(mtx);
+		map.remove(k);
+	}
+
+	std::optional<unsigned long> get(unsigned long k) {
+		std::lock_guard lock(mtx);
+		unsigned long* v = map[k];
+		return v ? std::make_optional(*v) : std::optional<unsigned long>();
+	}
+
+	unsigned long scan(unsigned long k, unsigned n) {
+		std::lock_guard lock(mtx);
+		unsigned long sum=0;
+		for (auto it=map.lower_bound(k); it!=map.end() && n>0; ++it, n--) sum+=it->second;
+		return sum;
+	}
+};
+
+int main(int argc, char** argv) {
+	unsigned max_threads = argc>1 ? std::stoul(argv[1]) : 16;
+	size_t keys = argc>2 ? std::stoul(argv[2]) : 100000;
+	size_t ops = argc>3 ? std::stoul(argv[3]) : 1000000;
+
+	LockFree lock_free;
+	Locked locked;
+	for (size_t k=0; k<keys; k+=2) {
+		lock_free.insert(k, k);
+		locked.insert(k, k);
+	}
+
+	std::cout << "hardware_concurrency " << std::thread::hardware_concurrency() << std::endl;
+	std::cout << "threads lockfree_mops mutex_sortedmap_mops" << std::endl;
+
+	for (unsigned threads=1; threads<=max_threads; threads*=2) {
+		double a = run(threads, keys, ops, lock_free);
+		double b = run(threads, keys, ops, locked);
+		std::cout << threads << " " << a << " " << b << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,144 @@
+#include <cassert>
+#include <atomic>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "concurrentsortedmap.hpp"
+
+int main() {
+	{
+		//single threaded against std::map
+		ConcurrentSortedMap<int, std::string> map;
+		std::map<int, std::string> ref;
+
+		uint64_t x = 0x9E3779B97F4A7C15ull;
+		for (int i=0; i<20000; i++) {
+			x ^= x<<13;
+			x ^= x>>7;
+			x ^= x<<17;
+
+			int k = x%500;
+			if (x>>62) {
+				auto old = map.insert(k, std::to_string(i));
+				auto it = ref.find(k);
+				assert(it==ref.end() ? !old : old==it->second);
+				ref[k] = std::to_string(i);
+			} else {
+				auto old = map.remove(k);
+				auto it = ref.find(k);
+				assert(it==ref.end() ? !old : old==it->second);
+				if (it!=ref.end()) ref.erase(it);
+			}
+
+			assert(map.size()==ref.size());
+			assert(map.contains(k)==ref.count(k));
+		}
+
+		auto it = ref.lower_bound(100);
+		for (auto [k, v]: map.range(100, 200)) {
+			assert(it!=ref.end() && k==it->first && v==it->second);
+			++it;
+		}
+
+		assert(it==ref.lower_bound(200));
+		assert(map.range(200, 100).begin()==map.range(200, 100).end());
+
+		size_t n=0;
+		for (auto kv: map.all()) {
+			assert(map.get(kv.first)==kv.second);
+			n++;
+		}
+
+		assert(n==ref.size());
+	}
+
+	const int threads=4, per_thread=20000;
+	ConcurrentSortedMap<int, int> map;
+	std::atomic<bool> done=false;
+
+	//scanners check order and bounds while writers churn, and that entries nobody touches are never missed.
+	//keys from -1000000 down are the fighters' below
+	for (int k=0; k<threads*per_thread; k+=1000) map.insert(-1-k, 0);
+
+	std::vector<std::thread> scanners;
+	for (int t=0; t<2; t++) {
+		scanners.emplace_back([&]() {
+			while (!done.load()) {
+				int last=INT32_MIN, stable=0;
+				for (auto [k, v]: map.range(INT32_MIN, threads*per_thread)) {
+					assert(k>last);
+					last=k;
+
+					if (k<=-1000000) continue;
+					if (k<0) stable++;
+					else assert(v==k || v==-k);
+				}
+
+				assert(stable==threads*per_thread/1000);
+			}
+		});
+	}
+
+	//disjoint keys: insert all, replace some, remove the odd ones
+	std::vector<std::thread> writers;
+	for (int t=0; t<threads; t++) {
+		writers.emplace_back([&, t]() {
+			for (int i=t*per_thread; i<(t+1)*per_thread; i++) {
+				auto old = map.insert(i, i);
+				assert(!old);
+			}
+
+			for (int i=t*per_thread; i<(t+1)*per_thread; i+=3) {
+				auto old = map.insert(i, -i);
+				assert(old==i);
+			}
+
+			for (int i=t*per_thread+1; i<(t+1)*per_thread; i+=2) {
+				auto removed = map.remove(i);
+				assert(removed);
+			}
+		});
+	}
+
+	for (std::thread& w: writers) w.join();
+
+	//every thread fighting over the same few keys. every entry is inserted once more than it's removed
+	std::atomic<long> net=0;
+	std::vector<std::thread> fighters;
+	for (int t=0; t<threads; t++) {
+		fighters.emplace_back([&, t]() {
+			uint64_t x = 0x9E3779B97F4A7C15ull*(t+1);
+			long mine=0;
+			for (int i=0; i<per_thread; i++) {
+				x ^= x<<13;
+				x ^= x>>7;
+				x ^= x<<17;
+
+				int k = -1000000-static_cast<int>(x%64);
+				if (x&1) mine += !map.insert(k, 0);
+				else mine -= map.remove(k).has_value();
+			}
+
+			net+=mine;
+		});
+	}
+
+	for (std::thread& w: fighters) w.join();
+	done=true;
+	for (std::thread& s: scanners) s.join();
+
+	size_t fought=0;
+	for ([[maybe_unused]] auto kv: map.range(-1000063, -1000000+1)) fought++;
+	assert(static_cast<long>(fought)==net);
+
+	for (int i=0; i<threads*per_thread; i++) {
+		auto v = map.get(i);
+		if (i%2) assert(!v);
+		else assert(v==(i%per_thread%3==0 ? -i : i));
+	}
+
+	assert(map.size()==fought + threads*per_thread/2 + threads*per_thread/1000);
+	return 0;
+}
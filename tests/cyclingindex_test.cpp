@@ -0,0 +1,115 @@
+#include <cassert>
+#include <thread>
+#include <vector>
+
+#include "cyclingindex.hpp"
+
+int main() {
+	//4 generations over 10 slots
+	CyclingIndex<4> ci(10);
+	for (size_t i=0; i<10; i++) {
+		//generations 0, 1 and 3 get 3, 4 and 3 slots
+		if (i==3) ci.cycle();
+		if (i==7) {
+			ci.cycle();
+			ci.cycle();
+		}
+
+		auto idx = ci.next();
+		assert(idx && *idx==i);
+	}
+
+	auto full = ci.next();
+	assert(!full && ci.live()==10);
+
+	assert(ci.window(0).begin==7 && ci.window(0).end==10);
+	assert(ci.window(1).size()==0 && ci.window(2).begin==3 && ci.window(2).end==7);
+	assert(ci.window(3).begin==0 && ci.window(3).end==3 && ci.window(4).size()==0);
+
+	//dropping generation 0 frees its 3 slots, which wrap around to the start of the buffer
+	ci.cycle();
+	assert(ci.oldest()==3 && ci.window(3).begin==3 && ci.window(3).end==7);
+	for (size_t i=0; i<3; i++) {
+		auto idx = ci.next();
+		assert(idx && *idx==i);
+	}
+
+	full = ci.next();
+	assert(!full);
+
+	//steady state: each generation gets what the dropped one held
+	CyclingIndex<3> steady(30);
+	std::vector<int> owner(30, -1);
+	for (int g=0; g<1000; g++) {
+		for (size_t i=0; i<10; i++) {
+			auto idx = steady.next();
+			assert(idx && (owner[*idx]==-1 || owner[*idx]<=g-3));
+			owner[*idx]=g;
+		}
+
+		if (g>=2) {
+			auto extra = steady.next();
+			assert(!extra);
+		}
+		steady.cycle();
+	}
+
+	CyclingIndex<1> single(5);
+	for (int g=0; g<10; g++) {
+		for (size_t i=0; i<5; i++) {
+			auto idx = single.next();
+			assert(idx);
+		}
+
+		auto extra = single.next();
+		assert(!extra);
+		single.cycle();
+		assert(single.live()==0);
+	}
+
+	//one producer writing its positions into a ring of atomics while readers check every live entry they see
+	constexpr size_t CAP=1024;
+	ConcurrentCyclingIndex<8> cc(CAP);
+	std::vector<std::atomic<uint64_t>> slots(CAP);
+	std::atomic<bool> done(false);
+
+	std::vector<std::thread> readers;
+	for (int r=0; r<3; r++) {
+		readers.emplace_back([&]() {
+			size_t checked=0;
+			while (!done.load(std::memory_order_relaxed) || checked==0) {
+				for (size_t age=0; age<8; age++) {
+					auto w = cc.window(age);
+					assert(w.begin<=w.end && w.end-w.begin<=CAP);
+
+					for (uint64_t p=w.begin; p<w.end; p++) {
+						uint64_t v = slots[cc.index(p)].load(std::memory_order_acquire);
+						if (cc.still_live(p)) {
+							assert(v==p+1);
+							checked++;
+						}
+					}
+				}
+			}
+		});
+	}
+
+	uint64_t written=0;
+	for (int g=0; g<20000; g++) {
+		while (written%97!=96) {
+			auto idx = cc.next();
+			if (!idx) break;
+			slots[*idx].store(cc.pos, std::memory_order_release);
+			written++;
+			if (written%16==0) cc.publish();
+		}
+
+		written++;
+		cc.cycle();
+	}
+
+	done = true;
+	for (std::thread& t: readers) t.join();
+
+	return 0;
+}
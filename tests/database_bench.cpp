@@ -0,0 +1,99 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "database.hpp"
+
+using namespace std::chrono;
+
+template<class F>
+double time_per_op(size_t n, F f) {
+	time_point tp = high_resolution_clock::now();
+	f();
+	return static_cast<double>(duration_cast<nanoseconds>(high_resolution_clock::now()-tp).count())/n;
+}
+
+//rows of a random indexed key and a 16-48 byte string: inserting them, then reading in random order by RowId and by
+//key, once with every extent mapped and once with max_extents mapped (default 4, so 4MB) for the evicting page cache.
+//sizes are the arguments, default 1M rows
+int main(int argc, char** argv) {
+	std::vector<size_t> sizes;
+	for (int i=1; i<argc; i++) sizes.push_back(std::stoul(argv[i]));
+	if (sizes.empty()) sizes = {1000000};
+	size_t small_cache = 4;
+
+	uint64_t x=0x9E3779B97F4A7C15ull;
+	auto rand = [&]() {
+		x ^= x<<13;
+		x ^= x>>7;
+		x ^= x<<17;
+		return x;
+	};
+
+	uint64_t sum=0;
+	std::cout << "n extents insert_ns get_ns find_ns scan_ns_per_row range_ns_per_row" << std::endl;
+
+	for (size_t n: sizes) {
+		char path[] = "/tmp/database_bench_XXXXXX";
+		close(mkstemp(path));
+		unlink(path);
+
+		std::vector<uint64_t> keys(n);
+		std::vector<std::string> payloads(n);
+		for (size_t i=0; i<n; i++) {
+			keys[i] = rand()>>4;
+			payloads[i] = std::string(16+rand()%33, static_cast<char>('a'+i%26));
+		}
+
+		std::vector<Database::RowId> ids(n);
+		double insert;
+		{
+			Database db(path);
+			Database::Table t = db.create_table({Database::ColType::Unsigned, Database::ColType::String});
+			t.index(0);
+
+			insert = time_per_op(n, [&]() {
+				for (size_t i=0; i<n; i++) ids[i] = t.insert({keys[i], std::string_view(payloads[i])});
+			});
+		}
+
+		std::vector<size_t> order(n);
+		for (size_t i=0; i<n; i++) order[i] = rand()%n;
+
+		for (size_t extents: {size_t(1)<<20, small_cache}) {
+			Database db(path, extents);
+			Database::Table t = db.table(0);
+
+			double get = time_per_op(n, [&]() {
+				for (size_t i: order) sum += t.get(ids[i])->get_string(1).size();
+			});
+
+			double find = time_per_op(n, [&]() {
+				for (size_t i: order) sum += t.find(0, keys[i]).size();
+			});
+
+			double scan = time_per_op(n, [&]() {
+				t.scan([&](Database::Row const& row) { sum += row.get_unsigned(0); });
+			});
+
+			double range = time_per_op(n, [&]() {
+				t.range(0, 0, UINT64_MAX, [&](Database::Row const& row) {
+					sum += row.get_unsigned(0);
+					return true;
+				});
+			});
+
+			bool all = extents!=small_cache;
+			std::cout << n << " " << (all ? "all" : std::to_string(extents)) << " " << (all ? std::to_string(insert) : "-")
+			          << " " << get << " " << find << " " << scan << " " << range << std::endl;
+		}
+
+		unlink(path);
+	}
+
+	std::cerr << sum << std::endl;
+	return 0;
+}
@@ -0,0 +1,311 @@
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "database.hpp"
+
+uint64_t rng = 0x9E3779B97F4A7C15ull;
+
+uint64_t next_rand() {
+	rng ^= rng<<13;
+	rng ^= rng>>7;
+	rng ^= rng<<17;
+	return rng;
+}
+
+using Owned = std::variant<uint64_t, std::string>;
+using Model = std::map<Database::RowId, std::vector<Owned>>;
+
+std::vector<Database::ColType> const COLS = {Database::ColType::Unsigned, Database::ColType::String, Database::ColType::Unsigned};
+
+//keys from a small range so they repeat, strings often sharing their first 8 bytes
+std::vector<Owned> random_row() {
+	std::string s = next_rand()%2 ? "prefix__" : "";
+	size_t len = next_rand()%(next_rand()%16==0 ? 1000 : 12);
+	for (size_t i=0; i<len; i++) s += static_cast<char>('a'+next_rand()%3);
+
+	return {next_rand()%500, s, next_rand()>>(3+next_rand()%61)};
+}
+
+std::vector<Database::Value> values(std::vector<Owned> const& row) {
+	std::vector<Database::Value> ret;
+	for (Owned const& o: row) {
+		if (uint64_t const* x = std::get_if<uint64_t>(&o)) ret.emplace_back(*x);
+		else ret.emplace_back(std::string_view(std::get<std::string>(o)));
+	}
+
+	return ret;
+}
+
+bool same(Database::Row const& row, std::vector<Owned> const& want) {
+	return row.get_unsigned(0)==std::get<uint64_t>(want[0]) && row.get_string(1)==std::get<std::string>(want[1])
+	       && row.get_unsigned(2)==std::get<uint64_t>(want[2]);
+}
+
+void check(Database::Table& t, Model const& model) {
+	assert(t.size()==model.size());
+
+	size_t scanned=0;
+	t.scan([&](Database::Row const& row) {
+		assert(model.count(row.id) && same(row, model.at(row.id)));
+		scanned++;
+	});
+	assert(scanned==model.size());
+
+	for (auto const& [id, want]: model) {
+		std::optional<Database::Row> row = t.get(id);
+		assert(row && same(*row, want));
+	}
+
+	//finds through each column's index or by scanning, against the model
+	for (int i=0; i<20 && !model.empty(); i++) {
+		auto it = model.begin();
+		std::advance(it, next_rand()%model.size());
+
+		for (unsigned col=0; col<2; col++) {
+			std::vector<Database::Value> vals = values(it->second);
+			std::vector<Database::RowId> found = t.find(col, vals[col]);
+			std::sort(found.begin(), found.end());
+
+			std::vector<Database::RowId> want;
+			for (auto const& [id, row]: model) if (row[col]==it->second[col]) want.push_back(id);
+			assert(found==want);
+		}
+	}
+
+	if (t.indexed(0)) {
+		uint64_t lo = next_rand()%500, hi = lo+next_rand()%100;
+		std::vector<std::pair<uint64_t, Database::RowId>> got, want;
+		t.range(0, lo, hi, [&](Database::Row const& row) {
+			got.emplace_back(row.get_unsigned(0), row.id);
+			return true;
+		});
+
+		for (auto const& [id, row]: model) {
+			uint64_t k = std::get<uint64_t>(row[0]);
+			if (k>=lo && k<=hi) want.emplace_back(k, id);
+		}
+
+		std::sort(want.begin(), want.end());
+		assert(got==want);
+	}
+}
+
+//inserts and removes at random against the model
+void churn(Database::Table& t, Model& model, int ops, unsigned insert_pct) {
+	for (int i=0; i<ops; i++) {
+		if (model.empty() || next_rand()%100<insert_pct) {
+			std::vector<Owned> row = random_row();
+			Database::RowId id = t.insert(values(row));
+			assert(!model.count(id));
+			model[id] = row;
+		} else {
+			auto it = model.begin();
+			std::advance(it, next_rand()%model.size());
+			bool removed = t.remove(it->first);
+			bool again = t.remove(it->first);
+			assert(removed && !again && !t.get(it->first));
+			model.erase(it);
+		}
+	}
+}
+
+off_t file_size(char const* path) {
+	struct stat st;
+	stat(path, &st);
+	return st.st_size;
+}
+
+int main() {
+	char path[] = "/tmp/database_test_XXXXXX";
+	int fd = mkstemp(path);
+	assert(fd>=0);
+	close(fd);
+	unlink(path);
+
+	Model indexed_model, plain_model;
+
+	{
+		Database db(path);
+		assert(db.tables()==0);
+
+		Database::Table indexed = db.create_table(COLS);
+		Database::Table plain = db.create_table(COLS);
+		assert(db.tables()==2 && indexed.id==0 && plain.id==1 && plain.columns()==COLS);
+
+		//an index made before the rows, one after
+		indexed.index(1);
+		churn(indexed, indexed_model, 3000, 80);
+		indexed.index(0);
+		assert(indexed.indexed(0) && indexed.indexed(1) && !indexed.indexed(2));
+
+		churn(plain, plain_model, 3000, 80);
+		check(indexed, indexed_model);
+		check(plain, plain_model);
+
+		//rows of another table aren't this one's
+		bool removed = plain.remove(indexed_model.begin()->first);
+		assert(!removed && !plain.get(indexed_model.begin()->first));
+		assert(!indexed.get(0) && !indexed.get(uint64_t(1)<<50));
+
+		assert(indexed.get(indexed_model.begin()->first)->get_unsigned(0)==std::get<uint64_t>(indexed_model.begin()->second[0]));
+		bool threw=false;
+		try { indexed.get(indexed_model.begin()->first)->get_string(0); } catch (Database::ColNoExists const&) { threw=true; }
+		assert(threw);
+
+		db.sync();
+	}
+
+	//reopened with one extent mapped at a time, so nearly every page access maps and evicts
+	{
+		Database db(path, 1);
+		assert(db.tables()==2);
+
+		Database::Table indexed = db.table(0), plain = db.table(1);
+		check(indexed, indexed_model);
+		check(plain, plain_model);
+
+		churn(indexed, indexed_model, 3000, 40);
+		churn(plain, plain_model, 3000, 40);
+		check(indexed, indexed_model);
+		check(plain, plain_model);
+	}
+
+	{
+		Database db(path);
+		Database::Table indexed = db.table(0), plain = db.table(1);
+		check(indexed, indexed_model);
+		check(plain, plain_model);
+
+		//emptied blocks are reused, so the same rows again fit in the same file
+		churn(plain, plain_model, static_cast<int>(plain_model.size()), 0);
+		assert(plain.size()==0);
+
+		std::vector<std::vector<Owned>> rows(3000);
+		for (std::vector<Owned>& row: rows) row = random_row();
+
+		off_t filled=0;
+		for (int round=0; round<2; round++) {
+			for (std::vector<Owned> const& row: rows) plain_model[plain.insert(values(row))] = row;
+			check(plain, plain_model);
+
+			if (round==0) filled = file_size(path);
+			else assert(file_size(path)==filled);
+
+			churn(plain, plain_model, static_cast<int>(plain_model.size()), 0);
+		}
+
+		auto throws = [](auto f) {
+			try { f(); } catch (std::exception const&) { return true; }
+			return false;
+		};
+
+		int thrown = throws([&]() { indexed.insert({uint64_t(1), uint64_t(2), uint64_t(3)}); })
+		             + throws([&]() { indexed.insert({uint64_t(1)}); })
+		             + throws([&]() { indexed.insert({uint64_t(1)<<61, std::string_view(""), uint64_t(0)}); });
+		std::string big(Database::PAGE_SIZE, 'x');
+		thrown += throws([&]() { indexed.insert({uint64_t(1), std::string_view(big), uint64_t(0)}); })
+		          + throws([&]() { indexed.find(7, uint64_t(0)); })
+		          + throws([&]() { indexed.range(2, 0, 1, [](Database::Row const&) { return true; }); })
+		          + throws([&]() { db.table(2); });
+		assert(thrown==7 && indexed.size()==indexed_model.size());
+
+		//up to MAX_COLUMNS and MAX_TABLES
+		thrown = throws([&]() { db.create_table(std::vector<Database::ColType>(Database::MAX_COLUMNS+1)); });
+		while (db.tables()<Database::MAX_TABLES) db.create_table({});
+		thrown += throws([&]() { db.create_table({}); });
+		assert(thrown==2);
+
+		//a table of no columns still has rows
+		Database::Table empty = db.table(2);
+		Database::RowId id = empty.insert({});
+		assert(empty.get(id) && empty.get(id)->columns()==0 && empty.size()==1);
+	}
+
+	//enough keys for the index to split inner nodes, in random and in increasing order
+	unlink(path);
+	{
+		Database db(path);
+		Database::Table t = db.create_table({Database::ColType::Unsigned});
+		t.index(0);
+
+		std::vector<std::pair<uint64_t, Database::RowId>> model;
+		for (uint64_t i=0; i<200000; i++) {
+			uint64_t k = i%2 ? next_rand()%100000 : 100000+i;
+			model.emplace_back(k, t.insert({k}));
+		}
+
+		auto check_index = [&]() {
+			std::sort(model.begin(), model.end());
+			std::vector<std::pair<uint64_t, Database::RowId>> got;
+			t.range(0, 0, UINT64_MAX, [&](Database::Row const& row) {
+				got.emplace_back(row.get_unsigned(0), row.id);
+				return true;
+			});
+			assert(got==model);
+
+			for (int i=0; i<100; i++) {
+				uint64_t k = model[next_rand()%model.size()].first;
+				std::vector<Database::RowId> found = t.find(0, k), want;
+				for (auto [mk, id]: model) if (mk==k) want.push_back(id);
+				std::sort(found.begin(), found.end());
+				assert(found==want);
+			}
+		};
+
+		check_index();
+
+		//every other row, then the rest back in
+		std::vector<std::pair<uint64_t, Database::RowId>> kept;
+		for (size_t i=0; i<model.size(); i++) {
+			if (i%2) {
+				bool removed = t.remove(model[i].second);
+				assert(removed);
+			} else {
+				kept.push_back(model[i]);
+			}
+		}
+
+		model = kept;
+		check_index();
+
+		for (uint64_t i=0; i<50000; i++) {
+			uint64_t k = next_rand()%300000;
+			model.emplace_back(k, t.insert({k}));
+		}
+
+		check_index();
+	}
+
+	//files that aren't databases, or were written with the other byte order
+	{
+		FILE* f = fopen(path, "r+b");
+		fseek(f, 12, SEEK_SET);
+		uint32_t flags = 1u<<24 | 1u;
+		fwrite(&flags, 4, 1, f);
+		fclose(f);
+
+		bool threw=false;
+		try { Database db(path); } catch (Database::DatabaseFormatError const&) { threw=true; }
+		assert(threw);
+
+		f = fopen(path, "wb");
+		fputs("not a database", f);
+		fclose(f);
+
+		threw=false;
+		try { Database db(path); } catch (Database::DatabaseFormatError const&) { threw=true; }
+		assert(threw && file_size(path)==14);
+	}
+
+	unlink(path);
+	return 0;
+}
@@ -0,0 +1,48 @@
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "numeric.hpp"
+
+using namespace std::chrono;
+
+//multiplies pairs of random positive n digit (16 bit) numbers. prints ns per multiply and a checksum of the products
+//so runs against different SmallVectors can be compared
+int main(int argc, char** argv) {
+	size_t total = argc>1 ? std::stoul(argv[1]) : 2000000;
+
+	uint64_t x=0x9E3779B97F4A7C15ull;
+	auto next = [&]() {
+		x ^= x<<13;
+		x ^= x>>7;
+		x ^= x<<17;
+		return x;
+	};
+
+	std::cout << "digits mul_ns checksum" << std::endl;
+	for (unsigned n: {1, 2, 4, 8, 16, 32}) {
+		std::vector<Digital> nums;
+		for (int i=0; i<64; i++) {
+			Digital d(0, false, n-1, n);
+			for (unsigned j=0; j<n; j++) d.digits[j] = static_cast<uint16_t>(next());
+			d.digits[0] |= 1;
+			d.digits[n-1] |= 1;
+			nums.push_back(d);
+		}
+
+		//quadratic in n, so fewer rounds for longer numbers
+		size_t rounds = total/(n*n);
+		uint64_t sum=0;
+
+		time_point tp = high_resolution_clock::now();
+		for (size_t i=0; i<rounds; i++) {
+			Digital res = nums[i%64]*nums[(i*7+3)%64];
+			sum += res.exponent+res.digits.size()+res.digits[res.digits.size()/2];
+		}
+
+		double ns = static_cast<double>(duration_cast<nanoseconds>(high_resolution_clock::now()-tp).count())/rounds;
+		std::cout << n << " " << ns << " " << sum << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,72 @@
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "locktable.hpp"
+
+using namespace std::chrono;
+
+//per-user updates: each op locks a random user, bumps their counter and a few more words of state.
+//returns million ops per second across all threads
+template<class Lock>
+double run(Lock lock, unsigned threads, size_t users, size_t ops_per_thread) {
+	std::vector<std::array<unsigned long, 8>> state(users);
+	std::vector<std::thread> workers;
+
+	time_point tp = high_resolution_clock::now();
+
+	for (unsigned t=0; t<threads; t++) {
+		workers.emplace_back([&, t]() {
+			uint64_t x = 0x9E3779B97F4A7C15ull*(t+1);
+			for (size_t i=0; i<ops_per_thread; i++) {
+				x ^= x<<13;
+				x ^= x>>7;
+				x ^= x<<17;
+
+				unsigned long u = x%users;
+				auto l = lock(u);
+				for (unsigned long& w: state[u]) w+=i;
+			}
+		});
+	}
+
+	for (std::thread& w: workers) w.join();
+
+	double secs = static_cast<double>(duration_cast<nanoseconds>(high_resolution_clock::now()-tp).count())/1e9;
+	return static_cast<double>(threads*ops_per_thread)/secs/1e6;
+}
+
+template<class Mutex>
+void striped(char const* name, unsigned threads, size_t users, size_t ops) {
+	LockTable<unsigned long, Mutex> table(256);
+	double mops = run([&](unsigned long u) { return table.lock(u); }, threads, users, ops);
+
+	auto stats = table.total_stats();
+	std::cout << threads << " " << name << " " << mops << " "
+	          << static_cast<double>(stats.contended)/static_cast<double>(stats.acquisitions) << std::endl;
+}
+
+int main(int argc, char** argv) {
+	unsigned max_threads = argc>1 ? std::stoul(argv[1]) : 32;
+	size_t users = argc>2 ? std::stoul(argv[2]) : 100000;
+	size_t ops = argc>3 ? std::stoul(argv[3]) : 2000000;
+
+	std::cout << "hardware_concurrency " << std::thread::hardware_concurrency() << std::endl;
+	std::cout << "threads lock mops contended_fraction" << std::endl;
+
+	for (unsigned threads=1; threads<=max_threads; threads*=2) {
+		std::mutex global;
+		double mops = run([&](unsigned long) { return std::unique_lock(global); }, threads, users, ops);
+		std::cout << threads << " global_mutex " << mops << " -" << std::endl;
+
+		striped<std::shared_mutex>("shared_mutex", threads, users, ops);
+		striped<std::mutex>("mutex", threads, users, ops);
+		striped<SpinLock>("spin", threads, users, ops);
+		striped<FutexLock>("futex", threads, users, ops);
+	}
+
+	return 0;
+}
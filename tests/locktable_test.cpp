@@ -0,0 +1,88 @@
+#include <cassert>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "locktable.hpp"
+
+//concurrent increments of per-key counters, each under its key's stripe
+template<class Mutex>
+void counters() {
+	LockTable<int, Mutex> table(16);
+	assert(table.num_stripes()==16);
+
+	const int threads=4, keys=64, rounds=2000;
+	std::vector<long> counts(keys);
+	std::vector<std::thread> workers;
+
+	for (int t=0; t<threads; t++) {
+		workers.emplace_back([&, t]() {
+			for (int i=0; i<rounds; i++) {
+				int k = (i*7+t)%keys;
+				auto lock = table.lock(k);
+				counts[k]++;
+			}
+		});
+	}
+
+	for (std::thread& w: workers) w.join();
+
+	long total=0;
+	for (long c: counts) total+=c;
+	assert(total==threads*rounds);
+	assert(table.total_stats().acquisitions==static_cast<uint64_t>(threads*rounds));
+
+	table.reset_stats();
+	assert(table.total_stats().acquisitions==0);
+}
+
+int main() {
+	counters<std::shared_mutex>();
+	counters<SpinLock>();
+	counters<FutexLock>();
+	counters<std::mutex>();
+
+	//transfers between random pairs of accounts lock both at once, in opposite orders from different threads.
+	//locking in stripe order means this can't deadlock, and the total is conserved
+	LockTable<std::string> accounts(8);
+	const int n=32;
+	std::vector<long> balance(n, 100);
+	std::vector<std::thread> workers;
+
+	for (int t=0; t<4; t++) {
+		workers.emplace_back([&, t]() {
+			for (int i=0; i<5000; i++) {
+				int from = (i*13+t)%n, to = (i*5+t*3+1)%n;
+				if (from==to) continue;
+
+				auto lock = accounts.lock_many(std::to_string(from), std::to_string(to));
+				balance[from]--;
+				balance[to]++;
+			}
+		});
+	}
+
+	for (std::thread& w: workers) w.join();
+
+	long total=0;
+	for (long b: balance) total+=b;
+	assert(total==100*n);
+
+	//keys on the same stripe are locked once
+	{
+		auto lock = accounts.lock_many(std::string("a"), std::string("a"), std::string("b"));
+	}
+
+	//readers share a stripe
+	LockTable<int> rw(1);
+	{
+		auto a = rw.lock_shared(1);
+		auto b = rw.lock_shared(2);
+		assert(rw.stats(0).acquisitions==2 && rw.stats(0).contended==0);
+	}
+
+	auto excl = rw.lock(1);
+	assert(rw.stats(0).acquisitions==3);
+
+	return 0;
+}
@@ -0,0 +1,74 @@
+#include <string>
+#include <cstring>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "map.hpp"
+
+using namespace std::chrono;
+
+std::string rand_string(unsigned size) {
+	const char charset[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJK...";
+	std::string s;
+
+	for (unsigned n=0; n<size; n++) {
+		int key = rand() % (int) (strlen(charset) - 1);
+		s.push_back(charset[key]);
+	}
+
+	return s;
+}
+
+//keeps the map at a steady size while replacing every key once per epoch.
+//miss lookups walk the whole probe chain, so their cost should stay flat across epochs.
+//rebuilds counts same-capacity compactions, seen as the tombstone count dropping by more than one insert can reuse
+int main(int argc, char** argv) {
+	srand(47210);
+
+	size_t n = argc>1 ? std::stoul(argv[1]) : 100000;
+	unsigned epochs = argc>2 ? std::stoul(argv[2]) : 100;
+
+	Map<std::string, int> map;
+	std::vector<std::string> keys, misses;
+	for (size_t i=0; i<n; i++) {
+		keys.push_back(rand_string(12));
+		misses.push_back(rand_string(13));
+		map.insert(keys.back(), static_cast<int>(i));
+	}
+
+	long sum=0;
+	size_t rebuilds=0;
+	std::cout << "epoch churn_ns hit_ns miss_ns tombstones capacity rebuilds mean_probe max_probe" << std::endl;
+
+	for (unsigned epoch=0; epoch<epochs; epoch++) {
+		time_point tp = high_resolution_clock::now();
+		for (size_t i=0; i<n; i++) {
+			map.remove(keys[i]);
+			keys[i] = rand_string(12);
+
+			size_t tombstones=map.tombstones, cap=map.capacity();
+			map.insert(keys[i], static_cast<int>(i));
+			if (map.tombstones+1<tombstones && map.capacity()==cap) rebuilds++;
+		}
+
+		double churn_ns = static_cast<double>(duration_cast<nanoseconds>(high_resolution_clock::now()-tp).count())/n;
+
+		tp = high_resolution_clock::now();
+		for (std::string const& k: keys) sum += *map[k];
+		double hit_ns = static_cast<double>(duration_cast<nanoseconds>(high_resolution_clock::now()-tp).count())/n;
+
+		tp = high_resolution_clock::now();
+		for (std::string const& k: misses) sum += map[k]==nullptr;
+		double miss_ns = static_cast<double>(duration_cast<nanoseconds>(high_resolution_clock::now()-tp).count())/n;
+
+		std::vector<size_t> hist = map.probe_histogram();
+		double mean_probe=0;
+		for (size_t len=1; len<hist.size(); len++) mean_probe += static_cast<double>(len*hist[len])/map.count;
+
+		std::cout << epoch << " " << churn_ns << " " << hit_ns << " " << miss_ns << " " << map.tombstones << " "
+		          << map.capacity() << " " << rebuilds << " " << mean_probe << " " << hist.size()-1 << std::endl;
+	}
+
+	return sum==0;
+}
@@ -0,0 +1,77 @@
+#include <string>
+#include <cstring>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "map.hpp"
+
+using namespace std::chrono;
+
+//the old policy, std::hash unmixed
+template<class K>
+struct StdHash {
+	size_t operator()(K const& k) const {
+		return std::hash<K>()(k);
+	}
+};
+
+std::string rand_string(unsigned size) {
+	const char charset[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJK...";
+	std::string s;
+
+	for (unsigned n=0; n<size; n++) {
+		int key = rand() % (int) (strlen(charset) - 1);
+		s.push_back(charset[key]);
+	}
+
+	return s;
+}
+
+template<class F>
+double time_per_op(size_t n, F f) {
+	time_point tp = high_resolution_clock::now();
+	f();
+	return static_cast<double>(duration_cast<nanoseconds>(high_resolution_clock::now()-tp).count())/n;
+}
+
+template<class M, class K>
+void bench(char const* name, std::vector<K> const& keys, long& sum) {
+	M map;
+
+	double insert_ns = time_per_op(keys.size(), [&]() {
+		for (size_t i=0; i<keys.size(); i++) map.insert(keys[i], static_cast<int>(i));
+	});
+
+	double lookup_ns = time_per_op(keys.size(), [&]() {
+		for (K const& k: keys) sum += *map[k];
+	});
+
+	std::cout << name << " " << keys.size() << " " << insert_ns << " " << lookup_ns << std::endl;
+}
+
+int main(int argc, char** argv) {
+	srand(47210);
+
+	size_t n = argc>1 ? std::stoul(argv[1]) : 1000000;
+	unsigned str_len = argc>2 ? std::stoul(argv[2]) : 128;
+	long sum=0;
+
+	std::vector<unsigned long> ids(n);
+	for (size_t i=0; i<n; i++) ids[i]=i;
+
+	std::vector<std::string> strs;
+	for (size_t i=0; i<n/4; i++) strs.push_back(rand_string(str_len));
+
+	std::cout << "workload n insert_ns lookup_ns" << std::endl;
+
+	bench<Map<unsigned long, int, false, std::allocator, StdHash<unsigned long>>>("seq_int/std::hash", ids, sum);
+	bench<Map<unsigned long, int>>("seq_int/MapHash", ids, sum);
+	bench<Map<unsigned long, int, false, std::allocator, MapHash<unsigned long>, true>>("seq_int/MapHash+stored", ids, sum);
+
+	bench<Map<std::string, int, false, std::allocator, StdHash<std::string>>>("long_str/std::hash", strs, sum);
+	bench<Map<std::string, int>>("long_str/MapHash", strs, sum);
+	bench<Map<std::string, int, false, std::allocator, MapHash<std::string>, true>>("long_str/MapHash+stored", strs, sum);
+
+	return sum==0;
+}
@@ -0,0 +1,51 @@
+#include <string>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include "map.hpp"
+
+using namespace std::chrono;
+
+//peak resident set in KiB (bytes on macos)
+long peak_rss() {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+//grows a map of heavy values from empty and times every insert that triggered a resize
+int main(int argc, char** argv) {
+	size_t n = argc>1 ? std::stoul(argv[1]) : 1000000;
+	size_t value_size = argc>2 ? std::stoul(argv[2]) : 256;
+
+	long base_rss = peak_rss();
+
+	Map<std::string, std::vector<char>> map;
+	double resize_ms=0, total_ms=0;
+	unsigned resizes=0;
+
+	for (size_t i=0; i<n; i++) {
+		std::string k = "key" + std::to_string(i);
+		std::vector<char> v(value_size, static_cast<char>(i));
+		size_t cap = map.capacity();
+
+		time_point tp = high_resolution_clock::now();
+		map.insert(std::move(k), std::move(v));
+		double ms = static_cast<double>(duration_cast<nanoseconds>(high_resolution_clock::now()-tp).count())/1e6;
+
+		total_ms += ms;
+		if (map.capacity()!=cap) {
+			resize_ms += ms;
+			resizes++;
+		}
+	}
+
+	std::cout << "entries " << map.count << " capacity " << map.capacity() << std::endl;
+	std::cout << "resizes " << resizes << " resize_ms " << resize_ms << " insert_total_ms " << total_ms << std::endl;
+	std::cout << "peak_rss_kb " << peak_rss()-base_rss << std::endl;
+
+	return 0;
+}
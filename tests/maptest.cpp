@@ -1,11 +1,27 @@
 #include <string>
+#include <cstring>
 #include <chrono>
-#include <fstream>
+#include <iostream>
+#include <vector>
+#include <unordered_map>
 
 #include "map.hpp"
 
 using namespace std::chrono;
 
+//build with -DMAP_NO_SIMD (the maptest_scalar target) to compare against the scalar group scan
+#if defined(MAP_NO_SIMD)
+#define MAP_IMPL "Map/scalar"
+#elif defined(__ARM_NEON)
+#define MAP_IMPL "Map/neon"
+#elif defined(__AVX2__)
+#define MAP_IMPL "Map/avx2"
+#elif defined(__SSE2__)
+#define MAP_IMPL "Map/sse2"
+#else
+#define MAP_IMPL "Map/scalar"
+#endif
+
 std::string rand_string(unsigned size) {
 	const char charset[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJK...";
 	std::string s;
@@ -18,49 +34,73 @@ std::string rand_string(unsigned size) {
 	return s;
 }
 
+struct Result {
+	double insert_ns, hit_ns, miss_ns;
+};
 
-int main(int argc, char** argv) {
-	srand(47210);
+template<class F>
+double time_per_op(size_t n, F f) {
+	time_point tp = high_resolution_clock::now();
+	f();
+	return static_cast<double>(duration_cast<nanoseconds>(high_resolution_clock::now()-tp).count())/n;
+}
 
-	Map<std::string, int> map;
+//the sum is returned so lookups can't be optimized out
+template<class M, class Find>
+Result bench(std::vector<std::string> const& keys, std::vector<std::string> const& misses, Find find, long& sum) {
+	M map;
+	Result r;
 
-	std::array<std::string, 20> start;
+	r.insert_ns = time_per_op(keys.size(), [&]() {
+		for (size_t i=0; i<keys.size(); i++) map.insert({keys[i], static_cast<int>(i)});
+	});
 
-	for (std::string& i : start) {
-		std::string k = rand_string(10);
-		int x = rand();
-		map.insert(k, x);
+	r.hit_ns = time_per_op(keys.size(), [&]() {
+		for (std::string const& k: keys) sum += *find(map, k);
+	});
 
-		i=k;
-	}
+	r.miss_ns = time_per_op(misses.size(), [&]() {
+		for (std::string const& k: misses) sum += find(map, k)==nullptr;
+	});
 
-	std::ofstream out("./maptest_data.dat", std::ofstream::out);
+	return r;
+}
 
-	for (unsigned n=1; n<10000; n++) {
-		std::string k2 = rand_string(10);
-		int x2 = rand();
-		map.insert(k2, x2);
+//wraps Map::insert so both maps take a pair
+struct BenchMap: Map<std::string, int> {
+	void insert(std::pair<std::string, int> const& kv) {
+		Map::insert(kv.first, kv.second);
+	}
+};
 
-		int const* ret;
+int main(int argc, char** argv) {
+	srand(47210);
 
-		time_point tp = high_resolution_clock::now();
+	size_t max_n = argc>1 ? std::stoul(argv[1]) : 10000000;
+	long sum=0;
 
-		for (unsigned i=0; i<100; i++) {
-			for (std::string& k: start) {
-				ret = map[k];
-				if (!ret) return 1;
-			}
+	std::cout << "n impl insert_ns hit_ns miss_ns" << std::endl;
+
+	for (size_t n=1000; n<=max_n; n*=10) {
+		std::vector<std::string> keys, misses;
+		for (size_t i=0; i<n; i++) {
+			keys.push_back(rand_string(10));
+			misses.push_back(rand_string(11));
 		}
 
-		unsigned ms = duration_cast<nanoseconds>(high_resolution_clock::now()-tp).count();
-		out << n << " " << ms << std::endl;
+		Result map_res = bench<BenchMap>(keys, misses, [](BenchMap& m, std::string const& k) {
+			return m[k];
+		}, sum);
 
-		int const* ret2 = map[k2];
+		Result std_res = bench<std::unordered_map<std::string, int>>(keys, misses, [](auto& m, std::string const& k) {
+			auto it = m.find(k);
+			return it==m.end() ? nullptr : &it->second;
+		}, sum);
 
-		if (!ret2 || *ret2!=x2) {
-			return 1;
+		for (auto [name, r]: {std::make_pair(MAP_IMPL, map_res), std::make_pair("std::unordered_map", std_res)}) {
+			std::cout << n << " " << name << " " << r.insert_ns << " " << r.hit_ns << " " << r.miss_ns << std::endl;
 		}
 	}
 
-	return 0;
-}
\ No newline at end of file
+	return sum==0;
+}
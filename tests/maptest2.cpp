@@ -1,8 +1,13 @@
 #include <string>
+#include <cstring>
 #include <chrono>
 #include <fstream>
 #include <set>
 #include <cassert>
+#include <variant>
+#include <string_view>
+#include <stdexcept>
+#include <type_traits>
 
 #include "map.hpp"
 
@@ -48,4 +53,149 @@ int main() {
 		assert(ins_set.find(it->first)!=ins_set.end());
 	}
 
-}
\ No newline at end of file
+	//steady-state churn has to recycle tombstones instead of growing
+	size_t cap = m.capacity();
+	for (unsigned round=0; round<20; round++) {
+		for (std::string& s: ins) {
+			m.remove(s);
+			s = rand_string(15);
+			m.upsert(s);
+		}
+	}
+
+	assert(m.count==ins.size());
+	assert(m.capacity()<=2*cap);
+	for (std::string const& s: ins) assert(m[s]!=nullptr);
+
+	//64 consecutive keys share a home group, so the oldest keys sit in overflowed groups and removing them leaves
+	//tombstones that the newer keys' probes never pass. at ~30% load that has to compact in place, not grow
+	struct ClusterHash {
+		size_t operator()(int k) const { return (static_cast<size_t>(k/64)<<8) | (hash_mix(k)&0x7f) | 1; }
+	};
+
+	Map<int, int, false, std::allocator, ClusterHash> fifo;
+	fifo.reserve(1000);
+	size_t fifo_cap = fifo.capacity();
+	int live = static_cast<int>(fifo_cap*3/10);
+	for (int i=0; i<live; i++) fifo.insert(i, i);
+
+	size_t rebuilds=0;
+	for (int i=live; i<live+50000; i++) {
+		auto removed = fifo.remove(i-live);
+		assert(removed==std::optional<int>(i-live));
+
+		size_t tombstones = fifo.tombstones;
+		fifo.insert(i, i);
+		if (fifo.tombstones+1<tombstones) {
+			assert(fifo.tombstones==0);
+			rebuilds++;
+		}
+
+		assert(fifo.capacity()==fifo_cap);
+	}
+
+	assert(rebuilds>0 && fifo.count==static_cast<size_t>(live));
+	for (int i=50000; i<live+50000; i++) assert(*fifo[i]==i);
+
+	m.reserve(100000);
+	assert(m.capacity()>=200000);
+	for (std::string const& s: ins) assert(m[s]!=nullptr);
+
+	m.shrink_to_fit();
+	assert(m.capacity()==cap && m.tombstones==0);
+	for (std::string const& s: ins) assert(m[s]!=nullptr);
+
+	//string_view and char const* probes hash the same as the stored std::string
+	for (std::string const& s: ins) {
+		assert(m[std::string_view(s)]!=nullptr);
+		assert(m[s.c_str()]!=nullptr);
+	}
+
+	Map<std::string, int> hdrs {{"Content-Type", 1}, {"Content-Length", 2}};
+	assert(*hdrs["Content-Type"]==1);
+	assert(hdrs.find_begin(std::string_view("Content-Length"))!=hdrs.find_end());
+	auto content_length = hdrs.remove("Content-Length");
+	assert(content_length==std::optional<int>(2) && hdrs["Content-Length"]==nullptr);
+
+	//a throwing value constructor must leave the slot free, not tagged over raw storage
+	struct Throws {
+		int x;
+		Throws(int x): x(x) {
+			if (x<0) throw std::runtime_error("negative");
+		}
+	};
+
+	Map<std::string, Throws> throwing;
+	for (int i=0; i<100; i++) throwing.emplace(std::to_string(i), i);
+	for (int i=0; i<100; i++) {
+		bool threw=false;
+		try {
+			throwing.emplace("bad" + std::to_string(i), -1);
+		} catch (std::runtime_error const&) {
+			threw=true;
+		}
+
+		assert(threw && throwing["bad" + std::to_string(i)]==nullptr);
+	}
+
+	assert(throwing.count==100);
+	for (int i=0; i<100; i++) assert(throwing[std::to_string(i)]->x==i);
+
+	//moves don't allocate or throw, and the moved-from map is still usable
+	static_assert(std::is_nothrow_move_constructible_v<Map<std::string, int>>);
+	std::vector<Map<std::string, Throws>> maps;
+	maps.push_back(std::move(throwing));
+	assert(throwing.count==0 && throwing.capacity()==0 && throwing["1"]==nullptr && !throwing.remove("1"));
+	assert(throwing.begin()==throwing.end());
+	throwing.emplace("1", 1);
+	assert(throwing["1"]->x==1 && maps[0]["99"]->x==99);
+
+	//sequential keys used to get lost when growing
+	Map<int, int> seq;
+	for (int i=0; i<20000; i++) seq.insert(i, i);
+	for (int i=0; i<20000; i+=2) seq.remove(i);
+	for (int i=0; i<20000; i++) assert((seq[i]!=nullptr)==(i%2==1));
+	assert(seq.count==10000);
+
+	//stored hashes have to follow their buckets through growth and compaction
+	Map<std::string, int, false, std::allocator, MapHash<std::string>, true> stored;
+	for (unsigned round=0; round<5; round++) {
+		for (size_t i=0; i<ins.size(); i++) {
+			if (round>0) {
+				auto removed = stored.remove(ins[i]);
+				assert(removed==std::optional<int>(i));
+			}
+			ins[i] = rand_string(15);
+			stored.insert(ins[i], i);
+		}
+	}
+
+	assert(stored.count==ins.size());
+	for (size_t i=0; i<ins.size(); i++) assert(*stored[ins[i]]==static_cast<int>(i));
+
+	struct ConstHash {
+		size_t operator()(int) const { return 0x4201; }
+	};
+
+	//every key shares one home group, so each probe step has to land on a group no earlier step visited. count is
+	//hidden while filling so the load limit doesn't resize, letting every group but one fill up. the last insert then
+	//has to walk the whole probe sequence to the one group left, at every table size
+	for (size_t n=8; n<=(1<<12); n*=2) {
+		Map<int, int, false, std::allocator, ConstHash> worst;
+		worst.reserve(n);
+		size_t groups = worst.capacity()/16;
+		int filled = static_cast<int>((groups-1)*16);
+		for (int i=0; i<=filled; i++) {
+			worst.count=0;
+			worst.insert(i, i);
+		}
+
+		worst.count = filled+1;
+		assert(worst.capacity()==groups*16);
+
+		std::vector<size_t> hist = worst.probe_histogram();
+		assert(hist.size()==groups+1 && hist[groups]==1);
+		for (size_t len=1; len<groups; len++) assert(hist[len]==16);
+		for (int i=0; i<=filled; i++) assert(*worst[i]==i);
+	}
+}
@@ -0,0 +1,254 @@
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "portableendian.h"
+#include "serialize.hpp"
+
+using namespace std::chrono;
+
+struct Record {
+	uint64_t id;
+	int32_t count;
+	double value;
+	std::string name;
+};
+
+//best of 3, the first run mostly measures page faults on fresh memory
+template<class F>
+double time_ms(F f) {
+	double best=0;
+	for (int i=0; i<3; i++) {
+		time_point tp = high_resolution_clock::now();
+		f();
+		double ms = static_cast<double>(duration_cast<microseconds>(high_resolution_clock::now()-tp).count())/1000;
+		if (i==0 || ms<best) best=ms;
+	}
+
+	return best;
+}
+
+//the previous serializer: one ostream::write per big endian scalar, NUL terminated strings, and std::function for
+//each element
+struct OldSerialize {
+	std::ostream& out;
+
+	void write(uint64_t x) {
+		uint64_t net = htobe64(x);
+		out.write(reinterpret_cast<char*>(&net), sizeof(net));
+	}
+
+	void write(int32_t x) {
+		uint32_t net = htobe32(static_cast<uint32_t>(x));
+		out.write(reinterpret_cast<char*>(&net), sizeof(net));
+	}
+
+	void write(std::string const& x) {
+		out.write(x.data(), x.length());
+		out.write("\0", 1);
+	}
+
+	template<class T>
+	void write_vector(std::vector<T> const& vec, std::function<void(OldSerialize&, T const&)> f) {
+		write(uint64_t(vec.size()));
+		for (T const& t: vec) f(*this, t);
+	}
+};
+
+struct OldDeserialize {
+	std::istream& in;
+
+	uint64_t read_u64() {
+		uint64_t net;
+		in.read(reinterpret_cast<char*>(&net), sizeof(net));
+		return be64toh(net);
+	}
+
+	int32_t read_i32() {
+		uint32_t net;
+		in.read(reinterpret_cast<char*>(&net), sizeof(net));
+		return static_cast<int32_t>(be32toh(net));
+	}
+
+	std::string read_string() {
+		std::string s;
+		std::getline(in, s, '\0');
+		return s;
+	}
+
+	template<class T>
+	std::vector<T> read_vector(std::function<T(OldDeserialize&)> f) {
+		uint64_t len = read_u64();
+		std::vector<T> vec(len);
+		for (uint64_t i=0; i<len; i++) vec[i] = f(*this);
+		return vec;
+	}
+};
+
+//writes and reads n records and an n element uint64_t array with the old serializer and the new one into a vector,
+//through an ostream, and read back with copies, with views and from an istream. times in ms
+int main(int argc, char** argv) {
+	size_t n = argc>1 ? std::stoul(argv[1]) : 1000000;
+
+	std::vector<Record> records;
+	std::vector<uint64_t> ids;
+	for (size_t i=0; i<n; i++) {
+		records.push_back({.id=i*2654435761u, .count=static_cast<int32_t>(i%1000), .value=i*0.5, .name="record "+std::to_string(i)});
+		ids.push_back(i*2654435761u);
+	}
+
+	uint64_t sum=0;
+	std::cout << "impl records_write_ms records_read_ms array_write_ms array_read_ms bytes" << std::endl;
+
+	{
+		std::string rec_bytes, arr_bytes;
+		double wr = time_ms([&]() {
+			std::ostringstream os;
+			OldSerialize s {.out=os};
+			s.write_vector<Record>(records, [](OldSerialize& s, Record const& r) {
+				s.write(r.id);
+				s.write(r.count);
+				uint64_t bits;
+				std::memcpy(&bits, &r.value, 8);
+				s.write(bits);
+				s.write(r.name);
+			});
+			rec_bytes = os.str();
+		});
+
+		double wa = time_ms([&]() {
+			std::ostringstream os;
+			OldSerialize s {.out=os};
+			s.write_vector<uint64_t>(ids, [](OldSerialize& s, uint64_t const& x) { s.write(x); });
+			arr_bytes = os.str();
+		});
+
+		double rr = time_ms([&]() {
+			std::istringstream is(rec_bytes);
+			OldDeserialize d {.in=is};
+			auto back = d.read_vector<Record>([](OldDeserialize& d) {
+				Record r;
+				r.id = d.read_u64();
+				r.count = d.read_i32();
+				uint64_t bits = d.read_u64();
+				std::memcpy(&r.value, &bits, 8);
+				r.name = d.read_string();
+				return r;
+			});
+			sum += back[n/2].id;
+		});
+
+		double ra = time_ms([&]() {
+			std::istringstream is(arr_bytes);
+			OldDeserialize da {.in=is};
+			auto back = da.read_vector<uint64_t>([](OldDeserialize& d) { return d.read_u64(); });
+			sum += back[n/2];
+		});
+
+		std::cout << "old_ostream " << wr << " " << rr << " " << wa << " " << ra << " " << rec_bytes.size() << std::endl;
+	}
+
+	auto write_record = [](auto& s, Record const& r) {
+		s.write(r.id);
+		s.write(r.count);
+		s.write(r.value);
+		s.write(r.name);
+	};
+
+	auto read_record = [](auto& d) {
+		return Record {.id=d.template read<uint64_t>(), .count=d.template read<int32_t>(),
+			.value=d.template read<double>(), .name=d.template read<std::string>()};
+	};
+
+	std::vector<char> buf, arr_buf;
+	{
+		double wr = time_ms([&]() {
+			buf.clear();
+			Serialize<std::vector<char>&> s(buf);
+			s.write_vector(records, write_record);
+		});
+
+		double wa = time_ms([&]() {
+			arr_buf.clear();
+			Serialize<std::vector<char>&> s(arr_buf);
+			s.write_vector(ids);
+		});
+
+		double rr = time_ms([&]() {
+			Deserialize<std::string_view> d(std::string_view(buf.data(), buf.size()));
+			auto back = d.read_vector<Record>(read_record);
+			sum += back[n/2].id;
+		});
+
+		double ra = time_ms([&]() {
+			Deserialize<std::string_view> d(std::string_view(arr_buf.data(), arr_buf.size()));
+			auto back = d.read_vector<uint64_t>();
+			sum += back[n/2];
+		});
+
+		std::cout << "new_vector " << wr << " " << rr << " " << wa << " " << ra << " " << buf.size() << std::endl;
+	}
+
+	{
+		//names as views into the buffer, the array as a view
+		double rr = time_ms([&]() {
+			Deserialize<std::string_view> d(std::string_view(buf.data(), buf.size()));
+			size_t len = d.read_size();
+			for (size_t i=0; i<len; i++) {
+				sum += d.read<uint64_t>()+d.read<int32_t>();
+				d.read<double>();
+				sum += d.read<std::string_view>().size();
+			}
+		});
+
+		double ra = time_ms([&]() {
+			Deserialize<std::string_view> d(std::string_view(arr_buf.data(), arr_buf.size()));
+			sum += d.read_view<uint64_t>()[n/2];
+		});
+
+		std::cout << "new_views - " << rr << " - " << ra << " " << buf.size() << std::endl;
+	}
+
+	{
+		std::string rec_bytes, arr_bytes;
+		double wr = time_ms([&]() {
+			std::ostringstream os;
+			{
+				Serialize<> s(os);
+				s.write_vector(records, write_record);
+			}
+			rec_bytes = os.str();
+		});
+
+		double wa = time_ms([&]() {
+			std::ostringstream os;
+			{
+				Serialize<> s(os);
+				s.write_vector(ids);
+			}
+			arr_bytes = os.str();
+		});
+
+		double rr = time_ms([&]() {
+			std::istringstream is(rec_bytes);
+			Deserialize<> d(is);
+			auto back = d.read_vector<Record>(read_record);
+			sum += back[n/2].id;
+		});
+
+		double ra = time_ms([&]() {
+			std::istringstream is(arr_bytes);
+			Deserialize<> d(is);
+			auto back = d.read_vector<uint64_t>();
+			sum += back[n/2];
+		});
+
+		std::cout << "new_ostream " << wr << " " << rr << " " << wa << " " << ra << " " << rec_bytes.size() << std::endl;
+	}
+
+	std::cerr << sum << std::endl;
+	return 0;
+}
@@ -0,0 +1,132 @@
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "serialize.hpp"
+
+using namespace std::chrono;
+
+struct Record {
+	uint64_t id;
+	int32_t count;
+	double value;
+	std::string name;
+	std::vector<uint32_t> tags;
+	std::optional<double> score;
+	std::variant<int64_t, std::string> label;
+};
+
+SERIALIZE_FIELDS(Record, &Record::id, &Record::count, &Record::value, &Record::name, &Record::tags, &Record::score,
+                 &Record::label);
+
+//best of 3, the first run mostly measures page faults on fresh memory
+template<class F>
+double time_ms(F f) {
+	double best=0;
+	for (int i=0; i<3; i++) {
+		time_point tp = high_resolution_clock::now();
+		f();
+		double ms = static_cast<double>(duration_cast<microseconds>(high_resolution_clock::now()-tp).count())/1000;
+		if (i==0 || ms<best) best=ms;
+	}
+
+	return best;
+}
+
+//the hand written way, one lambda per record type
+template<class S>
+void write_record(S& s, Record const& r) {
+	s.write(r.id);
+	s.write(r.count);
+	s.write(r.value);
+	s.write(r.name);
+	s.write_vector(r.tags);
+	s.write(uint8_t(r.score.has_value()));
+	if (r.score) s.write(*r.score);
+	s.write_size(r.label.index());
+	if (r.label.index()==0) s.write(std::get<0>(r.label));
+	else s.write(std::get<1>(r.label));
+}
+
+template<class D>
+Record read_record(D& d) {
+	Record r;
+	r.id = d.template read<uint64_t>();
+	r.count = d.template read<int32_t>();
+	r.value = d.template read<double>();
+	r.name = d.template read<std::string>();
+	r.tags = d.template read_vector<uint32_t>();
+	if (d.template read<uint8_t>()) r.score = d.template read<double>();
+	if (d.read_size()==0) r.label = d.template read<int64_t>();
+	else r.label = d.template read<std::string>();
+	return r;
+}
+
+//n records written and read back with the per element lambdas behind a std::function (as callers had to before), the
+//same lambdas inlined, and the reflected write(vector)/read<vector> in ms. outputs should be identical
+int main(int argc, char** argv) {
+	size_t n = argc>1 ? std::stoul(argv[1]) : 1000000;
+
+	using Ser = Serialize<std::vector<char>&>;
+	using De = Deserialize<std::string_view>;
+
+	std::vector<Record> records;
+	for (size_t i=0; i<n; i++) {
+		Record r {.id=i*2654435761u, .count=static_cast<int32_t>(i%1000), .value=i*0.5, .name="record "+std::to_string(i)};
+		for (size_t j=0; j<i%5; j++) r.tags.push_back(static_cast<uint32_t>(i+j));
+		if (i%3) r.score = i*0.25;
+		if (i%2) r.label = static_cast<int64_t>(i);
+		else r.label = "label";
+		records.push_back(std::move(r));
+	}
+
+	uint64_t sum=0;
+	std::vector<char> expected;
+	std::cout << "impl write_ms read_ms bytes" << std::endl;
+
+	auto run = [&](char const* name, auto write, auto read) {
+		std::vector<char> buf;
+		double w = time_ms([&]() {
+			buf.clear();
+			Ser s(buf);
+			write(s);
+		});
+
+		double r = time_ms([&]() {
+			De d(std::string_view(buf.data(), buf.size()));
+			std::vector<Record> back = read(d);
+			sum += back[n/2].id+back[n/2].tags.size();
+		});
+
+		if (expected.empty()) expected = buf;
+		else if (buf!=expected) std::cerr << name << " wrote different bytes" << std::endl;
+		std::cout << name << " " << w << " " << r << " " << buf.size() << std::endl;
+	};
+
+	run("std_function", [&](Ser& s) {
+		std::function<void(Ser&, Record const&)> f = write_record<Ser>;
+		s.write_vector(records, f);
+	}, [&](De& d) {
+		std::function<Record(De&)> f = read_record<De>;
+		return d.read_vector<Record>(f);
+	});
+
+	run("lambda", [&](Ser& s) {
+		s.write_vector(records, [](Ser& s, Record const& r) { write_record(s, r); });
+	}, [&](De& d) {
+		return d.read_vector<Record>([](De& d) { return read_record(d); });
+	});
+
+	run("reflected", [&](Ser& s) {
+		s.write(records);
+	}, [&](De& d) {
+		return d.read<std::vector<Record>>();
+	});
+
+	std::cerr << sum << std::endl;
+	return 0;
+}
@@ -0,0 +1,127 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "serialize.hpp"
+
+using namespace std::chrono;
+
+struct Record {
+	uint64_t id;
+	int32_t count;
+	double value;
+	std::string name;
+};
+
+SERIALIZE_FIELDS(Record, &Record::id, &Record::count, &Record::value, &Record::name);
+
+//best of 3, the first run mostly measures page faults on fresh memory
+template<class F>
+double time_ms(F f) {
+	double best=0;
+	for (int i=0; i<3; i++) {
+		time_point tp = high_resolution_clock::now();
+		f();
+		double ms = static_cast<double>(duration_cast<microseconds>(high_resolution_clock::now()-tp).count())/1000;
+		if (i==0 || ms<best) best=ms;
+	}
+
+	return best;
+}
+
+template<class Input>
+uint64_t sum_records(Deserialize<Input>& d) {
+	uint64_t sum=0;
+	for (Record const& r: d.template read_records<Record>()) sum += r.id+r.name.size();
+	return sum;
+}
+
+//writes n records as one vector to a file (in the page cache) and pulls them back one at a time through an ifstream,
+//the mapped file, the file's fd and a pipe fed from memory by another thread. GB/s of input
+int main(int argc, char** argv) {
+	size_t n = argc>1 ? std::stoul(argv[1]) : 4000000;
+	char const* path = argc>2 ? argv[2] : "/tmp/serialize_stream_bench.bin";
+
+	std::vector<char> bytes;
+	{
+		std::vector<Record> records;
+		for (size_t i=0; i<n; i++) {
+			records.push_back({.id=i*2654435761u, .count=static_cast<int32_t>(i%1000), .value=i*0.5, .name="record "+std::to_string(i)});
+		}
+
+		Serialize<std::vector<char>&> s(bytes);
+		s.write(records);
+	}
+
+	{
+		std::ofstream out(path, std::ios::binary);
+		out.write(bytes.data(), bytes.size());
+	}
+
+	uint64_t expected;
+	{
+		Deserialize<std::string_view> d(std::string_view(bytes.data(), bytes.size()));
+		expected = sum_records(d);
+	}
+
+	uint64_t sum=0;
+	auto report = [&](char const* name, double ms) {
+		std::cout << name << " " << ms << " " << static_cast<double>(bytes.size())/ms/1e6 << std::endl;
+	};
+
+	std::cout << "impl ms GB/s (" << bytes.size() << " bytes)" << std::endl;
+
+	report("istream", time_ms([&]() {
+		std::ifstream in(path, std::ios::binary);
+		Deserialize<> d(in);
+		sum += sum_records(d)==expected;
+	}));
+
+	report("mmap", time_ms([&]() {
+		MappedFile file(path);
+		Deserialize<std::string_view> d(file.view());
+		sum += sum_records(d)==expected;
+	}));
+
+	report("read_file", time_ms([&]() {
+		int fd = open(path, O_RDONLY);
+		{
+			Deserialize<FdInput> d(FdInput {.fd=fd});
+			sum += sum_records(d)==expected;
+		}
+
+		close(fd);
+	}));
+
+	report("read_pipe", time_ms([&]() {
+		int fds[2];
+		if (pipe(fds)<0) return;
+		std::thread writer([&]() {
+			for (size_t at=0; at<bytes.size();) {
+				ssize_t w = write(fds[1], bytes.data()+at, std::min<size_t>(bytes.size()-at, 1<<20));
+				if (w<0) break;
+				at += w;
+			}
+
+			close(fds[1]);
+		});
+
+		{
+			Deserialize<FdInput> d(FdInput {.fd=fds[0]});
+			sum += sum_records(d)==expected;
+		}
+
+		writer.join();
+		close(fds[0]);
+	}));
+
+	unlink(path);
+	std::cerr << sum << std::endl;
+	return 0;
+}
@@ -0,0 +1,392 @@
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "serialize.hpp"
+
+enum class Kind: uint8_t { A, B, C };
+
+struct Point {
+	int32_t x, y;
+};
+
+SERIALIZE_FIELDS(Point, &Point::x, &Point::y);
+
+struct Shape {
+	std::string name;
+	Kind kind;
+	std::vector<Point> points;
+	std::optional<double> scale;
+	std::variant<uint64_t, std::string, Point> tag;
+	Map<std::string, std::vector<uint16_t>> layers;
+	std::pair<uint8_t, std::optional<std::string>> note;
+};
+
+SERIALIZE_FIELDS(Shape, &Shape::name, &Shape::kind, &Shape::points, &Shape::scale, &Shape::tag, &Shape::layers,
+                 &Shape::note);
+
+bool operator==(Point const& a, Point const& b) {
+	return a.x==b.x && a.y==b.y;
+}
+
+bool operator!=(Point const& a, Point const& b) {
+	return !(a==b);
+}
+
+bool same_shape(Shape const& a, Shape const& b) {
+	if (a.name!=b.name || a.kind!=b.kind || a.points!=b.points || a.scale!=b.scale || a.tag!=b.tag || a.note!=b.note) {
+		return false;
+	}
+
+	if (a.layers.count!=b.layers.count) return false;
+	for (auto const& [k, v]: a.layers) {
+		std::vector<uint16_t> const* other = b.layers[k];
+		if (!other || *other!=v) return false;
+	}
+
+	return true;
+}
+
+//a pipe the test can't go on without
+void open_pipe(int fds[2]) {
+	if (pipe(fds)!=0) {
+		std::perror("pipe");
+		std::abort();
+	}
+}
+
+std::vector<Shape> shapes() {
+	std::vector<Shape> ret;
+	for (uint32_t i=0; i<50; i++) {
+		Shape s {.name="shape"+std::to_string(i), .kind=static_cast<Kind>(i%3), .points={}, .scale=std::nullopt, .tag=uint64_t(0),
+		         .layers={}, .note={}};
+		for (uint32_t j=0; j<i%7; j++) s.points.push_back({.x=int32_t(i*j), .y=-int32_t(j)});
+		if (i%2) s.scale = i*0.5;
+
+		if (i%3==0) s.tag = uint64_t(i)<<40;
+		else if (i%3==1) s.tag = std::string(i, 't');
+		else s.tag = Point {.x=int32_t(i), .y=7};
+
+		for (uint32_t j=0; j<i%4; j++) s.layers.insert("layer"+std::to_string(j), std::vector<uint16_t>(j+i, uint16_t(j)));
+		s.note = {uint8_t(i), i%5 ? std::optional<std::string>("n"+std::to_string(i)) : std::nullopt};
+		ret.push_back(std::move(s));
+	}
+
+	return ret;
+}
+
+//the same values through every output, checking the bytes agree and read back through every input
+template<class Ser>
+void write_all(Ser& s) {
+	s.write(int32_t(-5));
+	s.write(uint64_t(0x0123456789ABCDEFull));
+	s.write(int16_t(-2));
+	s.write(3.25);
+	s.write(Kind::C);
+	s.write(std::string("hello"));
+	s.write("");
+	s.write(std::string(300, 'x'));
+
+	std::vector<uint64_t> big(100000);
+	for (size_t i=0; i<big.size(); i++) big[i] = i*i;
+	s.write(uint8_t(1));
+	s.write_vector(big);
+
+	std::vector<std::string> strs {"a", "bc", "", "def"};
+	s.write(strs);
+	s.write_vector(strs, [](auto& s, std::string const& x) { s.write(x+"!"); });
+
+	for (uint64_t n: {0ull, 31ull, 32ull, 8191ull, 8192ull, 1ull<<40, (1ull<<61)-1}) s.write_size(n);
+}
+
+template<class De>
+void read_all_but_end(De& d) {
+	int32_t a = d.template read<int32_t>();
+	uint64_t b = d.template read<uint64_t>();
+	int16_t c = d.template read<int16_t>();
+	double f = d.template read<double>();
+	Kind k = d.template read<Kind>();
+	assert(a==-5 && b==0x0123456789ABCDEFull && c==-2 && f==3.25 && k==Kind::C);
+
+	std::string s1 = d.template read<std::string>(), s2 = d.template read<std::string>(), s3 = d.template read<std::string>();
+	assert(s1=="hello" && s2=="" && s3==std::string(300, 'x'));
+
+	uint8_t one = d.template read<uint8_t>();
+	assert(one==1);
+	std::vector<uint64_t> big = d.template read_vector<uint64_t>();
+	assert(big.size()==100000);
+	for (size_t i=0; i<big.size(); i++) assert(big[i]==i*i);
+
+	std::vector<std::string> strs = d.template read<std::vector<std::string>>();
+	assert((strs==std::vector<std::string> {"a", "bc", "", "def"}));
+	auto excl = d.template read_vector<std::string>([](auto& d) { return d.template read<std::string>(); });
+	assert((excl==std::vector<std::string> {"a!", "bc!", "!", "def!"}));
+
+	for (uint64_t n: {0ull, 31ull, 32ull, 8191ull, 8192ull, 1ull<<40, (1ull<<61)-1}) {
+		uint64_t size = d.read_size();
+		assert(size==n);
+	}
+}
+
+template<class De>
+void read_all(De& d) {
+	read_all_but_end(d);
+	assert(d.at_end());
+}
+
+int main() {
+	std::vector<char> vec;
+	{
+		Serialize<std::vector<char>&> s(vec);
+		write_all(s);
+	}
+
+	std::ostringstream os;
+	{
+		Serialize<> s(os);
+		write_all(s);
+	}
+
+	assert(os.str()==std::string(vec.begin(), vec.end()));
+
+	std::vector<char> span_buf(vec.size());
+	{
+		Serialize<OutputSpan> s(OutputSpan {.data=span_buf.data(), .size=span_buf.size()});
+		write_all(s);
+		assert(s.size()==vec.size());
+	}
+
+	assert(span_buf==vec);
+
+	char small[16];
+	Serialize<OutputSpan> tight(OutputSpan {.data=small, .size=sizeof(small)});
+	tight.write(uint64_t(1));
+	tight.write(uint64_t(2));
+	bool threw=false;
+	try {
+		tight.write(uint8_t(3));
+	} catch (SerializeOverflow const&) {
+		threw=true;
+	}
+
+	assert(threw);
+
+	{
+		Deserialize<std::string_view> d(std::string_view(vec.data(), vec.size()));
+		read_all(d);
+	}
+
+	{
+		std::istringstream is(os.str());
+		Deserialize<> d(is);
+		read_all(d);
+	}
+
+	//views into the input
+	{
+		Deserialize<std::string_view> d(std::string_view(vec.data(), vec.size()));
+		d.read<int32_t>();
+		d.read<uint64_t>();
+		d.read<int16_t>();
+		d.read<double>();
+		d.read<Kind>();
+		std::string_view hello = d.read<std::string_view>();
+		assert(hello=="hello" && hello.data()>=vec.data() && hello.data()<vec.data()+vec.size());
+		d.read<std::string_view>();
+		d.read<std::string_view>();
+		d.read<uint8_t>();
+
+		ArrayView<uint64_t> big = d.read_view<uint64_t>();
+		assert(big.size()==100000 && big[1000]==1000000 && reinterpret_cast<char const*>(big.begin())>vec.data());
+	}
+
+	//reflected structs, nested through vectors, optionals, variants, pairs and maps
+	{
+		std::vector<Shape> orig = shapes();
+		std::vector<char> out;
+		{
+			Serialize<std::vector<char>&> s(out);
+			s.write(orig);
+		}
+
+		std::ostringstream os2;
+		{
+			Serialize<> s(os2);
+			s.write(orig);
+		}
+
+		assert(os2.str()==std::string(out.begin(), out.end()));
+
+		Deserialize<std::string_view> d(std::string_view(out.data(), out.size()));
+		std::vector<Shape> back = d.read<std::vector<Shape>>();
+		assert(d.at_end() && back.size()==orig.size());
+		for (size_t i=0; i<orig.size(); i++) assert(same_shape(orig[i], back[i]));
+
+		std::istringstream is2(os2.str());
+		Deserialize<> d2(is2);
+		back = d2.read<std::vector<Shape>>();
+		for (size_t i=0; i<orig.size(); i++) assert(same_shape(orig[i], back[i]));
+
+		//a variant index past the alternatives
+		std::vector<char> bad;
+		{
+			Serialize<std::vector<char>&> s(bad);
+			s.write_size(3);
+		}
+
+		Deserialize<std::string_view> d3(std::string_view(bad.data(), bad.size()));
+		threw=false;
+		try {
+			d3.read<std::variant<uint64_t, std::string, Point>>();
+		} catch (DeserializeInvalid const&) {
+			threw=true;
+		}
+
+		assert(threw);
+	}
+
+	//a mapped file, and a pipe written to in small pieces through small chunks so values straddle them
+	{
+		std::vector<char> file;
+		{
+			Serialize<std::vector<char>&> s(file);
+			write_all(s);
+			s.write(shapes());
+			for (Shape const& x: shapes()) s.write(x);
+		}
+
+		char path[] = "/tmp/serialize_test_XXXXXX";
+		int fd = mkstemp(path);
+		assert(fd>=0);
+		ssize_t wrote = write(fd, file.data(), file.size());
+		assert(wrote==static_cast<ssize_t>(file.size()));
+		close(fd);
+
+		auto read_file = [](auto& d) {
+			read_all_but_end(d);
+			std::vector<Shape> orig = shapes();
+
+			size_t i=0, differ=0;
+			for (Shape& x: d.template read_records<Shape>()) differ += !same_shape(x, orig[i++]);
+			assert(differ==0 && i==orig.size());
+
+			auto rest = d.template read_records_to_end<Shape>();
+			for (i=0; Shape* x = rest.next(); i++) assert(same_shape(*x, orig[i]));
+			Shape* after = rest.next();
+			assert(i==orig.size() && !after);
+		};
+
+		{
+			MappedFile mapped(path);
+			assert(mapped.view().size()==file.size());
+			Deserialize<std::string_view> d(mapped.view());
+			read_file(d);
+		}
+
+		unlink(path);
+
+		for (size_t chunk: {size_t(13), size_t(4096)}) {
+			int fds[2];
+			open_pipe(fds);
+			std::thread writer([&]() {
+				size_t at=0;
+				for (size_t i=0; at<file.size(); i++) {
+					size_t n = std::min(file.size()-at, 1+i*7919%5000);
+					ssize_t w = write(fds[1], file.data()+at, n);
+					assert(w==static_cast<ssize_t>(n));
+					at += static_cast<size_t>(w);
+				}
+
+				close(fds[1]);
+			});
+
+			{
+				Deserialize<FdInput> d(FdInput {.fd=fds[0], .chunk=chunk});
+				read_file(d);
+				assert(d.at_end() && d.position()==file.size());
+			}
+
+			writer.join();
+			close(fds[0]);
+		}
+
+		//stopping before the writer is done
+		int fds[2];
+		open_pipe(fds);
+		wrote = write(fds[1], file.data(), 100);
+		assert(wrote==100);
+		{
+			Deserialize<FdInput> d(FdInput {.fd=fds[0]});
+			int32_t first = d.read<int32_t>();
+			assert(first==-5);
+		}
+
+		close(fds[0]);
+		close(fds[1]);
+	}
+
+	//a pty's master fails with EIO once the other end is closed and drained: what came before the error is still read
+	if (int master = posix_openpt(O_RDWR | O_NOCTTY); master>=0) {
+		int slave = grantpt(master)==0 && unlockpt(master)==0 ? open(ptsname(master), O_RDWR | O_NOCTTY) : -1;
+		if (slave>=0) {
+			termios raw;
+			tcgetattr(slave, &raw);
+			cfmakeraw(&raw);
+			tcsetattr(slave, TCSANOW, &raw);
+
+			std::vector<char> out;
+			{
+				Serialize<std::vector<char>&> s(out);
+				for (int32_t i=0; i<100; i++) s.write(i);
+			}
+
+			ssize_t wrote = write(slave, out.data(), out.size());
+			assert(wrote==static_cast<ssize_t>(out.size()));
+			close(slave);
+
+			Deserialize<FdInput> d(FdInput {.fd=master});
+			int32_t i=0;
+			bool threw=false;
+			try {
+				for (; i<200; i++) {
+					int32_t x = d.read<int32_t>();
+					assert(x==i);
+				}
+			} catch (SerializeIOError const& e) {
+				threw = e.err==EIO;
+			}
+
+			assert(threw && i==100);
+		}
+
+		close(master);
+	}
+
+	//running out
+	{
+		Deserialize<std::string_view> d(std::string_view(vec.data(), 10));
+		d.read<int32_t>();
+		threw=false;
+		try {
+			d.read<uint64_t>();
+		} catch (DeserializeEnd const&) {
+			threw=true;
+		}
+
+		assert(threw);
+	}
+
+	return 0;
+}
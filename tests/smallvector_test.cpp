@@ -0,0 +1,126 @@
+#include <cassert>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "smallvector.hpp"
+
+template<class SV>
+void same(SV const& sv, std::vector<std::string> const& ref) {
+	assert(sv.size()==ref.size());
+	for (size_t i=0; i<ref.size(); i++) assert(sv[i]==ref[i] && sv.data()+i==&sv[i]);
+}
+
+//random inserts, erases and resizes checked against std::vector, through the inline buffer and the heap
+template<size_t N>
+void check() {
+	SmallVector<std::string, N> sv;
+	std::vector<std::string> ref;
+
+	uint64_t x = 0x9E3779B97F4A7C15ull;
+	for (int i=0; i<20000; i++) {
+		x ^= x<<13;
+		x ^= x>>7;
+		x ^= x<<17;
+
+		size_t at = ref.empty() ? 0 : x%(ref.size()+1);
+		std::string s = std::to_string(i)+"-a-string-too-long-for-sso";
+
+		switch ((x>>32)%9) {
+			case 0: case 1:
+				sv.push_back(s);
+				ref.push_back(s);
+				break;
+			case 2:
+				sv.insert(sv.begin()+at, s);
+				ref.insert(ref.begin()+at, s);
+				break;
+			case 3:
+				sv.insert(sv.begin()+at, (x>>40)%5, s);
+				ref.insert(ref.begin()+at, (x>>40)%5, s);
+				break;
+			case 4: {
+				std::vector<std::string> more((x>>40)%7, s);
+				sv.insert(sv.begin()+at, more.begin(), more.end());
+				ref.insert(ref.begin()+at, more.begin(), more.end());
+				break;
+			}
+			case 5: case 6:
+				if (at<ref.size()) {
+					size_t n = std::min<size_t>((x>>40)%3, ref.size()-at);
+					sv.erase(sv.begin()+at, sv.begin()+at+n);
+					ref.erase(ref.begin()+at, ref.begin()+at+n);
+				}
+				break;
+			case 7:
+				//an element of the vector itself, which mustn't dangle when the buffer grows
+				if (!ref.empty()) {
+					sv.push_back(sv[at%ref.size()]);
+					ref.push_back(ref[at%ref.size()]);
+				}
+				break;
+			case 8:
+				if (ref.size()>100) {
+					sv.resize(ref.size()/4);
+					ref.resize(ref.size()/4);
+				} else {
+					sv.resize(ref.size()+3);
+					ref.resize(ref.size()+3);
+				}
+				break;
+		}
+
+		same(sv, ref);
+	}
+
+	//copies, moves and swaps between inline and heap storage
+	SmallVector<std::string, N> small;
+	std::vector<std::string> small_ref;
+	for (size_t i=0; i<N; i++) {
+		small.emplace_back(i, 'x');
+		small_ref.emplace_back(i, 'x');
+	}
+
+	SmallVector<std::string, N> copy = sv;
+	same(copy, ref);
+	copy = small;
+	same(copy, small_ref);
+
+	SmallVector<std::string, N> moved(std::move(copy));
+	same(moved, small_ref);
+	assert(copy.empty());
+
+	moved.swap(sv);
+	same(moved, ref);
+	same(sv, small_ref);
+
+	sv = std::move(moved);
+	same(sv, ref);
+	assert(moved.empty());
+	moved.push_back("reused");
+	assert(moved.size()==1 && moved.back()=="reused");
+
+	sv.clear();
+	assert(sv.empty() && sv.begin()==sv.end());
+}
+
+int main() {
+	check<0>();
+	check<1>();
+	check<4>();
+	check<32>();
+
+	//move only elements grow by moving
+	SmallVector<std::unique_ptr<int>, 2> ptrs;
+	for (int i=0; i<100; i++) ptrs.emplace_back(std::make_unique<int>(i));
+	ptrs.emplace(ptrs.begin()+50, std::make_unique<int>(-1));
+	assert(ptrs.size()==101 && *ptrs[50]==-1 && *ptrs[51]==50 && *ptrs.back()==99);
+
+	SmallVector<uint16_t, 1> digits(3, uint16_t(7));
+	digits.insert(digits.begin(), 1);
+	digits.insert(digits.end(), 2, 0);
+	assert(digits.size()==6 && digits.front()==1 && digits[1]==7 && digits.back()==0);
+	assert(*digits.rbegin()==0 && *(digits.rend()-1)==1);
+
+	return 0;
+}
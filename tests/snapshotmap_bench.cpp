@@ -0,0 +1,104 @@
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+#include "snapshotmap.hpp"
+#include "concurrentmap.hpp"
+
+using namespace std::chrono;
+
+//lookups per second per reader thread over random keys, while an optional writer keeps updating and publishing.
+//returns millions of lookups per second summed over readers
+template<class Lookup, class Write>
+double run(unsigned threads, size_t keys, size_t ops_per_thread, Lookup lookup, Write write, bool with_writer) {
+	std::atomic<bool> done=false;
+	std::thread writer;
+	if (with_writer) writer = std::thread([&]() {
+		for (unsigned long i=0; !done.load(std::memory_order_relaxed); i++) write(i%keys, i);
+	});
+
+	std::vector<std::thread> workers;
+	std::vector<unsigned long> sums(threads);
+	time_point tp = high_resolution_clock::now();
+
+	for (unsigned t=0; t<threads; t++) {
+		workers.emplace_back([&, t]() {
+			auto handle = lookup();
+			//readers mustn't write shared cache lines, and sums' slots share them
+			unsigned long sum=0;
+			uint64_t x = 0x9E3779B97F4A7C15ull*(t+1);
+			for (size_t i=0; i<ops_per_thread; i++) {
+				x ^= x<<13;
+				x ^= x>>7;
+				x ^= x<<17;
+				sum += handle(x%keys);
+			}
+
+			sums[t]=sum;
+		});
+	}
+
+	for (std::thread& w: workers) w.join();
+	double secs = static_cast<double>(duration_cast<nanoseconds>(high_resolution_clock::now()-tp).count())/1e9;
+
+	done=true;
+	if (with_writer) writer.join();
+
+	return static_cast<double>(threads*ops_per_thread)/secs/1e6;
+}
+
+int main(int argc, char** argv) {
+	unsigned max_threads = argc>1 ? std::stoul(argv[1]) : 16;
+	//routing/config sized tables
+	size_t keys = argc>2 ? std::stoul(argv[2]) : 1000;
+	size_t ops = argc>3 ? std::stoul(argv[3]) : 5000000;
+
+	SnapshotMap<unsigned long, unsigned long> snap(max_threads+1);
+	ConcurrentMap<unsigned long, unsigned long> sharded(64);
+	for (size_t k=0; k<keys; k++) {
+		snap.insert(k, k);
+		sharded.insert(k, k);
+	}
+
+	snap.publish();
+
+	//the writer changes one entry then publishes, about as often as a config reload could
+	auto snap_lookup = [&]() {
+		return [r=std::shared_ptr<decltype(snap)::Reader>(new decltype(snap)::Reader(snap.reader()))](unsigned long k) {
+			auto g = r->pin();
+			return *g[k];
+		};
+	};
+
+	auto snap_write = [&](unsigned long k, unsigned long v) {
+		snap.insert(k, v);
+		snap.publish();
+		std::this_thread::sleep_for(microseconds(100));
+	};
+
+	auto sharded_lookup = [&]() {
+		return [&](unsigned long k) { return *sharded.get(k); };
+	};
+
+	auto sharded_write = [&](unsigned long k, unsigned long v) {
+		sharded.insert(k, v);
+		std::this_thread::sleep_for(microseconds(100));
+	};
+
+	std::cout << "hardware_concurrency " << std::thread::hardware_concurrency() << std::endl;
+	std::cout << "threads snapshot_mops snapshot_writer_mops concurrent_mops concurrent_writer_mops" << std::endl;
+
+	for (unsigned threads=1; threads<=max_threads; threads*=2) {
+		double a = run(threads, keys, ops, snap_lookup, snap_write, false);
+		double b = run(threads, keys, ops, snap_lookup, snap_write, true);
+		double c = run(threads, keys, ops, sharded_lookup, sharded_write, false);
+		double d = run(threads, keys, ops, sharded_lookup, sharded_write, true);
+		std::cout << threads << " " << a << " " << b << " " << c << " " << d << std::endl;
+	}
+
+	return 0;
+}
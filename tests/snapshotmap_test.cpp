@@ -0,0 +1,76 @@
+#include <cassert>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "snapshotmap.hpp"
+
+int main() {
+	SnapshotMap<std::string, int> map(8);
+
+	{
+		auto r = map.reader();
+		map.insert("a", 1);
+		//not visible until published
+		assert(!r.get("a"));
+		map.publish();
+		assert(r.get("a")==1);
+	}
+
+	const int keys=200, versions=300;
+	for (int i=0; i<keys; i++) map.insert(std::to_string(i), 0);
+	map.publish();
+
+	std::atomic<bool> done=false;
+	std::vector<std::thread> readers;
+
+	//every snapshot has all keys at one version, and a pinned snapshot never changes under us
+	for (int t=0; t<4; t++) {
+		readers.emplace_back([&]() {
+			auto r = map.reader();
+			int last=0;
+			while (!done.load()) {
+				auto g = r.pin();
+				int v = *g["0"];
+				assert(v>=last);
+				last=v;
+
+				for (int i=0; i<keys; i++) assert(*g[std::to_string(i)]==v);
+			}
+		});
+	}
+
+	for (int v=1; v<=versions; v++) {
+		map.update([&](auto& m) {
+			for (int i=0; i<keys; i++) m.insert(std::to_string(i), v);
+		});
+
+		map.publish();
+	}
+
+	done=true;
+	for (std::thread& r: readers) r.join();
+
+	auto r = map.reader();
+	assert(r.get("0")==versions);
+	auto removed = map.remove("a");
+	assert(removed==1);
+	map.publish();
+	assert(!r.get("a"));
+
+	//slots are handed back when readers die
+	std::vector<decltype(map)::Reader*> held;
+	bool threw=false;
+	try {
+		for (int i=0; i<8; i++) held.push_back(new auto(map.reader()));
+	} catch (decltype(map)::ReaderSlotsExhausted const&) {
+		threw=true;
+	}
+
+	assert(threw && held.size()==7);
+	for (auto* h: held) delete h;
+	auto again = map.reader();
+
+	return 0;
+}
@@ -0,0 +1,104 @@
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include "sortedmap.hpp"
+#include "btree.hpp"
+
+using namespace std::chrono;
+
+template<class F>
+double time_per_op(size_t n, F f) {
+	time_point tp = high_resolution_clock::now();
+	f();
+	return static_cast<double>(duration_cast<nanoseconds>(high_resolution_clock::now()-tp).count())/n;
+}
+
+struct Result {
+	double insert_ns, find_ns, scan_ns, remove_ns;
+};
+
+//random timestamps. scans sum the next SCAN entries from a random key, like reading a window of time buckets
+constexpr unsigned SCAN=100;
+
+template<class Insert, class Find, class Scan, class Remove>
+Result bench(std::vector<uint64_t> const& keys, Insert insert, Find find, Scan scan, Remove remove, uint64_t& sum) {
+	Result r;
+	r.insert_ns = time_per_op(keys.size(), [&]() {
+		for (uint64_t k: keys) insert(k);
+	});
+
+	r.find_ns = time_per_op(keys.size(), [&]() {
+		for (uint64_t k: keys) sum += find(k);
+	});
+
+	size_t scans = keys.size()/10;
+	r.scan_ns = time_per_op(scans*SCAN, [&]() {
+		for (size_t i=0; i<scans; i++) sum += scan(keys[i]);
+	});
+
+	r.remove_ns = time_per_op(keys.size(), [&]() {
+		for (uint64_t k: keys) remove(k);
+	});
+
+	return r;
+}
+
+int main(int argc, char** argv) {
+	size_t max_n = argc>1 ? std::stoul(argv[1]) : 1000000;
+	uint64_t sum=0;
+
+	std::cout << "n impl insert_ns find_ns scan_ns_per_entry remove_ns" << std::endl;
+
+	for (size_t n=1000; n<=max_n; n*=10) {
+		std::vector<uint64_t> keys;
+		uint64_t x=0x9E3779B97F4A7C15ull;
+		for (size_t i=0; i<n; i++) {
+			x ^= x<<13;
+			x ^= x>>7;
+			x ^= x<<17;
+			keys.push_back(x>>16);
+		}
+
+		SortedMap<uint64_t, uint64_t> skip;
+		Result skip_res = bench(keys, [&](uint64_t k) { skip.insert(k, k); },
+			[&](uint64_t k) { return *skip[k]; },
+			[&](uint64_t k) {
+				uint64_t s=0;
+				unsigned i=0;
+				for (auto it=skip.lower_bound(k); it!=skip.end() && i<SCAN; ++it, i++) s+=it->second;
+				return s;
+			},
+			[&](uint64_t k) { skip.remove(k); }, sum);
+
+		std::map<uint64_t, uint64_t> stdmap;
+		Result std_res = bench(keys, [&](uint64_t k) { stdmap.emplace(k, k); },
+			[&](uint64_t k) { return stdmap.find(k)->second; },
+			[&](uint64_t k) {
+				uint64_t s=0;
+				unsigned i=0;
+				for (auto it=stdmap.lower_bound(k); it!=stdmap.end() && i<SCAN; ++it, i++) s+=it->second;
+				return s;
+			},
+			[&](uint64_t k) { stdmap.erase(k); }, sum);
+
+		using AVL = Node<uint64_t, uint64_t>;
+		AVL::Root avl;
+		Result avl_res = bench(keys, [&](uint64_t k) { avl.insert(uint64_t(k), uint64_t(k)); },
+			[&](uint64_t k) { return avl.find(k)->v; },
+			[&](uint64_t k) {
+				uint64_t s=0;
+				unsigned i=0;
+				for (auto it=avl.iter_ref(avl.find(k)); it!=avl.end() && i<SCAN; ++it, i++) s+=it->v;
+				return s;
+			},
+			[&](uint64_t k) { avl.find(k)->remove(); }, sum);
+
+		for (auto [name, r]: {std::make_pair("SortedMap", skip_res), std::make_pair("std::map", std_res), std::make_pair("AVL Node", avl_res)}) {
+			std::cout << n << " " << name << " " << r.insert_ns << " " << r.find_ns << " " << r.scan_ns << " " << r.remove_ns << std::endl;
+		}
+	}
+
+	return sum==0;
+}
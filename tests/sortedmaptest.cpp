@@ -1,11 +1,87 @@
+#include <cassert>
+#include <map>
+#include <string>
+#include <vector>
+
 #include "sortedmap.hpp"
 
-int main(int argc, char** argv) {
+int main() {
 	SortedMap<int, int> smap;
 	smap.insert(1, 2);
 	smap.insert(2, 3);
-	int* v = smap[1];
-	int* v2 = smap[2];
+	assert(*smap[1]==2 && *smap[2]==3 && smap[3]==nullptr);
+
+	//random inserts, overwrites and removes checked against std::map
+	std::map<int, int> ref {{1, 2}, {2, 3}};
+	uint64_t x=12345;
+	for (int i=0; i<100000; i++) {
+		x ^= x<<13;
+		x ^= x>>7;
+		x ^= x<<17;
+
+		int k = x%5000;
+		if (x%3==0) {
+			auto it = ref.find(k);
+			std::optional<int> expect = it==ref.end() ? std::optional<int>() : std::optional<int>(it->second);
+			if (it!=ref.end()) ref.erase(it);
+			auto removed = smap.remove(k);
+			assert(removed==expect);
+		} else {
+			auto it = ref.find(k);
+			std::optional<int> expect = it==ref.end() ? std::optional<int>() : std::optional<int>(it->second);
+			ref[k]=i;
+			auto old = smap.insert(k, i);
+			assert(old==expect);
+		}
+	}
+
+	assert(smap.count==ref.size());
+	auto rit = ref.begin();
+	for (auto& [k, v]: smap) {
+		assert(k==rit->first && v==rit->second);
+		++rit;
+	}
+
+	assert(rit==ref.end());
+
+	for (int k=-1; k<=5001; k++) {
+		auto lb = smap.lower_bound(k);
+		auto rlb = ref.lower_bound(k);
+		assert((lb==smap.end())==(rlb==ref.end()));
+		if (rlb!=ref.end()) assert(lb->first==rlb->first);
+
+		auto ub = smap.upper_bound(k);
+		auto rub = ref.upper_bound(k);
+		assert((ub==smap.end())==(rub==ref.end()));
+		if (rub!=ref.end()) assert(ub->first==rub->first);
+	}
+
+	//half-open ranges, including empty and inverted ones
+	for (auto [from, to]: {std::make_pair(100, 200), std::make_pair(0, 5000), std::make_pair(300, 300), std::make_pair(400, 10)}) {
+		std::vector<int> got, expect;
+		for (auto const& kv: smap.range(from, to)) got.push_back(kv.first);
+		for (auto it=ref.lower_bound(from); it!=ref.end() && it->first<to; ++it) expect.push_back(it->first);
+		assert(got==expect);
+	}
+
+	//copies are deep and ordered, moves leave an empty map
+	SortedMap<int, int> copy = smap;
+	assert(copy.count==smap.count);
+	copy.remove(ref.begin()->first);
+	assert(smap[ref.begin()->first]!=nullptr);
+
+	SortedMap<int, int> const moved = std::move(copy);
+	assert(copy.count==0 && copy.begin()==copy.end());
+	assert(moved.count==smap.count-1);
+
+	for (int k: {3, 7, 11}) smap.remove(k);
+	while (smap.count>0) smap.remove(smap.begin()->first);
+	assert(smap.begin()==smap.end() && smap[5]==nullptr);
+
+	SortedMap<std::string, std::string, std::greater<std::string>> strs {{"a", "1"}, {"c", "3"}, {"b", "2"}};
+	std::string order;
+	for (auto const& kv: strs) order+=kv.first;
+	assert(order=="cba");
 
 	return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,92 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "util.hpp"
+
+using namespace std::chrono;
+
+//best of 3
+template<class F>
+double time_ms(F f) {
+	double best=0;
+	for (int i=0; i<3; i++) {
+		time_point tp = high_resolution_clock::now();
+		f();
+		double ms = static_cast<double>(duration_cast<microseconds>(high_resolution_clock::now()-tp).count())/1000;
+		if (i==0 || ms<best) best=ms;
+	}
+
+	return best;
+}
+
+//n values from each distribution encoded and decoded one VarIntRef at a time and with encode_many/decode_many, in
+//millions of integers per second
+int main(int argc, char** argv) {
+	size_t n = argc>1 ? std::stoul(argv[1]) : 10000000;
+
+	uint64_t x = 0x9E3779B97F4A7C15ull;
+	auto rand = [&]() {
+		x ^= x<<13;
+		x ^= x>>7;
+		x ^= x<<17;
+		return x;
+	};
+
+	struct Dist {
+		char const* name;
+		std::vector<uint64_t> vals;
+	};
+
+	std::vector<Dist> dists {{.name="small"}, {.name="mostly_small"}, {.name="mixed"}, {.name="large"}};
+	for (size_t i=0; i<n; i++) {
+		uint64_t r = rand();
+		dists[0].vals.push_back(r%32);
+		dists[1].vals.push_back(r%16==0 ? r>>40 : r%32);
+		dists[2].vals.push_back(r>>(3+r%61));
+		dists[3].vals.push_back(r>>20);
+	}
+
+	uint64_t sum=0;
+	std::cout << "dist bytes one_encode_Mint/s one_decode_Mint/s many_encode_Mint/s many_decode_Mint/s" << std::endl;
+
+	for (Dist const& d: dists) {
+		std::vector<char> buf(8*n);
+		std::vector<uint64_t> out(n);
+		size_t len=0;
+
+		double one_enc = time_ms([&]() {
+			char* p = buf.data();
+			for (uint64_t v: d.vals) p += VarIntRef(reinterpret_cast<VarIntRef::VarInt*>(p), v).size;
+			len = p-buf.data();
+		});
+
+		double one_dec = time_ms([&]() {
+			char const* p = buf.data();
+			for (size_t i=0; i<n; i++) {
+				VarIntRef vi(p);
+				out[i] = vi.value();
+				p += vi.size;
+			}
+
+			sum += out[n/2];
+		});
+
+		double many_enc = time_ms([&]() {
+			sum += VarIntRef::encode_many(d.vals.data(), n, buf.data())!=len;
+		});
+
+		double many_dec = time_ms([&]() {
+			sum += *VarIntRef::decode_many(buf.data(), len, out.data(), n);
+		});
+
+		if (out!=d.vals) std::cerr << d.name << " decoded wrong" << std::endl;
+
+		auto rate = [&](double ms) { return static_cast<double>(n)/ms/1000; };
+		std::cout << d.name << " " << len << " " << rate(one_enc) << " " << rate(one_dec) << " " << rate(many_enc) << " " << rate(many_dec) << std::endl;
+	}
+
+	std::cerr << sum << std::endl;
+	return 0;
+}
@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "util.hpp"
+
+uint64_t rng = 0x9E3779B97F4A7C15ull;
+
+uint64_t next_rand() {
+	rng ^= rng<<13;
+	rng ^= rng>>7;
+	rng ^= rng<<17;
+	return rng;
+}
+
+//up to 61 bits, biased towards short values and the edges between sizes
+uint64_t random_value() {
+	uint64_t r = next_rand();
+	unsigned bits = r%62;
+	uint64_t x = bits==0 ? 0 : next_rand()>>(64-bits);
+	switch ((r>>8)%4) {
+		case 0: return x;
+		case 1: return r%32;
+		case 2: return bits==0 ? 0 : (uint64_t(1)<<(bits-1))-((r>>16)%2);
+		default: return x%4096;
+	}
+}
+
+//exactly len bytes on the heap, so sanitizers catch reads past the end
+std::unique_ptr<char[]> exact(char const* p, size_t len) {
+	std::unique_ptr<char[]> ret(new char[len ? len : 1]);
+	if (len) std::memcpy(ret.get(), p, len);
+	return ret;
+}
+
+int main() {
+	//every size boundary through the single value forms
+	for (unsigned bits=0; bits<=61; bits++) {
+		for (uint64_t x: {bits ? (uint64_t(1)<<bits)-1 : 0, uint64_t(1)<<bits>>1, bits ? uint64_t(1)<<(bits-1) : 1}) {
+			if (x>=uint64_t(1)<<61) continue;
+
+			char a[8]={}, b[16]={};
+			VarIntRef ref(reinterpret_cast<VarIntRef::VarInt*>(a), x);
+			size_t n = VarIntRef::encode_wide(b, x);
+			assert(static_cast<size_t>(ref.size)==n && n==VarIntRef::encoded_size(x) && std::memcmp(a, b, n)==0);
+			assert(VarIntRef(a).value()==x && VarIntRef(a).size==ref.size);
+
+			uint64_t y;
+			assert(VarIntRef::decode_wide(b, y)==n && y==x);
+		}
+	}
+
+	//the largest value takes all 8 bytes, and nothing takes more
+	{
+		uint64_t const max = VarIntRef::MAX_VALUE;
+		assert(VarIntRef::encoded_size(max)==8 && VarIntRef::encoded_size(max+1)==8 && VarIntRef::encoded_size(~uint64_t(0))==8);
+
+		uint64_t vals[] = {max, 5, max-1, max, 31};
+		char enc[8*5+1];
+		enc[8*5] = 'x';
+		size_t len = VarIntRef::encode_many(vals, 5, enc);
+		assert(len==8+1+8+8+1 && enc[8*5]=='x');
+
+		uint64_t out[5];
+		std::optional<size_t> got = VarIntRef::decode_many(enc, len, out, 5);
+		assert(got && *got==len && std::equal(out, out+5, vals));
+	}
+
+	for (int round=0; round<2000; round++) {
+		size_t n = next_rand()%300;
+		std::vector<uint64_t> vals(n);
+		//some rounds are all small values, for the runs of one byte VarInts
+		bool small = round%3==0;
+		for (uint64_t& v: vals) v = small ? next_rand()%32 : random_value();
+
+		//encode_many agrees with one at a time
+		std::vector<char> ref;
+		for (uint64_t v: vals) {
+			char buf[8];
+			VarIntRef vi(reinterpret_cast<VarIntRef::VarInt*>(buf), v);
+			ref.insert(ref.end(), buf, buf+vi.size);
+		}
+
+		std::vector<char> enc(8*n+1);
+		size_t len = VarIntRef::encode_many(vals.data(), n, enc.data());
+		assert(len==ref.size() && (n==0 || std::memcmp(enc.data(), ref.data(), len)==0));
+
+		//decoding from an exactly sized buffer
+		std::unique_ptr<char[]> in = exact(ref.data(), len);
+		std::vector<uint64_t> out(n);
+		std::optional<size_t> got = VarIntRef::decode_many(in.get(), len, out.data(), n);
+		assert(got && *got==len && out==vals);
+
+		//cut short anywhere before the last byte
+		if (len>0) {
+			size_t cut = next_rand()%len;
+			std::unique_ptr<char[]> short_in = exact(ref.data(), cut);
+			assert(!VarIntRef::decode_many(short_in.get(), cut, out.data(), n));
+		}
+
+		//a prefix of the values
+		size_t k = n ? next_rand()%n : 0;
+		got = VarIntRef::decode_many(in.get(), len, out.data(), k);
+		size_t prefix=0;
+		for (size_t i=0; i<k; i++) prefix += VarIntRef::encoded_size(vals[i]);
+		assert(got && *got==prefix && std::equal(out.begin(), out.begin()+k, vals.begin()));
+	}
+
+	//random bytes decode the same in bulk as one at a time, or run out the same way
+	for (int round=0; round<2000; round++) {
+		size_t len = next_rand()%200;
+		std::vector<char> bytes(len);
+		for (char& c: bytes) c = static_cast<char>(next_rand());
+		if (round%2) for (char& c: bytes) c &= 0x3F;
+
+		std::unique_ptr<char[]> in = exact(bytes.data(), len);
+		size_t n = next_rand()%100;
+		std::vector<uint64_t> out(n), ref(n);
+
+		size_t at=0, i=0;
+		for (; i<n && at<len; i++) {
+			VarIntRef vi(in.get()+at);
+			if (len-at<static_cast<size_t>(vi.size)) break;
+			ref[i] = vi.value();
+			at += vi.size;
+		}
+
+		std::optional<size_t> got = VarIntRef::decode_many(in.get(), len, out.data(), n);
+		if (i==n) assert(got && *got==at && out==ref);
+		else assert(!got);
+	}
+
+	return 0;
+}